@@ -0,0 +1,195 @@
+// Detection front-end benchmark: stock cv::aruco pipeline vs DetectionEngine.
+//
+// Usage: ./benchmark_detection [frame.png ...]
+// Without arguments a synthetic 1200x800 mono frame with AprilTag 36h11
+// markers is generated, matching the camera configuration used on the Pi.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/aruco.hpp>
+
+#include "code_table.h"
+#include "detection_engine.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const int FRAME_WIDTH = 1200;
+static const int FRAME_HEIGHT = 800;
+static const int ITERATIONS = 50;
+
+static cv::Mat make_synthetic_frame(const cv::aruco::Dictionary &dict) {
+    cv::Mat frame(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC1);
+
+    // Uneven lighting so the adaptive threshold has real work to do
+    for (int y = 0; y < frame.rows; y++) {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < frame.cols; x++) {
+            row[x] = (uint8_t)(90 + 80 * x / frame.cols + 40 * y / frame.rows);
+        }
+    }
+
+    cv::RNG rng(1234);
+    int id = 0;
+    for (int gy = 0; gy < 3; gy++) {
+        for (int gx = 0; gx < 5; gx++) {
+            int side = 60 + rng.uniform(0, 80);
+            cv::Mat marker;
+            cv::aruco::generateImageMarker(dict, id++, side, marker, 1);
+
+            // White quiet zone around each marker
+            int pad = side / 8;
+            int x = 40 + gx * 230 + rng.uniform(0, 30);
+            int y = 40 + gy * 250 + rng.uniform(0, 30);
+            frame(cv::Rect(x - pad, y - pad, side + 2 * pad, side + 2 * pad)).setTo(cv::Scalar(230));
+            marker.copyTo(frame(cv::Rect(x, y, side, side)));
+        }
+    }
+
+    cv::Mat noise(frame.size(), CV_8UC1);
+    cv::randn(noise, cv::Scalar(0), cv::Scalar(6));
+    cv::add(frame, noise, frame);
+    cv::GaussianBlur(frame, frame, cv::Size(3, 3), 0.8);
+    return frame;
+}
+
+template <typename Fn>
+static double time_ms(Fn fn) {
+    fn(); // warm-up, lets both paths allocate their buffers
+    auto start = Clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        fn();
+    }
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+    return elapsed.count() / ITERATIONS;
+}
+
+static void run(const cv::Mat &frame, const cv::aruco::Dictionary &dict, const cv::aruco::DetectorParameters &params) {
+    std::cout << "Frame " << frame.cols << "x" << frame.rows << std::endl;
+
+    // Threshold stage alone: one cv::adaptiveThreshold per window vs one integral image
+    cv::Mat binary;
+    double stock_threshold = time_ms([&]() {
+        for (int win = params.adaptiveThreshWinSizeMin; win <= params.adaptiveThreshWinSizeMax; win += params.adaptiveThreshWinSizeStep) {
+            cv::adaptiveThreshold(frame, binary, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY_INV, win | 1, params.adaptiveThreshConstant);
+        }
+    });
+
+    AdaptiveThreshold integral_threshold;
+    double integral_ms = time_ms([&]() {
+        integral_threshold.prepare(frame);
+        for (int win = params.adaptiveThreshWinSizeMin; win <= params.adaptiveThreshWinSizeMax; win += params.adaptiveThreshWinSizeStep) {
+            integral_threshold.apply(win | 1, params.adaptiveThreshConstant, binary);
+        }
+    });
+
+    // Full detection
+    cv::aruco::ArucoDetector stock(dict, params);
+    DetectionEngine engine;
+    engine.set_parameters(params); // First: decode tables are built for its error correction rate
+    engine.set_dictionary(dict);
+
+    std::vector<std::vector<cv::Point2f>> corners;
+    std::vector<int> ids;
+    std::vector<DetectedMarker> markers;
+    double stock_detect = time_ms([&]() { stock.detectMarkers(frame, corners, ids); });
+    size_t stock_found = ids.size();
+    double engine_detect = time_ms([&]() { engine.detect(frame, markers); });
+    size_t engine_found = markers.size();
+    engine.set_run_segmentation_enabled(true);
+    double runs_detect = time_ms([&]() { engine.detect(frame, markers); });
+    size_t runs_found = markers.size();
+
+    // Extra families share thresholding and quad extraction
+    engine.add_family("aruco_4x4_50", cv::aruco::getPredefinedDictionary(cv::aruco::DICT_4X4_50), 0.0, true);
+    engine.add_family("apriltag_25h9", cv::aruco::getPredefinedDictionary(cv::aruco::DICT_APRILTAG_25h9), 0.0, true);
+    double multi_detect = time_ms([&]() { engine.detect(frame, markers); });
+
+    // Expected-set mode: the first four markers of the frame. The warm-up run
+    // finds them in the full frame, later runs only search their last positions.
+    DetectionEngine expected_engine;
+    expected_engine.set_parameters(params);
+    expected_engine.set_dictionary(dict);
+    expected_engine.set_run_segmentation_enabled(true);
+    for (size_t i = 0; i < std::min<size_t>(4, runs_found); i++) {
+        expected_engine.add_expected_marker(0, ids.empty() ? (int)i : ids[i]);
+    }
+    double expected_detect = time_ms([&]() { expected_engine.detect(frame, markers); });
+    bool early = expected_engine.last_frame_exited_early();
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  threshold  stock " << stock_threshold << " ms   integral " << integral_ms << " ms" << std::endl;
+    std::cout << "  detect     stock " << stock_detect << " ms (" << stock_found << " markers)   engine "
+              << engine_detect << " ms (" << engine_found << " markers)   engine+runs "
+              << runs_detect << " ms (" << runs_found << " markers)" << std::endl;
+    std::cout << "  detect     engine+runs with 36h11 + 4x4_50 + 25h9 " << multi_detect << " ms" << std::endl;
+    std::cout << "  detect     engine+runs expecting 4 markers " << expected_detect << " ms ("
+              << (early ? "early exit" : "full-frame search") << ")" << std::endl;
+}
+
+// Decode cost for payloads that match nothing, the common case for false quads
+static void run_decode(const cv::aruco::Dictionary &dict, const cv::aruco::DetectorParameters &params) {
+    const int n = dict.markerSize;
+    const int samples = 20000;
+    cv::RNG rng(42);
+    std::vector<cv::Mat> payloads(samples);
+    std::vector<uint64_t> codes(samples);
+    for (int i = 0; i < samples; i++) {
+        payloads[i].create(n, n, CV_8UC1);
+        for (int c = 0; c < n * n; c++) {
+            payloads[i].at<uint8_t>(c / n, c % n) = (uint8_t)rng.uniform(0, 2);
+        }
+        codes[i] = CodeTable::code_from_bits(payloads[i]);
+    }
+
+    auto start = Clock::now();
+    CodeTable table;
+    table.build(dict, CodeTable::MAX_HAMMING);
+    std::chrono::duration<double, std::milli> build_ms = Clock::now() - start;
+
+    int id, rotation, hamming, hits = 0;
+    start = Clock::now();
+    for (int i = 0; i < samples; i++) {
+        hits += dict.identify(payloads[i], id, rotation, params.errorCorrectionRate) ? 1 : 0;
+    }
+    std::chrono::duration<double, std::nano> identify_ns = Clock::now() - start;
+
+    start = Clock::now();
+    for (int i = 0; i < samples; i++) {
+        hits += table.lookup(codes[i], id, rotation, hamming) ? 1 : 0;
+    }
+    std::chrono::duration<double, std::nano> table_ns = Clock::now() - start;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Decode (" << dict.bytesList.rows << " codes, table " << table.entry_count() << " entries built in "
+              << build_ms.count() << " ms)" << std::endl;
+    std::cout << "  identify " << identify_ns.count() / samples << " ns/candidate   table "
+              << table_ns.count() / samples << " ns/candidate   (" << hits << " hits)" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    cv::aruco::Dictionary dict = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_APRILTAG_36h11);
+    cv::aruco::DetectorParameters params;
+
+    run_decode(dict, params);
+
+    if (argc < 2) {
+        run(make_synthetic_frame(dict), dict, params);
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        cv::Mat frame = cv::imread(argv[i], cv::IMREAD_GRAYSCALE);
+        if (frame.empty()) {
+            std::cerr << "Failed to read " << argv[i] << std::endl;
+            continue;
+        }
+        run(frame, dict, params);
+    }
+    return 0;
+}
@@ -0,0 +1,291 @@
+// Microbenchmarks of the per-frame kernels behind AprilTagDetector, each on
+// a fixed, seeded input, so a change to the frame pipeline can be justified
+// with numbers on the Pi (arm64) and on a desktop (x86_64) alike.
+//
+// Usage: ./benchmark_kernels [name filter]
+// Each kernel runs REPEATS times; the median is reported as ns per
+// operation and, for kernels that stream a frame, input bytes per CPU cycle.
+// Cycles come from the kernel's perf cycle counter (perf_event_open), which
+// both architectures provide. Without access to it (perf_event_paranoid,
+// containers) only ns/op is shown.
+//
+// Packing results into Godot Arrays and Dictionaries needs a running engine
+// and is not measured here; start_trace() shows it in the game as the
+// "godot read detections" span.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/aruco.hpp>
+
+#include "batch_pose.h"
+#include "cpu_kernels.h"
+#include "detection_engine.h"
+#include "lens_model.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Camera configuration used on the Pi, and the preview size of AprilTagDetector
+static const int FRAME_WIDTH = 1200;
+static const int FRAME_HEIGHT = 800;
+static const int PREVIEW_WIDTH = 400;
+static const int PREVIEW_HEIGHT = 300;
+static const double MARKER_SIZE = 0.05;
+static const int REPEATS = 15;
+
+// User-space CPU cycles of this thread
+class CycleCounter {
+public:
+    CycleCounter() {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~CycleCounter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    bool available() const { return fd >= 0; }
+    uint64_t read_cycles() const {
+        uint64_t value = 0;
+        if (fd < 0 || read(fd, &value, sizeof(value)) != (ssize_t)sizeof(value)) {
+            return 0;
+        }
+        return value;
+    }
+
+private:
+    int fd;
+};
+
+static CycleCounter cycles;
+static std::string filter;
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// `fn` performs `items` operations of `bytes` input each
+template <typename Fn>
+static void bench(const std::string &name, int items, size_t bytes, int calls, Fn fn) {
+    if (!filter.empty() && name.find(filter) == std::string::npos) {
+        return;
+    }
+    fn(); // Warm-up, lets each kernel allocate its buffers
+
+    std::vector<double> ns(REPEATS), cpu(REPEATS);
+    for (int r = 0; r < REPEATS; r++) {
+        uint64_t c0 = cycles.read_cycles();
+        auto start = Clock::now();
+        for (int i = 0; i < calls; i++) {
+            fn();
+        }
+        std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+        uint64_t c1 = cycles.read_cycles();
+        ns[r] = elapsed.count() / ((double)calls * items);
+        cpu[r] = (double)(c1 - c0) / ((double)calls * items);
+    }
+
+    std::cout << std::left << std::setw(34) << name << std::right << std::fixed
+              << std::setw(12) << std::setprecision(1) << median(ns) << " ns/op";
+    if (cycles.available()) {
+        double op_cycles = median(cpu);
+        std::cout << std::setw(10) << std::setprecision(0) << op_cycles << " cycles";
+        if (bytes > 0 && op_cycles > 0.0) {
+            std::cout << std::setw(8) << std::setprecision(2) << bytes / op_cycles << " B/cycle";
+        }
+    }
+    std::cout << std::endl;
+}
+
+// Markers on an unevenly lit background, as in benchmark_detection
+static cv::Mat make_frame(const cv::aruco::Dictionary &dict) {
+    cv::Mat frame(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC1);
+    for (int y = 0; y < frame.rows; y++) {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < frame.cols; x++) {
+            row[x] = (uint8_t)(90 + 80 * x / frame.cols + 40 * y / frame.rows);
+        }
+    }
+
+    cv::RNG rng(1234);
+    int id = 0;
+    for (int gy = 0; gy < 3; gy++) {
+        for (int gx = 0; gx < 5; gx++) {
+            int side = 60 + rng.uniform(0, 80);
+            cv::Mat marker;
+            cv::aruco::generateImageMarker(dict, id++, side, marker, 1);
+            int pad = side / 8;
+            int x = 40 + gx * 230 + rng.uniform(0, 30);
+            int y = 40 + gy * 250 + rng.uniform(0, 30);
+            frame(cv::Rect(x - pad, y - pad, side + 2 * pad, side + 2 * pad)).setTo(cv::Scalar(230));
+            marker.copyTo(frame(cv::Rect(x, y, side, side)));
+        }
+    }
+
+    cv::Mat noise(frame.size(), CV_8UC1);
+    cv::randn(noise, cv::Scalar(0), cv::Scalar(6));
+    cv::add(frame, noise, frame);
+    cv::GaussianBlur(frame, frame, cv::Size(3, 3), 0.8);
+    return frame;
+}
+
+static void run_unpack() {
+    cv::RNG rng(7);
+    cv::Mat frame16(FRAME_HEIGHT, FRAME_WIDTH, CV_16UC1), frame10(FRAME_HEIGHT, FRAME_WIDTH, CV_16UC1), frame8;
+    rng.fill(frame16, cv::RNG::UNIFORM, 0, 65536);
+    rng.fill(frame10, cv::RNG::UNIFORM, 0, 1024);
+    size_t bytes = frame16.total() * frame16.elemSize();
+
+    // OpenCV's conversion, and the kernel the camera callback uses for 16-bit buffers
+    const CpuKernels &kernels = cpu_kernels();
+    frame8.create(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC1);
+    bench("unpack 16-bit to 8-bit, cv", 1, bytes, 20, [&]() { frame16.convertTo(frame8, CV_8UC1, 1.0 / 256.0); });
+    bench(std::string("unpack 16-bit to 8-bit, ") + kernels.name, 1, bytes, 20, [&]() {
+        kernels.unpack_to_8bit(frame16.ptr<uint16_t>(), frame8.ptr<uint8_t>(), frame16.total(), 8);
+    });
+    // 10-bit samples in 16-bit words, as unpacked RAW10 arrives
+    bench("unpack 10-bit to 8-bit, cv", 1, bytes, 20, [&]() { frame10.convertTo(frame8, CV_8UC1, 1.0 / 4.0); });
+    bench(std::string("unpack 10-bit to 8-bit, ") + kernels.name, 1, bytes, 20, [&]() {
+        kernels.unpack_to_8bit(frame10.ptr<uint16_t>(), frame8.ptr<uint8_t>(), frame10.total(), 2);
+    });
+}
+
+static void run_preview(const cv::Mat &frame) {
+    cv::Mat small, rgb;
+    bench("preview downscale", 1, frame.total(), 20, [&]() {
+        cv::resize(frame, small, cv::Size(PREVIEW_WIDTH, PREVIEW_HEIGHT), 0, 0, cv::INTER_LINEAR);
+    });
+    bench("preview gray to RGB", 1, small.total(), 200, [&]() { cv::cvtColor(small, rgb, cv::COLOR_GRAY2RGB); });
+}
+
+static void run_threshold(const cv::Mat &frame) {
+    AdaptiveThreshold threshold;
+    cv::Mat binary;
+    bench("threshold integral image", 1, frame.total(), 20, [&]() { threshold.prepare(frame); });
+    threshold.prepare(frame);
+    bench("threshold window 13", 1, frame.total(), 20, [&]() { threshold.apply(13, 7.0, binary); });
+}
+
+static void run_decode_and_pose(const cv::Mat &frame, const cv::aruco::Dictionary &dict) {
+    DetectionEngine engine;
+    engine.set_dictionary(dict);
+    std::vector<DetectedMarker> markers;
+    engine.detect(frame, markers);
+    if (markers.empty()) {
+        std::cout << "No markers found in the test frame" << std::endl;
+        return;
+    }
+    int count = (int)markers.size();
+
+    // Every quad decodes; the same quads shifted by half a side do not
+    std::vector<std::vector<cv::Point2f>> quads, misses;
+    for (const DetectedMarker &marker : markers) {
+        quads.push_back(marker.corners);
+        cv::Point2f shift = (marker.corners[1] - marker.corners[0]) * 0.5f;
+        std::vector<cv::Point2f> moved = marker.corners;
+        for (cv::Point2f &corner : moved) {
+            corner += shift;
+        }
+        misses.push_back(moved);
+    }
+    DetectedMarker decoded;
+    bench("quad decode", count, 0, 100, [&]() {
+        for (const auto &quad : quads) {
+            engine.decode_quad(frame, quad, decoded);
+        }
+    });
+    bench("quad decode, no match", count, 0, 100, [&]() {
+        for (const auto &quad : misses) {
+            engine.decode_quad(frame, quad, decoded);
+        }
+    });
+
+    // Pi intrinsics with mild barrel distortion
+    cv::Matx33d camera_matrix(1000, 0, FRAME_WIDTH / 2.0, 0, 1000, FRAME_HEIGHT / 2.0, 0, 0, 1);
+    cv::Mat dist_coeffs = (cv::Mat_<double>(5, 1) << -0.12, 0.05, 0.0005, -0.0003, 0.0);
+    std::vector<cv::Point2f> corners, normalized;
+    for (const DetectedMarker &marker : markers) {
+        corners.insert(corners.end(), marker.corners.begin(), marker.corners.end());
+    }
+
+    LensModel lens;
+    lens.set(camera_matrix, dist_coeffs, LensModel::MODEL_PINHOLE);
+    lens.prepare(frame.size());
+    bench("undistort corners, cv", (int)corners.size(), 0, 200, [&]() {
+        cv::undistortPoints(corners, normalized, camera_matrix, dist_coeffs);
+    });
+    bench("undistort corners, lens table", (int)corners.size(), 0, 200, [&]() { lens.undistort(corners, normalized); });
+
+    // As estimate_pose_both_solutions: IPPE square on normalised corners
+    const float h = (float)MARKER_SIZE / 2.0f;
+    std::vector<cv::Point3f> object = { { -h, h, 0 }, { h, h, 0 }, { h, -h, 0 }, { -h, -h, 0 } };
+    cv::Mat identity = cv::Mat::eye(3, 3, CV_64F);
+    std::vector<cv::Vec3d> rvecs, tvecs;
+    std::vector<double> errors;
+    bench("pose single marker (IPPE)", count, 0, 20, [&]() {
+        for (int i = 0; i < count; i++) {
+            std::vector<cv::Point2f> marker_corners(&normalized[i * 4], &normalized[i * 4] + 4);
+            cv::solvePnPGeneric(object, marker_corners, identity, cv::noArray(), rvecs, tvecs,
+                false, cv::SOLVEPNP_IPPE_SQUARE, cv::noArray(), cv::noArray(), errors);
+        }
+    });
+
+    BatchPoseSolver solver;
+    cv::Vec3d rvec, tvec;
+    bench("pose batched (2 refinements)", count, 0, 200, [&]() {
+        solver.clear();
+        for (int i = 0; i < count; i++) {
+            solver.add(&normalized[i * 4], (float)MARKER_SIZE);
+        }
+        solver.solve(2);
+        for (int i = 0; i < count; i++) {
+            solver.get_pose(i, 0, rvec, tvec);
+        }
+    });
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        filter = argv[1];
+    }
+
+#if defined(__aarch64__)
+    const char *arch = "arm64";
+#elif defined(__x86_64__)
+    const char *arch = "x86_64";
+#else
+    const char *arch = "other";
+#endif
+    std::cout << "Kernels on " << arch << ", " << FRAME_WIDTH << "x" << FRAME_HEIGHT << " frames, median of "
+              << REPEATS << " runs, " << cpu_kernels().name << " pixel kernels"
+              << (cycles.available() ? "" : " (no cycle counter)") << std::endl;
+
+    cv::setNumThreads(1); // The cycle counter only sees this thread
+    cv::aruco::Dictionary dict = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_APRILTAG_36h11);
+    cv::Mat frame = make_frame(dict);
+
+    run_unpack();
+    run_preview(frame);
+    run_threshold(frame);
+    run_decode_and_pose(frame, dict);
+    return 0;
+}
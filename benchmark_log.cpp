@@ -0,0 +1,138 @@
+// Detection log benchmark: append cost on the camera thread, sustained write
+// throughput, and read/seek speed of DetectionLogWriter/DetectionLogReader.
+//
+// Usage: ./benchmark_log [markers_per_frame] [log_path]
+// The paced run records 200 fps for 5 seconds and must not drop a frame; the
+// burst run appends as fast as possible to find where the disk falls behind.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "detection_log.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const int FPS = 200;
+static const int PACED_SECONDS = 5;
+static const int BURST_FRAMES = 20000;
+static const int SEEKS = 2000;
+
+static std::vector<LogMarker> make_markers(int count) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> pixel(0.0f, 1200.0f);
+    std::vector<LogMarker> markers(count);
+    for (int i = 0; i < count; i++) {
+        LogMarker &marker = markers[i];
+        marker = {};
+        marker.id = i;
+        for (float &c : marker.corners) {
+            c = pixel(rng);
+        }
+        marker.tvec[2] = 1.0f;
+        marker.hamming = i % 3;
+        marker.sharpness = 0.8f;
+        marker.reprojection_error = 0.4f;
+        marker.flags = LOG_MARKER_HAS_POSE;
+    }
+    return markers;
+}
+
+struct WriteResult {
+    double append_us_avg = 0.0;
+    double append_us_max = 0.0;
+    double seconds = 0.0; // Until close() returned, i.e. everything on disk
+    uint64_t frames = 0;
+    uint64_t dropped = 0;
+    uint64_t bytes = 0;
+};
+
+static WriteResult run_writer(const std::string &path, const std::vector<LogMarker> &markers, int frames, bool paced) {
+    DetectionLogWriter writer;
+    WriteResult result;
+    if (!writer.open(path)) {
+        std::cerr << "Cannot open " << path << std::endl;
+        std::exit(1);
+    }
+    writer.set_family_name(0, "tag36h11");
+
+    Clock::time_point start = Clock::now();
+    double total_us = 0.0;
+    for (int i = 0; i < frames; i++) {
+        if (paced) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds((int64_t)i * 1000000 / FPS));
+        }
+        uint64_t timestamp = (uint64_t)i * 1000000000ull / FPS;
+        Clock::time_point t0 = Clock::now();
+        writer.append(timestamp, i, 0, markers.data(), markers.size());
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+        total_us += us;
+        result.append_us_max = std::max(result.append_us_max, us);
+    }
+    result.frames = writer.get_frames();
+    result.dropped = writer.get_dropped_frames();
+    result.bytes = writer.get_bytes();
+    writer.close();
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.append_us_avg = total_us / frames;
+    return result;
+}
+
+static void print_write(const char *name, const WriteResult &r) {
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(2)
+              << " append avg " << std::setw(7) << r.append_us_avg << " us, max " << std::setw(8) << r.append_us_max
+              << " us, " << std::setw(7) << r.frames / r.seconds << " frames/s, "
+              << std::setw(7) << r.bytes / r.seconds / 1e6 << " MB/s, dropped " << r.dropped << std::endl;
+}
+
+int main(int argc, char **argv) {
+    int per_frame = argc > 1 ? std::atoi(argv[1]) : 50;
+    std::string path = argc > 2 ? argv[2] : "/tmp/benchmark_log.atlog";
+    std::vector<LogMarker> markers = make_markers(per_frame);
+
+    std::cout << per_frame << " markers per frame, " << sizeof(LogMarker) * per_frame + 32
+              << " bytes per frame, log at " << path << std::endl;
+
+    WriteResult paced = run_writer(path, markers, FPS * PACED_SECONDS, true);
+    print_write("paced", paced);
+    WriteResult burst = run_writer(path, markers, BURST_FRAMES, false);
+    print_write("burst", burst);
+
+    // Read back the burst log
+    DetectionLogReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Cannot read " << path << std::endl;
+        return 1;
+    }
+    LogFrame frame;
+    uint64_t read_frames = 0, read_markers = 0;
+    Clock::time_point start = Clock::now();
+    while (reader.next(frame)) {
+        read_frames++;
+        read_markers += frame.markers.size();
+    }
+    double read_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::mt19937_64 rng(99);
+    std::uniform_int_distribution<uint64_t> when(reader.get_start_time(), reader.get_end_time());
+    int found = 0;
+    start = Clock::now();
+    for (int i = 0; i < SEEKS; i++) {
+        found += reader.seek(when(rng)) && reader.next(frame) ? 1 : 0;
+    }
+    double seek_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / SEEKS;
+
+    std::cout << "read      " << std::fixed << std::setprecision(0) << read_frames / read_s << " frames/s ("
+              << read_frames << " frames, " << read_markers << " markers), seek + read "
+              << std::setprecision(2) << seek_us << " us (" << found << "/" << SEEKS << " found)" << std::endl;
+
+    bool ok = paced.dropped == 0 && read_frames == burst.frames && found == SEEKS;
+    std::remove(path.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Headless replay benchmark: the per-frame detection path of AprilTagDetector
+// (DetectionEngine, lens table, batched pose) run as fast as possible over
+// recorded frames, without Godot or a camera.
+//
+// Usage: ./benchmark_replay [seconds] [recording.atfr ...]
+// Recordings come from detector.start_recording(). Without them a synthetic
+// sequence of 1200x800 frames with drifting AprilTag 36h11 markers is used.
+// Frames are loaded once, then processed in a loop for at least `seconds`
+// (default 5). The last line, "fps <value>", is what pgo_build.sh compares;
+// it also serves as the training run of a pgo=generate build.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/aruco.hpp>
+
+#include "batch_pose.h"
+#include "detection_engine.h"
+#include "frame_recording.h"
+#include "lens_model.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const int FRAME_WIDTH = 1200;
+static const int FRAME_HEIGHT = 800;
+static const int SYNTHETIC_FRAMES = 60;
+static const double MARKER_SIZE = 0.05;
+
+// Markers on an unevenly lit background, as in benchmark_detection, moved a
+// little each frame so the expected-marker and decode paths see variety
+static cv::Mat make_frame(const cv::aruco::Dictionary &dict, int index) {
+    cv::Mat frame(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC1);
+    for (int y = 0; y < frame.rows; y++) {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < frame.cols; x++) {
+            row[x] = (uint8_t)(90 + 80 * x / frame.cols + 40 * y / frame.rows);
+        }
+    }
+
+    cv::RNG rng(1234);
+    int id = 0;
+    for (int gy = 0; gy < 3; gy++) {
+        for (int gx = 0; gx < 5; gx++) {
+            int side = 60 + rng.uniform(0, 80);
+            cv::Mat marker;
+            cv::aruco::generateImageMarker(dict, id++, side, marker, 1);
+            int pad = side / 8;
+            int x = 40 + gx * 230 + rng.uniform(0, 30) + index % 20;
+            int y = 40 + gy * 250 + rng.uniform(0, 30) + (index / 2) % 15;
+            frame(cv::Rect(x - pad, y - pad, side + 2 * pad, side + 2 * pad)).setTo(cv::Scalar(230));
+            marker.copyTo(frame(cv::Rect(x, y, side, side)));
+        }
+    }
+
+    cv::Mat noise(frame.size(), CV_8UC1);
+    cv::RNG noise_rng(index);
+    noise_rng.fill(noise, cv::RNG::NORMAL, 0, 6);
+    cv::add(frame, noise, frame);
+    cv::GaussianBlur(frame, frame, cv::Size(3, 3), 0.8);
+    return frame;
+}
+
+static bool load_recording(const std::string &path, std::vector<cv::Mat> &frames) {
+    FrameRecordingReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    RecordedFrame frame;
+    while (reader.next(frame)) {
+        frames.push_back(frame.image.clone());
+    }
+    std::cout << "Loaded " << path << ": " << reader.get_frame_count() << " frames of "
+              << reader.get_frame_size().width << "x" << reader.get_frame_size().height << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+    cv::aruco::Dictionary dict = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_APRILTAG_36h11);
+
+    std::vector<cv::Mat> frames;
+    for (int i = 2; i < argc; i++) {
+        load_recording(argv[i], frames);
+    }
+    if (frames.empty()) {
+        for (int i = 0; i < SYNTHETIC_FRAMES; i++) {
+            frames.push_back(make_frame(dict, i));
+        }
+        std::cout << "Synthetic: " << frames.size() << " frames of " << FRAME_WIDTH << "x" << FRAME_HEIGHT << std::endl;
+    }
+
+    // As AprilTagDetector with the detection engine, run segmentation and
+    // batched pose enabled
+    DetectionEngine engine;
+    engine.set_parameters(cv::aruco::DetectorParameters()); // First: decode tables are built for its error correction rate
+    engine.set_dictionary(dict);
+    engine.set_run_segmentation_enabled(true);
+
+    LensModel lens;
+    cv::Size size = frames[0].size();
+    cv::Matx33d camera_matrix(1000, 0, size.width / 2.0, 0, 1000, size.height / 2.0, 0, 0, 1);
+    cv::Mat dist_coeffs = (cv::Mat_<double>(5, 1) << -0.12, 0.05, 0.0005, -0.0003, 0.0);
+    lens.set(camera_matrix, dist_coeffs, LensModel::MODEL_PINHOLE);
+
+    std::vector<DetectedMarker> markers;
+    std::vector<cv::Point2f> corners, normalized;
+    BatchPoseSolver solver;
+    cv::Vec3d rvec, tvec;
+
+    uint64_t processed = 0, found = 0;
+    auto start = Clock::now();
+    std::chrono::duration<double> elapsed(0);
+    while (elapsed.count() < seconds) {
+        for (const cv::Mat &frame : frames) {
+            engine.get_mask().update(frame.size(), camera_matrix);
+            engine.detect(frame, markers);
+
+            lens.prepare(frame.size());
+            corners.clear();
+            for (const DetectedMarker &marker : markers) {
+                corners.insert(corners.end(), marker.corners.begin(), marker.corners.end());
+            }
+            lens.undistort(corners, normalized);
+
+            solver.clear();
+            for (size_t m = 0; m < markers.size(); m++) {
+                solver.add(&normalized[m * 4], (float)MARKER_SIZE);
+            }
+            solver.solve(2);
+            for (size_t m = 0; m < markers.size(); m++) {
+                solver.get_pose(m, 0, rvec, tvec);
+            }
+            found += markers.size();
+        }
+        processed += frames.size();
+        elapsed = Clock::now() - start;
+    }
+
+    double fps = processed / elapsed.count();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << processed << " frames in " << elapsed.count() << " s, "
+              << (double)found / processed << " markers/frame" << std::endl;
+    std::cout << "fps " << fps << std::endl;
+    return 0;
+}
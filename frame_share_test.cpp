@@ -0,0 +1,173 @@
+// Frame sharing test without a camera: memfd-backed fake buffers stand in
+// for libcamera's dmabufs.
+//
+// Usage: ./frame_share_test [frames] [clients]
+// A fake camera cycles through 4 buffers, filling each with its frame number
+// and sharing it through FrameShareServer. Forked clients map every frame,
+// check its contents and release it; one of them skips every 10th release so
+// the timeout path runs. A buffer is only refilled once it came back from the
+// server, so a release bug shows up as a client seeing a changed frame.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "frame_share.h"
+
+static const int BUFFERS = 4;
+static const uint32_t WIDTH = 320;
+static const uint32_t HEIGHT = 240;
+static const int TIMEOUT_MS = 20;
+
+static int run_client(const std::string &path, bool skip_some) {
+    int sock = -1;
+    for (int attempt = 0; attempt < 100 && sock < 0; attempt++) {
+        sock = apriltag_frame_share_connect(path.c_str());
+        if (sock < 0) {
+            usleep(10000);
+        }
+    }
+    if (sock < 0) {
+        return 2;
+    }
+
+    int errors = 0;
+    apriltag_frame_message msg;
+    int fds[APRILTAG_FRAME_SHARE_MAX_PLANES];
+    int n;
+    while ((n = apriltag_frame_share_receive(sock, &msg, fds)) > 0) {
+        size_t size = msg.planes[0].offset + msg.planes[0].length;
+        void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fds[0], 0);
+        if (memory == MAP_FAILED) {
+            errors++;
+        } else {
+            // Every byte holds the low bits of the frame's sequence, before and
+            // after a delay in which the fake camera keeps running
+            const uint8_t *pixels = static_cast<const uint8_t *>(memory) + msg.planes[0].offset;
+            uint8_t expected = (uint8_t)msg.sequence;
+            usleep(200);
+            for (uint32_t i = 0; i < msg.planes[0].length; i += 97) {
+                if (pixels[i] != expected) {
+                    errors++;
+                    break;
+                }
+            }
+            munmap(memory, size);
+        }
+        if (!(skip_some && msg.sequence % 10 == 0)) {
+            apriltag_frame_share_release(sock, msg.frame_id);
+        }
+        for (int i = 0; i < n; i++) {
+            close(fds[i]);
+        }
+    }
+    close(sock);
+    return errors == 0 && n == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    int frames = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int client_count = argc > 2 ? std::atoi(argv[2]) : 2;
+    std::string path = "/tmp/frame_share_test_" + std::to_string(getpid()) + ".sock";
+
+    std::vector<pid_t> children;
+    for (int i = 0; i < client_count; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(run_client(path, i == 0));
+        }
+        children.push_back(pid);
+    }
+
+    FrameShareServer server;
+    if (!server.start(path, TIMEOUT_MS)) {
+        std::cerr << "Failed to listen on " << path << std::endl;
+        return 1;
+    }
+    server.set_max_held(BUFFERS - 1);
+    while (server.get_client_count() < client_count) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    size_t buffer_size = WIDTH * HEIGHT;
+    int buffer_fds[BUFFERS];
+    uint8_t *buffers[BUFFERS];
+    std::atomic<bool> in_use[BUFFERS];
+    for (int i = 0; i < BUFFERS; i++) {
+        buffer_fds[i] = memfd_create("fake_dmabuf", MFD_CLOEXEC);
+        if (buffer_fds[i] < 0 || ftruncate(buffer_fds[i], buffer_size) != 0) {
+            std::cerr << "memfd_create failed" << std::endl;
+            return 1;
+        }
+        buffers[i] = static_cast<uint8_t *>(mmap(nullptr, buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED, buffer_fds[i], 0));
+        in_use[i] = false;
+    }
+
+    // Fake camera at ~1 kHz: fill a free buffer, share it, "requeue" on release
+    int shared = 0, starved = 0;
+    for (int sequence = 1; sequence <= frames; sequence++) {
+        int index = -1;
+        for (int i = 0; i < BUFFERS && index < 0; i++) {
+            if (!in_use[i]) {
+                index = i;
+            }
+        }
+        if (index < 0) {
+            starved++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        memset(buffers[index], (uint8_t)sequence, buffer_size);
+
+        FrameShareServer::Frame frame;
+        frame.sequence = sequence;
+        frame.timestamp_ns = (uint64_t)sequence * 1000000;
+        frame.width = WIDTH;
+        frame.height = HEIGHT;
+        frame.stride = WIDTH;
+        frame.fourcc = 0x20203852; // "R8  "
+        frame.planes.push_back({ buffer_fds[index], 0, (uint32_t)buffer_size });
+
+        in_use[index] = true;
+        if (server.share(frame, [&in_use, index]() { in_use[index] = false; })) {
+            shared++;
+        } else {
+            in_use[index] = false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Everything held must come back, by release or by timeout
+    std::this_thread::sleep_for(std::chrono::milliseconds(TIMEOUT_MS * 3));
+    int still_held = 0;
+    for (int i = 0; i < BUFFERS; i++) {
+        still_held += in_use[i] ? 1 : 0;
+    }
+    uint64_t timeouts = server.get_timeouts();
+    server.stop();
+
+    int failed_clients = 0;
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        failed_clients += WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+    }
+
+    std::cout << "Frames: " << frames << ", shared: " << shared << ", camera starved: " << starved
+              << ", timeouts: " << timeouts << ", still held: " << still_held
+              << ", failed clients: " << failed_clients << std::endl;
+
+    bool ok = shared > 0 && timeouts > 0 && still_held == 0 && failed_clients == 0;
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
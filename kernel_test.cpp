@@ -0,0 +1,142 @@
+// Checks that every pixel kernel variant this CPU can run matches the scalar
+// one bit for bit, and that scalar unpacking rounds like cv::Mat::convertTo.
+//
+// Usage: ./kernel_test [iterations]
+// Inputs are seeded random rows of odd lengths, so the vector bodies and the
+// scalar tails both run, plus the edge values of the unpack rounding (ties,
+// 0 and 65535). Run it on each target: scalar, SSE4.1 and AVX2 on x86_64,
+// scalar and NEON on arm64.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cpu_kernels.h"
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what) {
+    if (!ok) {
+        failures++;
+        if (failures <= 20) {
+            std::cout << "  mismatch: " << what << std::endl;
+        }
+    }
+}
+
+// The value cv::saturate_cast<uchar>(v * scale) gives: round half to even
+static uint8_t reference_unpack(uint16_t value, int shift) {
+    double scaled = std::nearbyint(value / (double)(1 << shift));
+    return (uint8_t)(scaled > 255.0 ? 255.0 : scaled);
+}
+
+static void test_unpack(const CpuKernels &k, std::mt19937 &rng, int iterations) {
+    for (int shift = 2; shift <= 8; shift++) {
+        // Every tie and its neighbours, then every 16-bit value
+        std::vector<uint16_t> src;
+        for (uint32_t q = 0; q < (65536u >> shift); q++) {
+            uint32_t tie = (q << shift) + (1u << (shift - 1));
+            src.push_back((uint16_t)(tie - 1));
+            src.push_back((uint16_t)tie);
+            src.push_back((uint16_t)std::min<uint32_t>(tie + 1, 65535));
+        }
+        for (uint32_t v = 0; v < 65536; v++) {
+            src.push_back((uint16_t)v);
+        }
+        std::vector<uint8_t> dst(src.size());
+        k.unpack_to_8bit(src.data(), dst.data(), src.size(), shift);
+        for (size_t i = 0; i < src.size(); i++) {
+            if (dst[i] != reference_unpack(src[i], shift)) {
+                check(false, std::string(k.name) + " unpack shift " + std::to_string(shift) +
+                    " value " + std::to_string(src[i]) + " -> " + std::to_string(dst[i]));
+            }
+        }
+    }
+
+    std::uniform_int_distribution<int> length(1, 4099), value(0, 65535);
+    for (int it = 0; it < iterations; it++) {
+        std::vector<uint16_t> src(length(rng));
+        for (uint16_t &v : src) {
+            v = (uint16_t)value(rng);
+        }
+        int shift = it % 2 == 0 ? 8 : 2;
+        std::vector<uint8_t> expected(src.size()), actual(src.size());
+        CPU_KERNELS_SCALAR.unpack_to_8bit(src.data(), expected.data(), src.size(), shift);
+        k.unpack_to_8bit(src.data(), actual.data(), src.size(), shift);
+        check(expected == actual, std::string(k.name) + " unpack random row of " + std::to_string(src.size()));
+    }
+}
+
+static void test_add_rows(const CpuKernels &k, std::mt19937 &rng, int iterations) {
+    std::uniform_int_distribution<int> length(0, 2051);
+    for (int it = 0; it < iterations; it++) {
+        int count = length(rng);
+        std::vector<uint32_t> above(count), expected(count);
+        for (int x = 0; x < count; x++) {
+            above[x] = rng(); // Wraps, as integral rows of large frames do
+            expected[x] = rng();
+        }
+        std::vector<uint32_t> actual = expected;
+        CPU_KERNELS_SCALAR.add_rows(expected.data(), above.data(), count);
+        k.add_rows(actual.data(), above.data(), count);
+        check(expected == actual, std::string(k.name) + " add_rows of " + std::to_string(count));
+    }
+}
+
+// Integral rows of a random image, thresholded at every interior column
+static void test_threshold_row(const CpuKernels &k, std::mt19937 &rng, int iterations) {
+    std::uniform_int_distribution<int> width(8, 1211), pixel(0, 255), radius_dist(1, 12), delta_dist(-10, 10);
+    for (int it = 0; it < iterations; it++) {
+        const int cols = width(rng);
+        const int radius = std::min(radius_dist(rng), (cols - 1) / 2);
+        const int rows = 2 * radius + 1;
+        std::vector<uint8_t> image(rows * cols);
+        for (uint8_t &p : image) {
+            p = (uint8_t)pixel(rng);
+        }
+        std::vector<uint32_t> top(cols + 1, 0), bottom(cols + 1, 0);
+        for (int y = 0; y < rows; y++) {
+            uint32_t running = 0;
+            for (int x = 0; x < cols; x++) {
+                running += image[y * cols + x];
+                bottom[x + 1] += running;
+            }
+        }
+        // Any row works as the pixels under test; the middle one is the real case
+        const uint8_t *src = &image[radius * cols];
+        const int area = rows * (2 * radius + 1);
+        const int delta = delta_dist(rng);
+        std::vector<uint8_t> expected(cols, 7), actual(cols, 7);
+        CPU_KERNELS_SCALAR.threshold_row(src, top.data(), bottom.data(), expected.data(), radius, cols - radius, radius, area, delta);
+        k.threshold_row(src, top.data(), bottom.data(), actual.data(), radius, cols - radius, radius, area, delta);
+        check(expected == actual, std::string(k.name) + " threshold_row cols " + std::to_string(cols) +
+            " radius " + std::to_string(radius));
+    }
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 500;
+    std::mt19937 rng(42);
+
+    std::cout << "Selected variant: " << cpu_kernels().name << std::endl;
+    for (int level = 0; level < CPU_LEVEL_COUNT; level++) {
+        const CpuKernels *k = cpu_kernels_for((CpuLevel)level);
+        if (!k) {
+            continue;
+        }
+        int before = failures;
+        test_unpack(*k, rng, iterations);
+        test_add_rows(*k, rng, iterations);
+        test_threshold_row(*k, rng, iterations);
+        std::cout << "  " << k->name << ": " << (failures == before ? "ok" : "mismatches") << std::endl;
+    }
+
+    bool ok = failures == 0;
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
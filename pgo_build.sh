@@ -0,0 +1,86 @@
+#!/bin/bash
+
+# Profile-guided optimisation build of the extension
+# Builds the library three times and times each build with benchmark_replay:
+#   1. plain, as `scons` builds it, for the baseline frames per second
+#   2. instrumented (pgo=generate), trained by running the benchmark over the frame set
+#   3. rebuilt from that profile with link-time optimisation (pgo=use)
+# The faster of 1 and 3 is left in project/bin.
+#
+# Usage: ./pgo_build.sh [recording.atfr ...]
+# Record representative frames on the rig with detector.start_recording();
+# without recordings the benchmark's synthetic frames are used. Extra scons
+# arguments go in SCONS_ARGS (e.g. SCONS_ARGS="target=template_release"),
+# PGO_SECONDS sets how long each benchmark run lasts (default 10).
+
+set -e
+
+RUN_SECONDS="${PGO_SECONDS:-10}"
+PGO_DIR="$(pwd)/pgo"
+LOG="$(pwd)/pgo_build.log"
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+print_status() {
+    echo -e "${BLUE}[INFO]${NC} $1"
+}
+
+print_success() {
+    echo -e "${GREEN}[SUCCESS]${NC} $1"
+}
+
+print_warning() {
+    echo -e "${YELLOW}[WARNING]${NC} $1"
+}
+
+print_error() {
+    echo -e "${RED}[ERROR]${NC} $1"
+}
+
+# The library and benchmark_replay, from the same objects
+build() {
+    print_status "Building with pgo=$1..."
+    scons -j"$(nproc)" $SCONS_ARGS pgo="$1" pgo_dir="$PGO_DIR" >> "$LOG" 2>&1
+    scons -j"$(nproc)" $SCONS_ARGS pgo="$1" pgo_dir="$PGO_DIR" benchmark_replay >> "$LOG" 2>&1
+}
+
+# Prints the frames per second of one benchmark run
+measure() {
+    ./bin/benchmark_replay "$RUN_SECONDS" "$@" | tee -a "$LOG" | awk '/^fps / { print $2 }'
+}
+
+: > "$LOG"
+
+build none || { print_error "Baseline build failed, see $LOG"; exit 1; }
+BASELINE_FPS=$(measure "$@")
+print_status "Baseline: $BASELINE_FPS fps"
+
+rm -rf "$PGO_DIR"
+build generate || { print_error "Instrumented build failed, see $LOG"; exit 1; }
+print_status "Training on the frame set..."
+measure "$@" > /dev/null
+if [ -z "$(ls -A "$PGO_DIR" 2>/dev/null)" ]; then
+    print_error "Training wrote no profiles to $PGO_DIR"
+    exit 1
+fi
+
+build use || { print_error "Optimised build failed, see $LOG"; exit 1; }
+PGO_FPS=$(measure "$@")
+
+GAIN=$(awk -v base="$BASELINE_FPS" -v pgo="$PGO_FPS" 'BEGIN { printf "%+.1f", (pgo / base - 1) * 100 }')
+echo ""
+echo "  plain build   $BASELINE_FPS fps"
+echo "  PGO + LTO     $PGO_FPS fps ($GAIN%)"
+echo ""
+
+if awk -v base="$BASELINE_FPS" -v pgo="$PGO_FPS" 'BEGIN { exit !(pgo > base) }'; then
+    print_success "Keeping the PGO build in project/bin"
+else
+    print_warning "PGO was not faster on this frame set; rebuilding the plain library"
+    build none
+fi
@@ -125,6 +125,7 @@ func update_detection_display():
 func _on_video_toggle_pressed():
 	video_enabled = not video_enabled
 	apriltag_detector.set_video_feedback_enabled(video_enabled)
+	apriltag_detector.set_preview_overlay_enabled(video_enabled)
 	
 	if video_enabled:
 		video_toggle_button.text = "Disable Video"
@@ -0,0 +1,98 @@
+#include "adaptive_threshold.h"
+#include "cpu_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Sums are accumulated as uint32 and may wrap on very large frames; window sums
+// are differences of four entries, so modular arithmetic still yields the exact
+// value as long as a single window holds less than 2^31.
+
+static void integral_row(const uint8_t *src, const uint32_t *above, uint32_t *out, int cols) {
+	// Horizontal prefix sum is a serial dependency chain, keep it scalar
+	uint32_t running = 0;
+	out[0] = 0;
+	for (int x = 0; x < cols; x++) {
+		running += src[x];
+		out[x + 1] = running;
+	}
+
+	// Adding the row above is independent per column
+	cpu_kernels().add_rows(out + 1, above + 1, cols);
+}
+
+static inline uint8_t threshold_pixel(uint8_t value, uint32_t sum, int area, int delta) {
+	return (int32_t)(value + delta) * area <= (int32_t)sum ? 255 : 0;
+}
+
+void AdaptiveThreshold::prepare(const cv::Mat &gray) {
+	source = gray;
+	integral.create(gray.rows + 1, gray.cols + 1, CV_32SC1);
+
+	memset(integral.ptr<uint32_t>(0), 0, (gray.cols + 1) * sizeof(uint32_t));
+	for (int y = 0; y < gray.rows; y++) {
+		integral_row(gray.ptr<uint8_t>(y), integral.ptr<uint32_t>(y), integral.ptr<uint32_t>(y + 1), gray.cols);
+	}
+}
+
+void AdaptiveThreshold::apply(int window_size, double constant, cv::Mat &binary, const DetectionMask *mask, cv::Rect region) const {
+	const int rows = source.rows;
+	const int cols = source.cols;
+	const int radius = window_size / 2;
+	// Matches cv::adaptiveThreshold, which floors the constant for THRESH_BINARY_INV
+	const int delta = (int)std::floor(constant);
+
+	binary.create(rows, cols, CV_8UC1);
+
+	region = region.empty() ? cv::Rect(0, 0, cols, rows) : (region & cv::Rect(0, 0, cols, rows));
+	const int xa = region.x;
+	const int xb = region.x + region.width;
+
+	const int x_begin = std::min(radius, cols);
+	const int x_end = std::max(x_begin, cols - radius);
+	const bool masked = mask && !mask->empty();
+	const CpuKernels &kernels = cpu_kernels();
+
+	for (int y = region.y; y < region.y + region.height; y++) {
+		if (masked && !mask->row_active(y)) {
+			memset(binary.ptr<uint8_t>(y) + xa, 0, xb - xa);
+			continue;
+		}
+
+		const int y0 = std::max(0, y - radius);
+		const int y1 = std::min(rows, y + radius + 1);
+		const uint32_t *top = integral.ptr<uint32_t>(y0);
+		const uint32_t *bottom = integral.ptr<uint32_t>(y1);
+		const uint8_t *src = source.ptr<uint8_t>(y);
+		uint8_t *dst = binary.ptr<uint8_t>(y);
+
+		// Windows clipped at the left/right edges are averaged over their visible area
+		for (int x = xa; x < std::min(x_begin, xb); x++) {
+			const int x0 = 0;
+			const int x1 = std::min(cols, x + radius + 1);
+			uint32_t sum = (bottom[x1] - bottom[x0]) - (top[x1] - top[x0]);
+			dst[x] = threshold_pixel(src[x], sum, (y1 - y0) * (x1 - x0), delta);
+		}
+
+		const int interior_begin = std::max(x_begin, xa);
+		const int interior_end = std::min(x_end, xb);
+		if (interior_begin < interior_end) {
+			kernels.threshold_row(src, top, bottom, dst, interior_begin, interior_end, radius, (y1 - y0) * window_size, delta);
+		}
+
+		for (int x = std::max(x_end, xa); x < xb; x++) {
+			const int x0 = std::max(0, x - radius);
+			const int x1 = cols;
+			uint32_t sum = (bottom[x1] - bottom[x0]) - (top[x1] - top[x0]);
+			dst[x] = threshold_pixel(src[x], sum, (y1 - y0) * (x1 - x0), delta);
+		}
+
+		if (masked) {
+			const uint8_t *keep = mask->get().ptr<uint8_t>(y);
+			for (int x = xa; x < xb; x++) {
+				dst[x] &= keep[x];
+			}
+		}
+	}
+}
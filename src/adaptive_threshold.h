@@ -0,0 +1,35 @@
+#ifndef ADAPTIVE_THRESHOLD_H
+#define ADAPTIVE_THRESHOLD_H
+
+#include "detection_mask.h"
+
+#include <opencv2/core.hpp>
+
+// Mean-C adaptive threshold derived from a single integral image.
+//
+// cv::aruco calls cv::adaptiveThreshold once per window size, re-reading the
+// whole frame each time. Here the integral image is built once per frame and
+// every window size is answered from it with four lookups per pixel. Output
+// follows ADAPTIVE_THRESH_MEAN_C + THRESH_BINARY_INV: 255 where a pixel is at
+// least `constant` darker than its local mean, 0 elsewhere.
+class AdaptiveThreshold {
+public:
+	// Build the integral image for a CV_8UC1 frame. Call once per frame.
+	void prepare(const cv::Mat &gray);
+
+	// Threshold the prepared frame with an odd window size (>= 3). Pixels
+	// outside `mask` come out 0, and rows without any unmasked pixel are not
+	// computed at all. With a non-empty `region` only that part of the
+	// frame-sized `binary` is written; windows still see the whole frame, so
+	// the result inside matches a full-frame pass.
+	void apply(int window_size, double constant, cv::Mat &binary, const DetectionMask *mask = nullptr,
+			cv::Rect region = cv::Rect()) const;
+
+	bool is_prepared() const { return !source.empty(); }
+
+private:
+	cv::Mat source;   // Shallow reference to the prepared frame
+	cv::Mat integral; // (rows + 1) x (cols + 1), uint32 sums stored as CV_32SC1
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <godot_cpp/variant/utility_functions.hpp>
 #include <godot_cpp/classes/file_access.hpp>
 #include <godot_cpp/classes/json.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
 #include <godot_cpp/classes/ref.hpp>
 #include <fstream>
 #include <sstream>
@@ -20,6 +21,94 @@ using namespace libcamera;
 static std::vector<AprilTagDetector::DetectionResult> latest_detections;
 static std::mutex detection_mutex;
 
+// Marker families that can be enabled by name
+static const struct {
+	const char *name;
+	cv::aruco::PredefinedDictionaryType type;
+} MARKER_FAMILIES[] = {
+	{ "apriltag_36h11", cv::aruco::DICT_APRILTAG_36h11 },
+	{ "apriltag_36h10", cv::aruco::DICT_APRILTAG_36h10 },
+	{ "apriltag_25h9", cv::aruco::DICT_APRILTAG_25h9 },
+	{ "apriltag_16h5", cv::aruco::DICT_APRILTAG_16h5 },
+	{ "aruco_4x4_50", cv::aruco::DICT_4X4_50 },
+	{ "aruco_4x4_100", cv::aruco::DICT_4X4_100 },
+	{ "aruco_4x4_250", cv::aruco::DICT_4X4_250 },
+	{ "aruco_4x4_1000", cv::aruco::DICT_4X4_1000 },
+	{ "aruco_5x5_50", cv::aruco::DICT_5X5_50 },
+	{ "aruco_5x5_100", cv::aruco::DICT_5X5_100 },
+	{ "aruco_5x5_250", cv::aruco::DICT_5X5_250 },
+	{ "aruco_5x5_1000", cv::aruco::DICT_5X5_1000 },
+	{ "aruco_6x6_50", cv::aruco::DICT_6X6_50 },
+	{ "aruco_6x6_100", cv::aruco::DICT_6X6_100 },
+	{ "aruco_6x6_250", cv::aruco::DICT_6X6_250 },
+	{ "aruco_6x6_1000", cv::aruco::DICT_6X6_1000 },
+	{ "aruco_original", cv::aruco::DICT_ARUCO_ORIGINAL },
+};
+
+static bool find_predefined_dictionary(const std::string &name, cv::aruco::Dictionary &dictionary) {
+	for (const auto& entry : MARKER_FAMILIES) {
+		if (name == entry.name) {
+			dictionary = cv::aruco::getPredefinedDictionary(entry.type);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Index of `name` in the configuration's families, appended disabled if it
+// is a known dictionary but not there yet; -1 for unknown names
+static int find_or_add_marker_family(AprilTagDetector::DetectorConfig &next, const String &family) {
+	std::string name = family.utf8().get_data();
+	int index = next.find_family(name);
+	if (index >= 0) {
+		return index;
+	}
+	
+	cv::aruco::Dictionary dictionary;
+	if (!find_predefined_dictionary(name, dictionary)) {
+		UtilityFunctions::print("Unknown marker family: ", family);
+		return -1;
+	}
+	next.families.push_back({ MarkerFamily::create(name, dictionary), false, 0.0 });
+	next.families_version++;
+	return (int)next.families.size() - 1;
+}
+
+// Model corners of a square marker, same order and frame as estimatePoseSingleMarkers
+static std::vector<cv::Point3f> marker_object_points(double size) {
+	float half = (float)(size / 2.0);
+	return { { -half, half, 0 }, { half, half, 0 }, { half, -half, 0 }, { -half, -half, 0 } };
+}
+
+// Stage spans reuse the clock readings taken for the stats
+static void trace_stage(const char *name, PipelineStats::Clock::time_point begin, uint64_t frame) {
+	if (FrameTrace::is_enabled()) {
+		uint64_t begin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(begin.time_since_epoch()).count();
+		FrameTrace::record(name, begin_ns, FrameTrace::now_ns(), frame);
+	}
+}
+
+// Fills apriltag_shm_marker and LogMarker, which share their field names;
+// flags are format specific and left to the caller
+template <typename Record>
+static void fill_marker_record(const DetectedMarker &marker, const AprilTagDetector::DetectionResult &result, Record &record) {
+	record.id = result.marker_id;
+	record.family = marker.family;
+	for (int k = 0; k < 4; k++) {
+		record.corners[k * 2] = marker.corners[k].x;
+		record.corners[k * 2 + 1] = marker.corners[k].y;
+	}
+	record.rvec[0] = result.rvec.x;
+	record.rvec[1] = result.rvec.y;
+	record.rvec[2] = result.rvec.z;
+	record.tvec[0] = result.tvec.x;
+	record.tvec[1] = result.tvec.y;
+	record.tvec[2] = result.tvec.z;
+	record.hamming = result.hamming;
+	record.sharpness = result.sharpness;
+	record.reprojection_error = (float)result.reprojection_error;
+}
+
 // Static instance pointer
 AprilTagDetector* AprilTagDetector::current_instance = nullptr;
 
@@ -39,27 +128,156 @@ void AprilTagDetector::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_distortion_coefficients", "coeffs"), &AprilTagDetector::set_distortion_coefficients);
 	ClassDB::bind_method(D_METHOD("set_marker_size", "size"), &AprilTagDetector::set_marker_size);
 	ClassDB::bind_method(D_METHOD("get_camera_matrix"), &AprilTagDetector::get_camera_matrix);
+	ClassDB::bind_method(D_METHOD("set_distortion_model", "model"), &AprilTagDetector::set_distortion_model);
+	ClassDB::bind_method(D_METHOD("get_distortion_model"), &AprilTagDetector::get_distortion_model);
+	ClassDB::bind_method(D_METHOD("set_detector_parameters", "parameters"), &AprilTagDetector::set_detector_parameters);
+	ClassDB::bind_method(D_METHOD("get_detector_parameters"), &AprilTagDetector::get_detector_parameters);
 	ClassDB::bind_method(D_METHOD("get_distortion_coefficients"), &AprilTagDetector::get_distortion_coefficients);
 	ClassDB::bind_method(D_METHOD("get_current_frame_texture"), &AprilTagDetector::get_current_frame_texture);
 	ClassDB::bind_method(D_METHOD("set_video_feedback_enabled", "enabled"), &AprilTagDetector::set_video_feedback_enabled);
 	ClassDB::bind_method(D_METHOD("get_video_feedback_enabled"), &AprilTagDetector::get_video_feedback_enabled);
+	ClassDB::bind_method(D_METHOD("set_preview_overlay_enabled", "enabled"), &AprilTagDetector::set_preview_overlay_enabled);
+	ClassDB::bind_method(D_METHOD("get_preview_overlay_enabled"), &AprilTagDetector::get_preview_overlay_enabled);
+	ClassDB::bind_method(D_METHOD("set_detection_engine_enabled", "enabled"), &AprilTagDetector::set_detection_engine_enabled);
+	ClassDB::bind_method(D_METHOD("get_detection_engine_enabled"), &AprilTagDetector::get_detection_engine_enabled);
+	ClassDB::bind_method(D_METHOD("set_run_segmentation_enabled", "enabled"), &AprilTagDetector::set_run_segmentation_enabled);
+	ClassDB::bind_method(D_METHOD("get_run_segmentation_enabled"), &AprilTagDetector::get_run_segmentation_enabled);
+	ClassDB::bind_method(D_METHOD("set_batched_pose_enabled", "enabled"), &AprilTagDetector::set_batched_pose_enabled);
+	ClassDB::bind_method(D_METHOD("get_batched_pose_enabled"), &AprilTagDetector::get_batched_pose_enabled);
+	ClassDB::bind_method(D_METHOD("set_pose_refinement_iterations", "iterations"), &AprilTagDetector::set_pose_refinement_iterations);
+	ClassDB::bind_method(D_METHOD("get_pose_refinement_iterations"), &AprilTagDetector::get_pose_refinement_iterations);
+	ClassDB::bind_method(D_METHOD("set_pose_disambiguation_enabled", "enabled"), &AprilTagDetector::set_pose_disambiguation_enabled);
+	ClassDB::bind_method(D_METHOD("get_pose_disambiguation_enabled"), &AprilTagDetector::get_pose_disambiguation_enabled);
+	ClassDB::bind_method(D_METHOD("set_pose_ambiguity_ratio", "ratio"), &AprilTagDetector::set_pose_ambiguity_ratio);
+	ClassDB::bind_method(D_METHOD("get_pose_ambiguity_ratio"), &AprilTagDetector::get_pose_ambiguity_ratio);
+	ClassDB::bind_method(D_METHOD("set_marker_family_enabled", "family", "enabled"), &AprilTagDetector::set_marker_family_enabled);
+	ClassDB::bind_method(D_METHOD("set_marker_family_size", "family", "size"), &AprilTagDetector::set_marker_family_size);
+	ClassDB::bind_method(D_METHOD("get_marker_families"), &AprilTagDetector::get_marker_families);
+	ClassDB::bind_method(D_METHOD("add_detection_roi", "polygon"), &AprilTagDetector::add_detection_roi);
+	ClassDB::bind_method(D_METHOD("add_detection_exclusion", "polygon"), &AprilTagDetector::add_detection_exclusion);
+	ClassDB::bind_method(D_METHOD("clear_detection_regions"), &AprilTagDetector::clear_detection_regions);
+	ClassDB::bind_method(D_METHOD("add_expected_markers", "family", "ids"), &AprilTagDetector::add_expected_markers);
+	ClassDB::bind_method(D_METHOD("clear_expected_markers"), &AprilTagDetector::clear_expected_markers);
+	ClassDB::bind_method(D_METHOD("set_expected_search_budget_us", "budget_us"), &AprilTagDetector::set_expected_search_budget_us);
+	ClassDB::bind_method(D_METHOD("get_expected_search_budget_us"), &AprilTagDetector::get_expected_search_budget_us);
+	ClassDB::bind_method(D_METHOD("set_frame_budget_us", "budget_us"), &AprilTagDetector::set_frame_budget_us);
+	ClassDB::bind_method(D_METHOD("get_frame_budget_us"), &AprilTagDetector::get_frame_budget_us);
+	ClassDB::bind_method(D_METHOD("is_last_frame_complete"), &AprilTagDetector::is_last_frame_complete);
+	ClassDB::bind_method(D_METHOD("set_max_decode_hamming", "bits"), &AprilTagDetector::set_max_decode_hamming);
+	ClassDB::bind_method(D_METHOD("get_max_decode_hamming"), &AprilTagDetector::get_max_decode_hamming);
+	ClassDB::bind_method(D_METHOD("set_min_corner_sharpness", "sharpness"), &AprilTagDetector::set_min_corner_sharpness);
+	ClassDB::bind_method(D_METHOD("get_min_corner_sharpness"), &AprilTagDetector::get_min_corner_sharpness);
+	ClassDB::bind_method(D_METHOD("set_max_reprojection_error", "pixels"), &AprilTagDetector::set_max_reprojection_error);
+	ClassDB::bind_method(D_METHOD("get_max_reprojection_error"), &AprilTagDetector::get_max_reprojection_error);
+	ClassDB::bind_method(D_METHOD("start_shared_memory_publisher", "name"), &AprilTagDetector::start_shared_memory_publisher, DEFVAL(APRILTAG_SHM_DEFAULT_NAME));
+	ClassDB::bind_method(D_METHOD("stop_shared_memory_publisher"), &AprilTagDetector::stop_shared_memory_publisher);
+	ClassDB::bind_method(D_METHOD("start_frame_sharing", "socket_path", "timeout_ms"), &AprilTagDetector::start_frame_sharing, DEFVAL(APRILTAG_FRAME_SHARE_DEFAULT_PATH), DEFVAL(100));
+	ClassDB::bind_method(D_METHOD("stop_frame_sharing"), &AprilTagDetector::stop_frame_sharing);
+	ClassDB::bind_method(D_METHOD("set_frame_sharing_max_held", "frames"), &AprilTagDetector::set_frame_sharing_max_held);
+	ClassDB::bind_method(D_METHOD("get_frame_sharing_max_held"), &AprilTagDetector::get_frame_sharing_max_held);
+	ClassDB::bind_method(D_METHOD("start_detection_log", "path"), &AprilTagDetector::start_detection_log);
+	ClassDB::bind_method(D_METHOD("stop_detection_log"), &AprilTagDetector::stop_detection_log);
+	ClassDB::bind_method(D_METHOD("is_detection_log_open"), &AprilTagDetector::is_detection_log_open);
+	ClassDB::bind_method(D_METHOD("start_trace"), &AprilTagDetector::start_trace);
+	ClassDB::bind_method(D_METHOD("stop_trace"), &AprilTagDetector::stop_trace);
+	ClassDB::bind_method(D_METHOD("is_tracing"), &AprilTagDetector::is_tracing);
+	ClassDB::bind_method(D_METHOD("dump_trace", "path"), &AprilTagDetector::dump_trace);
+	ClassDB::bind_method(D_METHOD("start_frame_recording", "path"), &AprilTagDetector::start_frame_recording);
+	ClassDB::bind_method(D_METHOD("stop_frame_recording"), &AprilTagDetector::stop_frame_recording);
+	ClassDB::bind_method(D_METHOD("start_replay", "path", "speed", "loop", "buffers"), &AprilTagDetector::start_replay, DEFVAL(1.0), DEFVAL(false), DEFVAL(4));
+	ClassDB::bind_method(D_METHOD("stop_replay"), &AprilTagDetector::stop_replay);
+	ClassDB::bind_method(D_METHOD("is_replaying"), &AprilTagDetector::is_replaying);
+	ClassDB::bind_method(D_METHOD("get_replay_report"), &AprilTagDetector::get_replay_report);
+	ClassDB::bind_method(D_METHOD("initialize_stereo_camera"), &AprilTagDetector::initialize_stereo_camera);
+	ClassDB::bind_method(D_METHOD("has_stereo_calibration"), &AprilTagDetector::has_stereo_calibration);
+	ClassDB::bind_method(D_METHOD("set_stereo_time_tolerance_ms", "tolerance_ms"), &AprilTagDetector::set_stereo_time_tolerance_ms);
+	ClassDB::bind_method(D_METHOD("get_stereo_time_tolerance_ms"), &AprilTagDetector::get_stereo_time_tolerance_ms);
+	ClassDB::bind_method(D_METHOD("get_latest_stereo_detections"), &AprilTagDetector::get_latest_stereo_detections);
+	ClassDB::bind_method(D_METHOD("set_calibration_board_charuco", "squares_x", "squares_y", "square_length", "marker_length", "family"), &AprilTagDetector::set_calibration_board_charuco, DEFVAL("aruco_4x4_50"));
+	ClassDB::bind_method(D_METHOD("set_calibration_board_aprilgrid", "columns", "rows", "tag_size", "tag_spacing", "family"), &AprilTagDetector::set_calibration_board_aprilgrid, DEFVAL(0.3), DEFVAL("apriltag_36h11"));
+	ClassDB::bind_method(D_METHOD("start_calibration"), &AprilTagDetector::start_calibration);
+	ClassDB::bind_method(D_METHOD("stop_calibration"), &AprilTagDetector::stop_calibration);
+	ClassDB::bind_method(D_METHOD("is_calibrating"), &AprilTagDetector::is_calibrating);
+	ClassDB::bind_method(D_METHOD("get_calibration_status"), &AprilTagDetector::get_calibration_status);
+	ClassDB::bind_method(D_METHOD("save_calibration", "json_path"), &AprilTagDetector::save_calibration);
+	ClassDB::bind_method(D_METHOD("apply_calibration"), &AprilTagDetector::apply_calibration);
+	ClassDB::bind_method(D_METHOD("set_contrast_mode", "mode"), &AprilTagDetector::set_contrast_mode);
+	ClassDB::bind_method(D_METHOD("get_contrast_mode"), &AprilTagDetector::get_contrast_mode);
+	ClassDB::bind_method(D_METHOD("set_clahe_parameters", "clip_limit", "tile_grid"), &AprilTagDetector::set_clahe_parameters);
+	ClassDB::bind_method(D_METHOD("set_local_normalization_window", "window_size"), &AprilTagDetector::set_local_normalization_window);
+	ClassDB::bind_method(D_METHOD("get_stats"), &AprilTagDetector::get_stats);
+	ClassDB::bind_method(D_METHOD("reset_stats"), &AprilTagDetector::reset_stats);
 }
 
-AprilTagDetector::AprilTagDetector() : is_initialized(false), marker_size(0.05), camera_running(false), video_feedback_enabled(false) {
+AprilTagDetector::AprilTagDetector() : applied_params_version(0), applied_families_version(0), applied_regions_version(0), applied_expected_version(0), stereo_params_version(0), stereo_families_version(0), pose_tracker_reset(false), last_frame_complete(true), shm_family_count(0), has_stereo_section(false), camera_running(false), video_feedback_enabled(false), preview_overlay_enabled(false) {
 	UtilityFunctions::print("AprilTagDetector constructor called");
 	try {
 		aruco_dict = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_APRILTAG_36h11);
-		detector_params = cv::aruco::DetectorParameters();
-		detector = cv::aruco::ArucoDetector(aruco_dict, detector_params);
+		cv::aruco::DetectorParameters params = config.copy().detector_params;
+		detector = cv::aruco::ArucoDetector(aruco_dict, params);
+		detection_engine.set_parameters(params);
+		
+		// Family 0 is apriltag_36h11, matching `detector`; its table is built here, not on the first frame
+		config.update([&](DetectorConfig& next) {
+			std::shared_ptr<const MarkerFamily> family = MarkerFamily::create("apriltag_36h11", aruco_dict);
+			next.families.push_back({ MarkerFamily::with_table(family, params.errorCorrectionRate), true, 0.0 });
+			next.families_version++;
+			return true;
+		});
 		current_instance = this;  // Set static instance
-		UtilityFunctions::print("AprilTagDetector created successfully");
+		UtilityFunctions::print("AprilTagDetector created successfully, ", String(cpu_kernels().name), " pixel kernels");
 	} catch (const std::exception& e) {
 		UtilityFunctions::print("Exception in AprilTagDetector constructor: ", String(e.what()));
 	}
 }
 
 AprilTagDetector::~AprilTagDetector() {
+	replay.stop();
 	stop_camera();
+	stereo.stop();
+	calibrator.stop();
+}
+
+// Reads a rows x cols matrix written as nested arrays, as in the "calibration" section
+static bool parse_json_matrix(const Array &rows_array, int rows, int cols, std::vector<double> &out) {
+	if (rows_array.size() != rows) {
+		return false;
+	}
+	out.clear();
+	for (int i = 0; i < rows; i++) {
+		Array row = rows_array[i];
+		if (row.size() != cols) {
+			return false;
+		}
+		for (int j = 0; j < cols; j++) {
+			out.push_back(row[j]);
+		}
+	}
+	return true;
+}
+
+// "dist_coeffs" as [[k1], [k2], ...] with the count of an OpenCV model, and
+// the optional "distortion_model": "pinhole" (default) or "fisheye"
+static bool parse_distortion(const Dictionary &section, cv::Mat &coeffs, LensModel::Model &model) {
+	model = LensModel::MODEL_PINHOLE;
+	if (section.has("distortion_model")) {
+		String name = section["distortion_model"];
+		if (name == "fisheye") {
+			model = LensModel::MODEL_FISHEYE;
+		} else if (name != "pinhole") {
+			UtilityFunctions::print("Unknown distortion model: ", name);
+			return false;
+		}
+	}
+	
+	Array coeffs_array = section["dist_coeffs"];
+	std::vector<double> data;
+	if (!parse_json_matrix(coeffs_array, coeffs_array.size(), 1, data) || !LensModel::valid_coefficient_count(model, (int)data.size())) {
+		UtilityFunctions::print("Invalid distortion coefficients: pinhole takes 4, 5, 8, 12 or 14, fisheye 4");
+		return false;
+	}
+	coeffs = cv::Mat((int)data.size(), 1, CV_64F, data.data()).clone();
+	return true;
 }
 
 bool AprilTagDetector::load_camera_parameters(const String &json_path) {
@@ -112,30 +330,128 @@ bool AprilTagDetector::load_camera_parameters(const String &json_path) {
 	}
 
 	// Parse distortion coefficients
-	Array dist_coeffs_array = calibration["dist_coeffs"];
-	if (dist_coeffs_array.size() != 4) {
-		UtilityFunctions::print("Invalid distortion coefficients size");
+	cv::Mat coeffs;
+	LensModel::Model model;
+	if (!parse_distortion(calibration, coeffs, model)) {
 		return false;
 	}
 
-	std::vector<double> dist_coeffs_data;
-	for (int i = 0; i < 4; i++) {
-		Array coeff = dist_coeffs_array[i];
-		if (coeff.size() != 1) {
-			UtilityFunctions::print("Invalid distortion coefficient format");
+	// Written by save_calibration; older files leave the resolution unknown
+	cv::Size size;
+	if (calibration.has("resolution")) {
+		Array resolution = calibration["resolution"];
+		if (resolution.size() != 2) {
+			UtilityFunctions::print("Invalid calibration resolution");
 			return false;
 		}
-		dist_coeffs_data.push_back(coeff[0]);
+		size = cv::Size((int)resolution[0], (int)resolution[1]);
+	}
+	
+	// Streaming frames switch over to the new lens on their next frame
+	cv::Matx33d matrix(camera_matrix_data.data());
+	config.update([&](DetectorConfig& next) {
+		next.has_camera_matrix = true;
+		next.camera_matrix = matrix;
+		next.dist_coeffs = coeffs;
+		next.distortion_model = model;
+		next.calibration_size = size;
+		return true;
+	});
+	
+	// Optional second camera of a stereo pair; otherwise a stereo camera keeps
+	// the section loaded before, now against the new first camera
+	if (data.has("stereo")) {
+		if (!load_stereo_calibration(data["stereo"])) {
+			return false;
+		}
+	} else {
+		update_stereo_calibration();
 	}
-
-	camera_matrix = cv::Mat(3, 3, CV_64F, camera_matrix_data.data()).clone();
-	dist_coeffs = cv::Mat(4, 1, CV_64F, dist_coeffs_data.data()).clone();
 	
-	is_initialized = true;
 	UtilityFunctions::print("Camera parameters loaded successfully");
 	return true;
 }
 
+// Second camera's intrinsics and its pose relative to the first, as from
+// cv::stereoCalibrate: x1 = R x0 + T with T in metres
+bool AprilTagDetector::load_stereo_calibration(const Dictionary &section) {
+	if (!section.has("camera_matrix") || !section.has("dist_coeffs") || !section.has("rotation") || !section.has("translation")) {
+		UtilityFunctions::print("Stereo section needs camera_matrix, dist_coeffs, rotation and translation");
+		return false;
+	}
+	
+	std::vector<double> matrix_data, rotation_data, translation_data;
+	cv::Mat coeffs;
+	LensModel::Model model;
+	if (!parse_distortion(section, coeffs, model)) {
+		return false;
+	}
+	if (!parse_json_matrix(section["camera_matrix"], 3, 3, matrix_data) ||
+			!parse_json_matrix(section["rotation"], 3, 3, rotation_data) ||
+			!parse_json_matrix(section["translation"], 3, 1, translation_data)) {
+		UtilityFunctions::print("Invalid stereo calibration structure");
+		return false;
+	}
+	
+	// Without its own resolution the second camera was calibrated like the first
+	cv::Size size = config.copy().calibration_size;
+	if (section.has("resolution")) {
+		Array resolution = section["resolution"];
+		if (resolution.size() != 2) {
+			UtilityFunctions::print("Invalid stereo calibration resolution");
+			return false;
+		}
+		size = cv::Size((int)resolution[0], (int)resolution[1]);
+	}
+	
+	stereo_section.camera_matrix = cv::Matx33d(matrix_data.data());
+	stereo_section.dist_coeffs = coeffs;
+	stereo_section.distortion_model = model;
+	stereo_section.calibration_size = size;
+	stereo_section.rotation = cv::Matx33d(rotation_data.data());
+	stereo_section.translation = cv::Vec3d(translation_data[0], translation_data[1], translation_data[2]);
+	has_stereo_section = true;
+	update_stereo_calibration();
+	
+	UtilityFunctions::print("Stereo calibration loaded, baseline ", String::num(cv::norm(stereo_section.translation), 3), " m");
+	return true;
+}
+
+static cv::Matx33d scale_camera_matrix(cv::Matx33d matrix, const cv::Size &from, const cv::Size &to) {
+	if (from.empty() || to.empty() || from == to) {
+		return matrix;
+	}
+	double scale_x = (double)to.width / from.width;
+	double scale_y = (double)to.height / from.height;
+	matrix(0, 0) *= scale_x;
+	matrix(1, 1) *= scale_y;
+	matrix(0, 2) *= scale_x;
+	matrix(1, 2) *= scale_y;
+	return matrix;
+}
+
+// Both cameras' intrinsics at their stream resolution, once both streams are
+// configured; the matcher takes them up from its next pair
+void AprilTagDetector::update_stereo_calibration() {
+	if (!has_stereo_section || !stereo_camera || stream_size.empty() || stereo_stream_size.empty()) {
+		return;
+	}
+	DetectorConfig first = config.copy();
+	if (!first.has_camera_matrix) {
+		return;
+	}
+	StereoCalibration calibration;
+	calibration.lens[0].set(scale_camera_matrix(first.camera_matrix, first.calibration_size, stream_size),
+		first.dist_coeffs, first.distortion_model);
+	calibration.lens[0].prepare(stream_size);
+	calibration.lens[1].set(scale_camera_matrix(stereo_section.camera_matrix, stereo_section.calibration_size, stereo_stream_size),
+		stereo_section.dist_coeffs, stereo_section.distortion_model);
+	calibration.lens[1].prepare(stereo_stream_size);
+	calibration.rotation = stereo_section.rotation;
+	calibration.translation = stereo_section.translation;
+	stereo.set_calibration(calibration);
+}
+
 bool AprilTagDetector::initialize_camera() {
 	if (camera_running) {
 		UtilityFunctions::print("Camera already running");
@@ -156,8 +472,27 @@ bool AprilTagDetector::initialize_camera() {
 	camera = camera_manager->get(cameraId);
 	camera->acquire();
 
+	if (!configure_camera(camera, allocator, requests, 0, stream_size)) {
+		return false;
+	}
+	
+	// Calibrations made at another resolution are rescaled to the stream's
+	cv::Size calibration_size = config.copy().calibration_size;
+	if (!calibration_size.empty() && calibration_size != stream_size) {
+		adjust_camera_matrix_for_resolution(stream_size.width, stream_size.height, calibration_size.width, calibration_size.height);
+	}
+	update_stereo_calibration();
+
+	UtilityFunctions::print("Camera initialized successfully");
+	return true;
+}
+
+// Stream, buffers and requests; `cookie` tells the completion callback which camera a request belongs to
+bool AprilTagDetector::configure_camera(std::shared_ptr<Camera> cam, std::unique_ptr<FrameBufferAllocator>& alloc,
+		std::vector<std::unique_ptr<Request>>& reqs, uint64_t cookie, cv::Size& size) {
+
 	// Configure camera - Match Python configuration (but use R8 instead of YUV420)
-	std::unique_ptr<CameraConfiguration> config = camera->generateConfiguration({ StreamRole::VideoRecording });
+	std::unique_ptr<CameraConfiguration> config = cam->generateConfiguration({ StreamRole::VideoRecording });
 	StreamConfiguration &streamConfig = config->at(0);
 
 	streamConfig.size.width = 1200;   // Match camera calibration parameters
@@ -176,17 +511,18 @@ bool AprilTagDetector::initialize_camera() {
 	UtilityFunctions::print("Validated config: ", String::num_int64(streamConfig.size.width), "x", 
 		String::num_int64(streamConfig.size.height), " ", String(streamConfig.pixelFormat.toString().c_str()));
 
-	camera->configure(config.get());
+	cam->configure(config.get());
+	size = cv::Size(streamConfig.size.width, streamConfig.size.height);
 	
 	// Debug output to match working version
 	UtilityFunctions::print("Configuration: ", String::num_int64(streamConfig.size.width), "x", 
 		String::num_int64(streamConfig.size.height), " ", String(streamConfig.pixelFormat.toString().c_str()));
 
 	// Create frame buffers
-	allocator = std::make_unique<FrameBufferAllocator>(camera);
+	alloc = std::make_unique<FrameBufferAllocator>(cam);
 	
 	for (StreamConfiguration &cfg : *config) {
-		int ret = allocator->allocate(cfg.stream());
+		int ret = alloc->allocate(cfg.stream());
 		if (ret < 0) {
 			UtilityFunctions::print("Can't allocate buffers");
 			return false;
@@ -195,10 +531,10 @@ bool AprilTagDetector::initialize_camera() {
 
 	// Create requests
 	Stream *stream = streamConfig.stream();
-	const std::vector<std::unique_ptr<FrameBuffer>> &buffers = allocator->buffers(stream);
+	const std::vector<std::unique_ptr<FrameBuffer>> &buffers = alloc->buffers(stream);
 	
 	for (unsigned int i = 0; i < buffers.size(); ++i) {
-		std::unique_ptr<Request> request = camera->createRequest();
+		std::unique_ptr<Request> request = cam->createRequest(cookie);
 		if (!request) {
 			UtilityFunctions::print("Can't create request");
 			return false;
@@ -213,10 +549,48 @@ bool AprilTagDetector::initialize_camera() {
 
 		// Don't set controls per request - will set globally at start
 
-		requests.push_back(std::move(request));
+		reqs.push_back(std::move(request));
 	}
 
-	UtilityFunctions::print("Camera initialized successfully");
+	return true;
+}
+
+bool AprilTagDetector::initialize_stereo_camera() {
+	if (!camera_manager || !camera) {
+		UtilityFunctions::print("Initialize the first camera before the stereo camera");
+		return false;
+	}
+	if (camera_running) {
+		UtilityFunctions::print("Camera already running");
+		return false;
+	}
+	if (!has_stereo_section) {
+		UtilityFunctions::print("Camera parameters have no 'stereo' section");
+		return false;
+	}
+	if (stereo_camera) {
+		return true;
+	}
+
+	auto cameras = camera_manager->cameras();
+	if (cameras.size() < 2) {
+		UtilityFunctions::print("Stereo needs two cameras, found ", String::num_int64(cameras.size()));
+		return false;
+	}
+
+	stereo_camera = camera_manager->get(cameras[1]->id());
+	stereo_camera->acquire();
+	if (!configure_camera(stereo_camera, stereo_allocator, stereo_requests, STEREO_CAMERA_COOKIE, stereo_stream_size)) {
+		stereo_requests.clear();
+		stereo_allocator.reset();
+		stereo_camera->release();
+		stereo_camera.reset();
+		stereo_stream_size = cv::Size();
+		return false;
+	}
+	update_stereo_calibration();
+
+	UtilityFunctions::print("Stereo camera initialized successfully");
 	return true;
 }
 
@@ -241,9 +615,11 @@ static void requestComplete(Request *request) {
 
 	const std::map<const Stream *, FrameBuffer *> &buffers = request->buffers();
 
+	FrameTrace::set_thread_name("camera");
 	for (auto bufferPair : buffers) {
 		FrameBuffer *buffer = bufferPair.second;
 		const FrameMetadata &metadata = buffer->metadata();
+		TraceSpan callback_span("callback", metadata.sequence);
 
 		// Get the first plane data
 		const FrameMetadata::Plane &plane = metadata.planes()[0];
@@ -263,49 +639,105 @@ static void requestComplete(Request *request) {
 			size_t expected_8bit = streamConfig.size.width * streamConfig.size.height;
 			size_t expected_16bit = expected_8bit * 2;
 			
-			if (plane.bytesused == expected_8bit) {
-				// 8-bit monochrome
-				frame = cv::Mat(streamConfig.size.height, streamConfig.size.width, CV_8UC1, memory);
-			} else if (plane.bytesused == expected_16bit) {
-				// 16-bit format - convert to 8-bit like working version does
-				cv::Mat frame16(streamConfig.size.height, streamConfig.size.width, CV_16UC1, memory);
-				frame16.convertTo(frame, CV_8UC1, 1.0/256.0);
-			} else {
-				UtilityFunctions::print("Unexpected frame size: ", String::num_int64(plane.bytesused), 
-					" expected 8bit: ", String::num_int64(expected_8bit), 
-					" or 16bit: ", String::num_int64(expected_16bit));
+			{
+				TraceSpan convert_span("convert", metadata.sequence);
+				if (plane.bytesused == expected_8bit) {
+					// 8-bit monochrome
+					frame = cv::Mat(streamConfig.size.height, streamConfig.size.width, CV_8UC1, memory);
+				} else if (plane.bytesused == expected_16bit) {
+					// 16-bit format - keep the high byte, rounded as convertTo(1/256) would
+					frame.create(streamConfig.size.height, streamConfig.size.width, CV_8UC1);
+					cpu_kernels().unpack_to_8bit((const uint16_t*)memory, frame.ptr<uint8_t>(), expected_8bit, 8);
+				} else {
+					UtilityFunctions::print("Unexpected frame size: ", String::num_int64(plane.bytesused), 
+						" expected 8bit: ", String::num_int64(expected_8bit), 
+						" or 16bit: ", String::num_int64(expected_16bit));
+				}
 			}
 
 			if (!frame.empty() && AprilTagDetector::current_instance) {
-				AprilTagDetector* instance = AprilTagDetector::current_instance;
-				
-				// Store current frame for video feedback if enabled
-				instance->store_frame_for_video_feedback(frame);
-				
-				// Process every frame for AprilTag detection (no skipping)
-				std::vector<AprilTagDetector::DetectionResult> results;
-				instance->process_frame_for_detection(frame, results);
-				
-				// Store results
-				std::lock_guard<std::mutex> lock(detection_mutex);
-				latest_detections = results;
+				if (request->cookie() == AprilTagDetector::STEREO_CAMERA_COOKIE) {
+					AprilTagDetector::current_instance->complete_stereo_frame(frame, metadata.timestamp);
+				} else {
+					AprilTagDetector::current_instance->complete_frame(frame, metadata.timestamp, metadata.sequence);
+				}
 			}
 			
 			munmap(memory, plane.bytesused);
 		}
 
+		// A shared frame is requeued once its consumers are done with it
+		AprilTagDetector* instance = AprilTagDetector::current_instance;
+		if (instance && request->cookie() != AprilTagDetector::STEREO_CAMERA_COOKIE &&
+				instance->share_frame(request, bufferPair.first->configuration(), buffer)) {
+			continue;
+		}
+
 		request->reuse(Request::ReuseBuffers);
 		// Requeue the request like the working version
-		if (AprilTagDetector::current_instance) {
-			AprilTagDetector::current_instance->requeue_request(request);
+		if (instance) {
+			instance->requeue_request(request);
+		}
+	}
+}
+
+// Everything after a frame arrived, shared by the camera callback and replay
+void AprilTagDetector::complete_frame(cv::Mat& frame, uint64_t timestamp_ns, uint64_t sequence) {
+	frame_recorder.append(frame, timestamp_ns, sequence);
+	calibrator.offer(frame);
+	
+	// Only every VIDEO_FRAME_SKIP-th frame feeds the preview. With the overlay
+	// it is stored after detection, so the markers drawn are this frame's
+	bool preview = video_feedback_enabled && video_frame_counter.fetch_add(1) % VIDEO_FRAME_SKIP == 0;
+	bool overlay = preview && preview_overlay_enabled;
+	if (preview && !overlay) {
+		store_frame_for_video_feedback(frame);
+	}
+	
+	// Process every frame for AprilTag detection (no skipping)
+	std::vector<AprilTagDetector::DetectionResult> results;
+	process_frame_for_detection(frame, results, timestamp_ns, sequence, overlay ? &overlay_markers : nullptr);
+	if (overlay) {
+		store_frame_for_video_feedback(frame, &overlay_markers);
+	}
+	
+	// Store results
+	TraceSpan store_span("store", sequence);
+	std::lock_guard<std::mutex> lock(detection_mutex);
+	latest_detections = results;
+}
+
+// Second camera of a stereo pair: detection only, then pairing
+void AprilTagDetector::complete_stereo_frame(cv::Mat& frame, uint64_t timestamp_ns) {
+	if (!stereo.is_running()) {
+		return;
+	}
+	{
+		ConfigSnapshot<DetectorConfig>::Reader cfg(config);
+		if (cfg->detector_params_version != stereo_params_version) {
+			stereo_engine.set_parameters(cfg->detector_params);
+			stereo_params_version = cfg->detector_params_version;
 		}
+		if (cfg->families_version != stereo_families_version) {
+			stereo_engine.set_families(cfg->families);
+			stereo_families_version = cfg->families_version;
+		}
+		stereo_engine.set_max_hamming(cfg->max_decode_hamming);
+		stereo_engine.set_min_corner_sharpness(cfg->min_corner_sharpness);
 	}
+	TraceSpan detect_span("stereo detect");
+	stereo_engine.detect(frame, stereo_markers);
+	stereo.push(1, timestamp_ns, stereo_markers);
 }
 
 bool AprilTagDetector::start_camera() {
 	if (!camera || camera_running) {
 		return false;
 	}
+	if (replay.is_running()) {
+		UtilityFunctions::print("Stop the replay before starting the camera");
+		return false;
+	}
 
 	// Connect signal and start camera
 	camera->requestCompleted.connect(requestComplete);
@@ -322,16 +754,49 @@ bool AprilTagDetector::start_camera() {
 		camera->queueRequest(request.get());
 	}
 
+	// Both cameras share the completion callback; requests carry their camera's cookie
+	if (stereo_camera) {
+		prepare_stereo_engine();
+		stereo.start();
+		stereo_camera->requestCompleted.connect(requestComplete);
+		stereo_camera->start(&controls_);
+		for (std::unique_ptr<Request> &request : stereo_requests) {
+			stereo_camera->queueRequest(request.get());
+		}
+	}
+
 	camera_running = true;
 	return true;
 }
 
+// The second camera decodes the same families in the same order, so family
+// indices agree between the two cameras' markers
+void AprilTagDetector::prepare_stereo_engine() {
+	DetectorConfig current = config.copy();
+	stereo_engine.set_parameters(current.detector_params);
+	stereo_params_version = current.detector_params_version;
+	stereo_engine.set_families(current.families);
+	stereo_families_version = current.families_version;
+	stereo_engine.set_max_hamming(current.max_decode_hamming);
+	stereo_engine.set_min_corner_sharpness(current.min_corner_sharpness);
+}
+
 void AprilTagDetector::stop_camera() {
 	if (camera_running && camera) {
+		// Cleared first so buffers released by frame-sharing clients from
+		// here on are not queued on a stopping camera
+		camera_running = false;
 		camera->stop();
 		camera->requestCompleted.disconnect();
-		camera_running = false;
+		if (stereo_camera) {
+			stereo_camera->stop();
+			stereo_camera->requestCompleted.disconnect();
+		}
 	}
+	stereo.stop();
+	
+	// Requests still out with frame-sharing clients are freed below
+	frame_share.drop_held();
 
 	if (camera) {
 		camera->release();
@@ -340,6 +805,15 @@ void AprilTagDetector::stop_camera() {
 
 	requests.clear();
 	allocator.reset();
+	stream_size = cv::Size();
+
+	if (stereo_camera) {
+		stereo_camera->release();
+		stereo_camera.reset();
+	}
+	stereo_requests.clear();
+	stereo_allocator.reset();
+	stereo_stream_size = cv::Size();
 
 	if (camera_manager) {
 		camera_manager->stop();
@@ -350,12 +824,20 @@ void AprilTagDetector::stop_camera() {
 }
 
 Array AprilTagDetector::get_latest_detections() {
+	FrameTrace::set_thread_name("godot");
+	TraceSpan read_span("godot read detections");
 	Array results;
 	
 	std::lock_guard<std::mutex> lock(detection_mutex);
 	for (const auto& detection : latest_detections) {
 		Dictionary result;
 		result["id"] = detection.marker_id;
+		result["family"] = detection.family;
+		result["ambiguous"] = detection.ambiguous;
+		result["incomplete"] = detection.incomplete;
+		result["hamming"] = detection.hamming;
+		result["corner_sharpness"] = detection.sharpness;
+		result["reprojection_error"] = detection.reprojection_error;
 		result["rvec"] = detection.rvec;
 		result["tvec"] = detection.tvec;
 		result["corners"] = detection.corners;
@@ -376,75 +858,304 @@ void AprilTagDetector::set_camera_matrix(const Array &matrix) {
 		data.push_back(matrix[i]);
 	}
 	
-	camera_matrix = cv::Mat(3, 3, CV_64F, data.data()).clone();
-	is_initialized = true;
+	cv::Matx33d camera_matrix(data.data());
+	config.update([&](DetectorConfig& next) {
+		next.has_camera_matrix = true;
+		next.camera_matrix = camera_matrix;
+		return true;
+	});
 }
 
 void AprilTagDetector::set_distortion_coefficients(const Array &coeffs) {
-	if (coeffs.size() != 4) {
-		UtilityFunctions::print("Distortion coefficients must have 4 elements");
-		return;
-	}
-	
 	std::vector<double> data;
-	for (int i = 0; i < 4; i++) {
+	for (int i = 0; i < coeffs.size(); i++) {
 		data.push_back(coeffs[i]);
 	}
 	
-	dist_coeffs = cv::Mat(4, 1, CV_64F, data.data()).clone();
+	// A new Mat each time: published configurations share theirs
+	cv::Mat dist_coeffs = cv::Mat((int)data.size(), 1, CV_64F, data.data()).clone();
+	bool valid = config.update([&](DetectorConfig& next) {
+		if (!LensModel::valid_coefficient_count(next.distortion_model, (int)data.size())) {
+			return false;
+		}
+		next.dist_coeffs = dist_coeffs;
+		return true;
+	});
+	if (!valid) {
+		UtilityFunctions::print("Distortion coefficients: pinhole takes 4, 5, 8, 12 or 14, fisheye 4");
+	}
+}
+
+// Set before the coefficients when switching to a model with another count
+bool AprilTagDetector::set_distortion_model(const String &model) {
+	LensModel::Model distortion_model;
+	if (model == "pinhole") {
+		distortion_model = LensModel::MODEL_PINHOLE;
+	} else if (model == "fisheye") {
+		distortion_model = LensModel::MODEL_FISHEYE;
+	} else {
+		UtilityFunctions::print("Unknown distortion model: ", model);
+		return false;
+	}
+	config.update([&](DetectorConfig& next) {
+		next.distortion_model = distortion_model;
+		return true;
+	});
+	return true;
+}
+
+String AprilTagDetector::get_distortion_model() const {
+	return config.copy().distortion_model == LensModel::MODEL_FISHEYE ? "fisheye" : "pinhole";
 }
 
 void AprilTagDetector::set_marker_size(double size) {
-	marker_size = size;
+	config.update([&](DetectorConfig& next) {
+		next.marker_size = size;
+		return true;
+	});
 }
 
 Array AprilTagDetector::get_camera_matrix() const {
 	Array result;
-	if (camera_matrix.empty()) return result;
+	DetectorConfig current = config.copy();
+	if (!current.has_camera_matrix) return result;
 	
 	for (int i = 0; i < 9; i++) {
-		result.append(camera_matrix.at<double>(i / 3, i % 3));
+		result.append(current.camera_matrix(i / 3, i % 3));
 	}
 	return result;
 }
 
 Array AprilTagDetector::get_distortion_coefficients() const {
 	Array result;
+	cv::Mat dist_coeffs = config.copy().dist_coeffs;
 	if (dist_coeffs.empty()) return result;
 	
-	for (int i = 0; i < 4; i++) {
+	for (int i = 0; i < (int)dist_coeffs.total(); i++) {
 		result.append(dist_coeffs.at<double>(i, 0));
 	}
 	return result;
 }
 
-void AprilTagDetector::process_frame_for_detection(cv::Mat& frame, std::vector<DetectionResult>& results) {
+// Only the keys given change; the rest keep their current values
+bool AprilTagDetector::set_detector_parameters(const Dictionary &parameters) {
+	Array keys = parameters.keys();
+	return config.update([&](DetectorConfig& next) {
+		cv::aruco::DetectorParameters& params = next.detector_params;
+		for (int i = 0; i < keys.size(); i++) {
+			String key = keys[i];
+			const Variant& value = parameters[key];
+			if (key == "adaptive_thresh_win_size_min") {
+				params.adaptiveThreshWinSizeMin = value;
+			} else if (key == "adaptive_thresh_win_size_max") {
+				params.adaptiveThreshWinSizeMax = value;
+			} else if (key == "adaptive_thresh_win_size_step") {
+				params.adaptiveThreshWinSizeStep = value;
+			} else if (key == "adaptive_thresh_constant") {
+				params.adaptiveThreshConstant = value;
+			} else if (key == "min_marker_perimeter_rate") {
+				params.minMarkerPerimeterRate = value;
+			} else if (key == "max_marker_perimeter_rate") {
+				params.maxMarkerPerimeterRate = value;
+			} else if (key == "polygonal_approx_accuracy_rate") {
+				params.polygonalApproxAccuracyRate = value;
+			} else if (key == "min_corner_distance_rate") {
+				params.minCornerDistanceRate = value;
+			} else if (key == "min_distance_to_border") {
+				params.minDistanceToBorder = value;
+			} else if (key == "corner_refinement_method") {
+				params.cornerRefinementMethod = (int)value;
+			} else if (key == "corner_refinement_win_size") {
+				params.cornerRefinementWinSize = value;
+			} else if (key == "corner_refinement_max_iterations") {
+				params.cornerRefinementMaxIterations = value;
+			} else if (key == "corner_refinement_min_accuracy") {
+				params.cornerRefinementMinAccuracy = value;
+			} else if (key == "perspective_remove_pixel_per_cell") {
+				params.perspectiveRemovePixelPerCell = value;
+			} else if (key == "min_otsu_std_dev") {
+				params.minOtsuStdDev = value;
+			} else if (key == "error_correction_rate") {
+				params.errorCorrectionRate = value;
+			} else {
+				UtilityFunctions::print("Unknown detector parameter: ", key);
+				return false;
+			}
+		}
+		if (params.adaptiveThreshWinSizeMin < 3 || params.adaptiveThreshWinSizeMax < params.adaptiveThreshWinSizeMin ||
+				params.adaptiveThreshWinSizeStep < 1 || params.perspectiveRemovePixelPerCell < 1) {
+			UtilityFunctions::print("Invalid detector parameters");
+			return false;
+		}
+		next.detector_params_version++;
+		
+		// Tables only change with the Hamming radius the correction rate
+		// works out to, and are rebuilt here rather than on a live frame
+		bool rebuilt = false;
+		for (FamilyEntry& entry : next.families) {
+			if (entry.enabled) {
+				std::shared_ptr<const MarkerFamily> family = MarkerFamily::with_table(entry.family, params.errorCorrectionRate);
+				rebuilt |= family != entry.family;
+				entry.family = family;
+			}
+		}
+		if (rebuilt) {
+			next.families_version++;
+		}
+		return true;
+	});
+}
+
+Dictionary AprilTagDetector::get_detector_parameters() const {
+	cv::aruco::DetectorParameters params = config.copy().detector_params;
+	Dictionary result;
+	result["adaptive_thresh_win_size_min"] = params.adaptiveThreshWinSizeMin;
+	result["adaptive_thresh_win_size_max"] = params.adaptiveThreshWinSizeMax;
+	result["adaptive_thresh_win_size_step"] = params.adaptiveThreshWinSizeStep;
+	result["adaptive_thresh_constant"] = params.adaptiveThreshConstant;
+	result["min_marker_perimeter_rate"] = params.minMarkerPerimeterRate;
+	result["max_marker_perimeter_rate"] = params.maxMarkerPerimeterRate;
+	result["polygonal_approx_accuracy_rate"] = params.polygonalApproxAccuracyRate;
+	result["min_corner_distance_rate"] = params.minCornerDistanceRate;
+	result["min_distance_to_border"] = params.minDistanceToBorder;
+	result["corner_refinement_method"] = (int)params.cornerRefinementMethod;
+	result["corner_refinement_win_size"] = params.cornerRefinementWinSize;
+	result["corner_refinement_max_iterations"] = params.cornerRefinementMaxIterations;
+	result["corner_refinement_min_accuracy"] = params.cornerRefinementMinAccuracy;
+	result["perspective_remove_pixel_per_cell"] = params.perspectiveRemovePixelPerCell;
+	result["min_otsu_std_dev"] = params.minOtsuStdDev;
+	result["error_correction_rate"] = params.errorCorrectionRate;
+	return result;
+}
+
+void AprilTagDetector::process_frame_for_detection(cv::Mat& frame, std::vector<DetectionResult>& results, uint64_t timestamp_ns, uint64_t sequence,
+		std::vector<OverlayMarker>* overlay) {
 	results.clear();
 	
-	std::vector<std::vector<cv::Point2f>> corners;
-	std::vector<int> ids;
+	std::vector<DetectedMarker> markers;
+	
+	// One configuration for the whole frame, whatever setters run meanwhile
+	ConfigSnapshot<DetectorConfig>::Reader cfg(config);
+	if (cfg->detector_params_version != applied_params_version) {
+		detector.setDetectorParameters(cfg->detector_params);
+		detection_engine.set_parameters(cfg->detector_params);
+		applied_params_version = cfg->detector_params_version;
+	}
+	if (cfg->families_version != applied_families_version) {
+		detection_engine.set_families(cfg->families);
+		applied_families_version = cfg->families_version;
+	}
+	
+	// Contrast normalisation, if enabled, writes to its own buffer: `frame` may
+	// be the read-only camera mapping
+	PipelineStats::Clock::time_point stage_start = PipelineStats::Clock::now();
+	contrast_normalizer.configure(cfg->contrast);
+	const cv::Mat& input = contrast_normalizer.apply(frame);
+	if (contrast_normalizer.get_mode() != ContrastNormalizer::MODE_NONE) {
+		stats.record(STAGE_PREPROCESS, PipelineStats::elapsed_us(stage_start));
+		trace_stage("preprocess", stage_start, sequence);
+	}
+	
+	stage_start = PipelineStats::Clock::now();
+	if (cfg->detection_regions_version != applied_regions_version) {
+		detection_engine.get_mask().set_polygons(cfg->detection_regions, cfg->detection_region_reference);
+		applied_regions_version = cfg->detection_regions_version;
+	}
+	if (cfg->expected_markers_version != applied_expected_version) {
+		detection_engine.set_expected_markers(cfg->expected_markers);
+		applied_expected_version = cfg->expected_markers_version;
+	}
+	// Only a changed budget restarts the resumed search from the first band
+	if (cfg->frame_budget_us != detection_engine.get_frame_budget_us()) {
+		detection_engine.set_frame_budget_us(cfg->frame_budget_us);
+	}
+	detection_engine.set_expected_search_budget_us(cfg->expected_search_budget_us);
+	detection_engine.set_run_segmentation_enabled(cfg->run_segmentation);
+	detection_engine.set_max_hamming(cfg->max_decode_hamming);
+	detection_engine.set_min_corner_sharpness(cfg->min_corner_sharpness);
+	detection_engine.get_mask().update(input.size(), cfg->camera_matrix);
 	
-	// Use the instance's detector
-	detector.detectMarkers(frame, corners, ids);
+	// Use the instance's detector, or our own engine which thresholds all window
+	// sizes from a single integral image and decodes every enabled family in one pass
+	bool complete = true;
+	if (uses_stock_detector(*cfg)) {
+		std::vector<std::vector<cv::Point2f>> corners;
+		std::vector<int> ids;
+		detector.detectMarkers(input, corners, ids);
+		for (size_t i = 0; i < ids.size(); i++) {
+			markers.push_back({ ids[i], 0, corners[i] });
+		}
+		detection_engine.score_markers(input, markers);
+	} else {
+		detection_engine.detect(input, markers);
+		if (detection_engine.last_frame_exited_early()) {
+			stats.count_early_exit();
+		}
+		complete = detection_engine.last_frame_complete();
+	}
+	double detect_us = PipelineStats::elapsed_us(stage_start);
+	stats.record(STAGE_DETECT, detect_us);
+	trace_stage("detect", stage_start, sequence);
+	int budget_us = detection_engine.get_frame_budget_us();
+	stats.count_budget(budget_us > 0 && detect_us > budget_us, !complete);
+	last_frame_complete = complete;
+	int gated = detection_engine.last_frame_gated();
 	
 	// Debug output
-	if (ids.size() > 0) {
-		UtilityFunctions::print("Detected ", String::num_int64(ids.size()), " markers");
+	if (markers.size() > 0) {
+		UtilityFunctions::print("Detected ", String::num_int64(markers.size()), " markers");
 	}
 	
-	for (size_t i = 0; i < ids.size(); i++) {
+	stage_start = PipelineStats::Clock::now();
+	bool calibrated = cfg->calibrated();
+	// Tracks are dropped here, on the thread that uses them, not by the setter
+	if (pose_tracker_reset.exchange(false)) {
+		pose_tracker.clear();
+	}
+	if (cfg->pose_disambiguation) {
+		pose_tracker.set_ambiguity_ratio(cfg->pose_ambiguity_ratio);
+		pose_tracker.begin_frame();
+	}
+	
+	// Every corner of the frame through the lens table at once; the pose
+	// solvers below then see an ideal pinhole camera whatever the model
+	if (calibrated) {
+		lens.set(cfg->camera_matrix, cfg->dist_coeffs, cfg->distortion_model);
+		lens.prepare(input.size());
+		pose_corners.clear();
+		for (const DetectedMarker& marker : markers) {
+			pose_corners.insert(pose_corners.end(), marker.corners.begin(), marker.corners.end());
+		}
+		lens.undistort(pose_corners, pose_normalized);
+	}
+	
+	for (size_t m = 0; m < markers.size(); m++) {
+		const DetectedMarker& marker = markers[m];
+		const MarkerFamily& family = detection_engine.get_family(marker.family);
 		DetectionResult result;
-		result.marker_id = ids[i];
+		result.marker_id = marker.id;
+		result.family = String(family.name.c_str());
+		result.ambiguous = false;
+		result.incomplete = !complete;
+		result.hamming = marker.hamming;
+		result.sharpness = marker.sharpness;
+		result.reprojection_error = -1.0;
 		
 		// Perform pose estimation if camera is calibrated
-		if (is_initialized && !camera_matrix.empty() && !dist_coeffs.empty()) {
+		double size = cfg->family_marker_size(marker.family);
+		if (calibrated && cfg->batched_pose) {
+			// Filled in for all markers at once below
+		} else if (calibrated && cfg->pose_disambiguation) {
+			estimate_pose_both_solutions(marker, &pose_normalized[m * 4], size, result);
+		} else if (calibrated) {
+			std::vector<std::vector<cv::Point2f>> single_marker(1, std::vector<cv::Point2f>(&pose_normalized[m * 4], &pose_normalized[m * 4] + 4));
 			std::vector<cv::Vec3d> rvecs, tvecs;
-			cv::aruco::estimatePoseSingleMarkers(corners, marker_size, 
-				camera_matrix, dist_coeffs, rvecs, tvecs);
+			cv::aruco::estimatePoseSingleMarkers(single_marker, size, 
+				cv::Mat::eye(3, 3, CV_64F), cv::Mat(), rvecs, tvecs);
 			
-			if (i < rvecs.size() && i < tvecs.size()) {
-				result.rvec = Vector3(rvecs[i][0], rvecs[i][1], rvecs[i][2]);
-				result.tvec = Vector3(tvecs[i][0], tvecs[i][1], tvecs[i][2]);
+			if (!rvecs.empty() && !tvecs.empty()) {
+				result.rvec = Vector3(rvecs[0][0], rvecs[0][1], rvecs[0][2]);
+				result.tvec = Vector3(tvecs[0][0], tvecs[0][1], tvecs[0][2]);
 			}
 		} else {
 			result.rvec = Vector3(0, 0, 0);
@@ -452,7 +1163,7 @@ void AprilTagDetector::process_frame_for_detection(cv::Mat& frame, std::vector<D
 		}
 		
 		Array corner_array;
-		for (const auto& corner : corners[i]) {
+		for (const auto& corner : marker.corners) {
 			Array point;
 			point.append(corner.x);
 			point.append(corner.y);
@@ -462,42 +1173,206 @@ void AprilTagDetector::process_frame_for_detection(cv::Mat& frame, std::vector<D
 		
 		results.push_back(result);
 	}
+	
+	if (calibrated && cfg->batched_pose && !markers.empty()) {
+		estimate_poses_batched(*cfg, markers, results);
+	}
+	
+	// Poses that do not explain their own corners are not published
+	if (calibrated) {
+		size_t kept = 0;
+		for (size_t i = 0; i < results.size(); i++) {
+			double size = cfg->family_marker_size(markers[i].family);
+			results[i].reprojection_error = reprojection_error_px(markers[i], size, results[i]);
+			if (cfg->max_reprojection_error > 0.0 && results[i].reprojection_error > cfg->max_reprojection_error) {
+				gated++;
+				continue;
+			}
+			if (kept != i) {
+				results[kept] = results[i];
+				markers[kept] = std::move(markers[i]);
+			}
+			kept++;
+		}
+		results.resize(kept);
+		markers.resize(kept);
+	}
+	stats.record(STAGE_POSE, PipelineStats::elapsed_us(stage_start));
+	trace_stage("pose", stage_start, sequence);
+	stats.count_gated(gated);
+	stats.end_frame(results.size());
+	
+	if (overlay) {
+		fill_overlay(*cfg, markers, results, *overlay);
+	}
+	
+	stereo.push(0, timestamp_ns, markers);
+	publish_results(markers, results, timestamp_ns, sequence, complete);
 }
 
-void AprilTagDetector::store_frame_for_video_feedback(cv::Mat& frame) {
-	if (video_feedback_enabled) {
-		// Only process video frames occasionally for performance
-		int video_count = video_frame_counter.fetch_add(1);
-		if (video_count % VIDEO_FRAME_SKIP == 0) {
-			std::lock_guard<std::mutex> lock(frame_mutex);
-			// Keep full frame for detection
-			current_frame = frame.clone();
-			// Create smaller version for video feedback
-			cv::resize(frame, video_frame_resized, 
-				cv::Size(VIDEO_WIDTH, VIDEO_HEIGHT), 
-				0, 0, cv::INTER_LINEAR);
+void AprilTagDetector::publish_results(const std::vector<DetectedMarker> &markers, const std::vector<DetectionResult> &results,
+		uint64_t timestamp_ns, uint64_t sequence, bool complete) {
+	TraceSpan publish_span("publish", sequence);
+	
+	// Families can be enabled while publishing
+	int family_count = detection_engine.get_family_count();
+	
+	{
+		std::lock_guard<std::mutex> lock(shm_mutex);
+		if (shm_publisher.is_open()) {
+			if (shm_family_count != family_count) {
+				shm_family_count = family_count;
+				for (int i = 0; i < family_count; i++) {
+					shm_publisher.set_family_name(i, detection_engine.get_family(i).name);
+				}
+			}
+			
+			apriltag_shm_frame& frame = shm_publisher.begin_frame();
+			uint32_t flags = complete ? 0 : APRILTAG_SHM_INCOMPLETE;
+			if (results.size() > APRILTAG_SHM_MAX_MARKERS) {
+				flags |= APRILTAG_SHM_TRUNCATED;
+			}
+			frame.count = (uint32_t)std::min(results.size(), (size_t)APRILTAG_SHM_MAX_MARKERS);
+			for (uint32_t i = 0; i < frame.count; i++) {
+				fill_marker_record(markers[i], results[i], frame.markers[i]);
+				frame.markers[i].flags = (results[i].reprojection_error >= 0.0 ? APRILTAG_SHM_HAS_POSE : 0) |
+					(results[i].ambiguous ? APRILTAG_SHM_AMBIGUOUS : 0);
+			}
+			shm_publisher.publish(timestamp_ns, flags);
+		}
+	}
+	
+	if (detection_log.is_open()) {
+		if (detection_log.get_family_count() != family_count) {
+			for (int i = 0; i < family_count; i++) {
+				detection_log.set_family_name(i, detection_engine.get_family(i).name);
+			}
+		}
+		log_markers.resize(results.size());
+		for (size_t i = 0; i < results.size(); i++) {
+			fill_marker_record(markers[i], results[i], log_markers[i]);
+			log_markers[i].flags = (results[i].reprojection_error >= 0.0 ? LOG_MARKER_HAS_POSE : 0) |
+				(results[i].ambiguous ? LOG_MARKER_AMBIGUOUS : 0);
+		}
+		detection_log.append(timestamp_ns, sequence, complete ? 0 : LOG_FRAME_INCOMPLETE,
+			log_markers.data(), (uint32_t)log_markers.size());
+	}
+}
+
+double AprilTagDetector::reprojection_error_px(const DetectedMarker &marker, double size, const DetectionResult &result) const {
+	cv::Vec3d rvec(result.rvec.x, result.rvec.y, result.rvec.z);
+	cv::Vec3d tvec(result.tvec.x, result.tvec.y, result.tvec.z);
+	std::vector<cv::Point2f> projected;
+	lens.project(marker_object_points(size), rvec, tvec, projected);
+	
+	// RMS over the four corners
+	double total = 0.0;
+	for (int k = 0; k < 4; k++) {
+		cv::Point2f d = projected[k] - marker.corners[k];
+		total += d.dot(d);
+	}
+	return std::sqrt(total / 4.0);
+}
+
+// Corners and, with a pose, the projected axes of every published marker
+void AprilTagDetector::fill_overlay(const DetectorConfig &cfg, const std::vector<DetectedMarker> &markers,
+		const std::vector<DetectionResult> &results, std::vector<OverlayMarker> &overlay) const {
+	overlay.resize(markers.size());
+	bool calibrated = cfg.calibrated();
+	std::vector<cv::Point2f> projected;
+	for (size_t i = 0; i < markers.size(); i++) {
+		OverlayMarker& out = overlay[i];
+		out.id = markers[i].id;
+		for (int k = 0; k < 4; k++) {
+			out.corners[k] = markers[i].corners[k];
+		}
+		
+		// Axes half a marker long, as is usual for cv::drawFrameAxes
+		const DetectionResult& result = results[i];
+		out.has_pose = calibrated && result.tvec.z > 0.0;
+		if (out.has_pose) {
+			float length = (float)(cfg.family_marker_size(markers[i].family) / 2.0);
+			std::vector<cv::Point3f> axes = { { 0, 0, 0 }, { length, 0, 0 }, { 0, length, 0 }, { 0, 0, length } };
+			cv::Vec3d rvec(result.rvec.x, result.rvec.y, result.rvec.z);
+			cv::Vec3d tvec(result.tvec.x, result.tvec.y, result.tvec.z);
+			lens.project(axes, rvec, tvec, projected);
+			for (int k = 0; k < 4; k++) {
+				out.axes[k] = projected[k];
+			}
 		}
 	}
 }
 
+void AprilTagDetector::store_frame_for_video_feedback(cv::Mat& frame, const std::vector<OverlayMarker>* overlay) {
+	TraceSpan preview_span("preview");
+	std::lock_guard<std::mutex> lock(frame_mutex);
+	// Keep full frame for detection
+	current_frame = frame.clone();
+	// Create smaller version for video feedback
+	cv::resize(frame, video_frame_resized, 
+		cv::Size(VIDEO_WIDTH, VIDEO_HEIGHT), 
+		0, 0, cv::INTER_LINEAR);
+	
+	// Drawn in colour; get_current_frame_texture() converts BGR previews to RGB
+	if (overlay && video_frame_resized.channels() == 1) {
+		cv::cvtColor(video_frame_resized, video_frame_resized, cv::COLOR_GRAY2BGR);
+		draw_preview_overlay(video_frame_resized, frame.size(), *overlay);
+	}
+}
+
 void AprilTagDetector::requeue_request(libcamera::Request* request) {
-	if (camera && camera_running) {
+	if (!camera_running) {
+		return;
+	}
+	if (request->cookie() == STEREO_CAMERA_COOKIE) {
+		if (stereo_camera) {
+			stereo_camera->queueRequest(request);
+		}
+	} else if (camera) {
 		camera->queueRequest(request);
 	}
 }
 
-void AprilTagDetector::adjust_camera_matrix_for_resolution(int actual_width, int actual_height, int calibration_width, int calibration_height) {
-	if (camera_matrix.empty()) return;
+bool AprilTagDetector::share_frame(libcamera::Request* request, const libcamera::StreamConfiguration& config, const libcamera::FrameBuffer* buffer) {
+	if (!frame_share.is_running()) {
+		return false;
+	}
 	
+	FrameShareServer::Frame frame;
+	frame.sequence = buffer->metadata().sequence;
+	frame.timestamp_ns = buffer->metadata().timestamp;
+	frame.width = config.size.width;
+	frame.height = config.size.height;
+	frame.stride = config.stride;
+	frame.fourcc = config.pixelFormat.fourcc();
+	for (const FrameBuffer::Plane& plane : buffer->planes()) {
+		frame.planes.push_back({ plane.fd.get(), plane.offset, plane.length });
+	}
+	
+	// Runs on the sharing thread; queueRequest is thread-safe
+	return frame_share.share(frame, [this, request]() {
+		request->reuse(Request::ReuseBuffers);
+		requeue_request(request);
+	});
+}
+
+void AprilTagDetector::adjust_camera_matrix_for_resolution(int actual_width, int actual_height, int calibration_width, int calibration_height) {
 	// Scale the camera matrix for different resolution
 	double scale_x = (double)actual_width / calibration_width;
 	double scale_y = (double)actual_height / calibration_height;
 	
-	// Adjust focal lengths and principal point
-	camera_matrix.at<double>(0, 0) *= scale_x; // fx
-	camera_matrix.at<double>(1, 1) *= scale_y; // fy
-	camera_matrix.at<double>(0, 2) *= scale_x; // cx
-	camera_matrix.at<double>(1, 2) *= scale_y; // cy
+	bool adjusted = config.update([&](DetectorConfig& next) {
+		if (!next.has_camera_matrix) return false;
+		
+		// Adjust focal lengths and principal point
+		next.camera_matrix(0, 0) *= scale_x; // fx
+		next.camera_matrix(1, 1) *= scale_y; // fy
+		next.camera_matrix(0, 2) *= scale_x; // cx
+		next.camera_matrix(1, 2) *= scale_y; // cy
+		next.calibration_size = cv::Size(actual_width, actual_height);
+		return true;
+	});
+	if (!adjusted) return;
 	
 	UtilityFunctions::print("Adjusted camera matrix for resolution ", 
 		String::num_int64(actual_width), "x", String::num_int64(actual_height),
@@ -505,6 +1380,8 @@ void AprilTagDetector::adjust_camera_matrix_for_resolution(int actual_width, int
 }
 
 Ref<ImageTexture> AprilTagDetector::get_current_frame_texture() {
+	FrameTrace::set_thread_name("godot");
+	TraceSpan read_span("godot read frame");
 	std::lock_guard<std::mutex> lock(frame_mutex);
 	
 	// Use the smaller resized frame for video feedback instead of full frame
@@ -601,4 +1478,704 @@ void AprilTagDetector::set_video_feedback_enabled(bool enabled) {
 
 bool AprilTagDetector::get_video_feedback_enabled() const {
 	return video_feedback_enabled;
+}
+
+void AprilTagDetector::set_preview_overlay_enabled(bool enabled) {
+	preview_overlay_enabled = enabled;
+}
+
+bool AprilTagDetector::get_preview_overlay_enabled() const {
+	return preview_overlay_enabled;
+}
+
+void AprilTagDetector::set_detection_engine_enabled(bool enabled) {
+	config.update([&](DetectorConfig& next) {
+		next.detection_engine = enabled;
+		return true;
+	});
+}
+
+bool AprilTagDetector::get_detection_engine_enabled() const {
+	return config.copy().detection_engine;
+}
+
+void AprilTagDetector::set_run_segmentation_enabled(bool enabled) {
+	config.update([&](DetectorConfig& next) {
+		next.run_segmentation = enabled;
+		return true;
+	});
+}
+
+bool AprilTagDetector::get_run_segmentation_enabled() const {
+	return config.copy().run_segmentation;
+}
+
+bool AprilTagDetector::uses_stock_detector(const DetectorConfig &cfg) const {
+	// `detector` only knows apriltag_36h11, which is always family 0, and
+	// cannot skip masked regions, stop early or keep to a time budget
+	return !cfg.detection_engine && detection_engine.get_enabled_family_count() == 1 &&
+		detection_engine.is_family_enabled(0) && detection_engine.get_mask().empty() &&
+		!detection_engine.has_expected_markers() && detection_engine.get_frame_budget_us() == 0;
+}
+
+bool AprilTagDetector::set_marker_family_enabled(const String &family, bool enabled) {
+	return config.update([&](DetectorConfig& next) {
+		int index = find_or_add_marker_family(next, family);
+		if (index < 0) {
+			return false;
+		}
+		// The decode table is built here, never by the frame thread
+		FamilyEntry& entry = next.families[index];
+		if (enabled) {
+			entry.family = MarkerFamily::with_table(entry.family, next.detector_params.errorCorrectionRate);
+		}
+		entry.enabled = enabled;
+		next.families_version++;
+		return true;
+	});
+}
+
+bool AprilTagDetector::set_marker_family_size(const String &family, double size) {
+	return config.update([&](DetectorConfig& next) {
+		int index = find_or_add_marker_family(next, family);
+		if (index < 0) {
+			return false;
+		}
+		next.families[index].marker_size = size;
+		next.families_version++;
+		return true;
+	});
+}
+
+Array AprilTagDetector::get_marker_families() const {
+	Array result;
+	for (const FamilyEntry& entry : config.copy().families) {
+		if (entry.enabled) {
+			result.append(String(entry.family->name.c_str()));
+		}
+	}
+	return result;
+}
+
+void AprilTagDetector::set_batched_pose_enabled(bool enabled) {
+	config.update([&](DetectorConfig& next) {
+		next.batched_pose = enabled;
+		return true;
+	});
+}
+
+bool AprilTagDetector::get_batched_pose_enabled() const {
+	return config.copy().batched_pose;
+}
+
+void AprilTagDetector::set_pose_refinement_iterations(int iterations) {
+	config.update([&](DetectorConfig& next) {
+		next.pose_refinement_iterations = std::max(0, iterations);
+		return true;
+	});
+}
+
+int AprilTagDetector::get_pose_refinement_iterations() const {
+	return config.copy().pose_refinement_iterations;
+}
+
+// Corners were normalised for the whole frame in process_frame_for_detection
+void AprilTagDetector::estimate_poses_batched(const DetectorConfig &cfg, const std::vector<DetectedMarker> &markers, std::vector<DetectionResult> &results) {
+	pose_solver.clear();
+	for (size_t i = 0; i < markers.size(); i++) {
+		pose_solver.add(&pose_normalized[i * 4], (float)cfg.family_marker_size(markers[i].family));
+	}
+	pose_solver.solve(cfg.pose_refinement_iterations);
+	
+	for (size_t i = 0; i < markers.size(); i++) {
+		if (cfg.pose_disambiguation) {
+			PoseTracker::Solution solutions[2];
+			for (int s = 0; s < 2; s++) {
+				pose_solver.get_pose(i, s, solutions[s].rvec, solutions[s].tvec);
+				solutions[s].error = pose_solver.get_error(i, s);
+			}
+			apply_pose(markers[i], solutions, results[i]);
+			continue;
+		}
+		
+		cv::Vec3d rvec, tvec;
+		pose_solver.get_pose(i, 0, rvec, tvec);
+		results[i].rvec = Vector3(rvec[0], rvec[1], rvec[2]);
+		results[i].tvec = Vector3(tvec[0], tvec[1], tvec[2]);
+	}
+}
+
+void AprilTagDetector::estimate_pose_both_solutions(const DetectedMarker &marker, const cv::Point2f normalized[4], double size, DetectionResult &result) {
+	std::vector<cv::Vec3d> rvecs, tvecs;
+	std::vector<double> errors;
+	std::vector<cv::Point2f> corners(normalized, normalized + 4);
+	cv::solvePnPGeneric(marker_object_points(size), corners, cv::Mat::eye(3, 3, CV_64F), cv::noArray(), rvecs, tvecs,
+		false, cv::SOLVEPNP_IPPE_SQUARE, cv::noArray(), cv::noArray(), errors);
+	if (rvecs.empty()) {
+		result.rvec = Vector3(0, 0, 0);
+		result.tvec = Vector3(0, 0, 0);
+		return;
+	}
+	
+	PoseTracker::Solution solutions[2];
+	for (int s = 0; s < 2; s++) {
+		size_t k = std::min((size_t)s, rvecs.size() - 1);
+		solutions[s].rvec = rvecs[k];
+		solutions[s].tvec = tvecs[k];
+		// RMS pixels; squared so the ratio matches the batched solver's errors
+		double error = errors.size() > k ? errors[k] * lens.mean_focal() : 0.0;
+		solutions[s].error = error * error;
+	}
+	apply_pose(marker, solutions, result);
+}
+
+void AprilTagDetector::apply_pose(const DetectedMarker &marker, const PoseTracker::Solution solutions[2], DetectionResult &result) {
+	bool ambiguous = false;
+	int chosen = pose_tracker.select(PoseTracker::key(marker.family, marker.id), solutions, ambiguous);
+	const PoseTracker::Solution& pose = solutions[chosen];
+	result.rvec = Vector3(pose.rvec[0], pose.rvec[1], pose.rvec[2]);
+	result.tvec = Vector3(pose.tvec[0], pose.tvec[1], pose.tvec[2]);
+	result.ambiguous = ambiguous;
+}
+
+void AprilTagDetector::set_pose_disambiguation_enabled(bool enabled) {
+	config.update([&](DetectorConfig& next) {
+		next.pose_disambiguation = enabled;
+		return true;
+	});
+	if (!enabled) {
+		pose_tracker_reset = true;
+	}
+}
+
+bool AprilTagDetector::get_pose_disambiguation_enabled() const {
+	return config.copy().pose_disambiguation;
+}
+
+void AprilTagDetector::set_pose_ambiguity_ratio(double ratio) {
+	config.update([&](DetectorConfig& next) {
+		next.pose_ambiguity_ratio = std::max(1.0, ratio);
+		return true;
+	});
+}
+
+double AprilTagDetector::get_pose_ambiguity_ratio() const {
+	return config.copy().pose_ambiguity_ratio;
+}
+
+bool AprilTagDetector::add_detection_region(const PackedVector2Array &polygon, bool include) {
+	if (polygon.size() < 3) {
+		UtilityFunctions::print("Detection region needs at least 3 points");
+		return false;
+	}
+	
+	DetectionMask::Polygon region;
+	region.include = include;
+	for (int i = 0; i < polygon.size(); i++) {
+		region.points.push_back(cv::Point2f(polygon[i].x, polygon[i].y));
+	}
+	
+	// Rasterised by the frame thread once it sees the new version
+	config.update([&](DetectorConfig& next) {
+		if (next.detection_regions.empty()) {
+			// Later regions share the first one's reference intrinsics
+			next.detection_region_reference = next.camera_matrix;
+		}
+		next.detection_regions.push_back(region);
+		next.detection_regions_version++;
+		return true;
+	});
+	return true;
+}
+
+bool AprilTagDetector::add_detection_roi(const PackedVector2Array &polygon) {
+	return add_detection_region(polygon, true);
+}
+
+bool AprilTagDetector::add_detection_exclusion(const PackedVector2Array &polygon) {
+	return add_detection_region(polygon, false);
+}
+
+void AprilTagDetector::clear_detection_regions() {
+	config.update([&](DetectorConfig& next) {
+		next.detection_regions.clear();
+		next.detection_regions_version++;
+		return true;
+	});
+}
+
+bool AprilTagDetector::add_expected_markers(const String &family, const PackedInt32Array &ids) {
+	bool enabled = false;
+	bool known = config.update([&](DetectorConfig& next) {
+		int index = find_or_add_marker_family(next, family);
+		if (index < 0) {
+			return false;
+		}
+		enabled = next.families[index].enabled;
+		for (int i = 0; i < ids.size(); i++) {
+			if (!next.is_expected(index, ids[i])) {
+				next.expected_markers.push_back({ index, ids[i] });
+			}
+		}
+		next.expected_markers_version++;
+		return true;
+	});
+	if (!known) {
+		return false;
+	}
+	if (!enabled) {
+		UtilityFunctions::print("Expected markers added for disabled family: ", family);
+	}
+	return true;
+}
+
+void AprilTagDetector::clear_expected_markers() {
+	config.update([&](DetectorConfig& next) {
+		next.expected_markers.clear();
+		next.expected_markers_version++;
+		return true;
+	});
+}
+
+void AprilTagDetector::set_expected_search_budget_us(int budget_us) {
+	config.update([&](DetectorConfig& next) {
+		next.expected_search_budget_us = std::max(0, budget_us);
+		return true;
+	});
+}
+
+int AprilTagDetector::get_expected_search_budget_us() const {
+	return config.copy().expected_search_budget_us;
+}
+
+void AprilTagDetector::set_frame_budget_us(int budget_us) {
+	config.update([&](DetectorConfig& next) {
+		next.frame_budget_us = std::max(0, budget_us);
+		return true;
+	});
+}
+
+int AprilTagDetector::get_frame_budget_us() const {
+	return config.copy().frame_budget_us;
+}
+
+bool AprilTagDetector::is_last_frame_complete() const {
+	return last_frame_complete;
+}
+
+void AprilTagDetector::set_max_decode_hamming(int bits) {
+	config.update([&](DetectorConfig& next) {
+		next.max_decode_hamming = bits;
+		return true;
+	});
+}
+
+int AprilTagDetector::get_max_decode_hamming() const {
+	return config.copy().max_decode_hamming;
+}
+
+void AprilTagDetector::set_min_corner_sharpness(double sharpness) {
+	config.update([&](DetectorConfig& next) {
+		next.min_corner_sharpness = (float)sharpness;
+		return true;
+	});
+}
+
+double AprilTagDetector::get_min_corner_sharpness() const {
+	return config.copy().min_corner_sharpness;
+}
+
+void AprilTagDetector::set_max_reprojection_error(double pixels) {
+	config.update([&](DetectorConfig& next) {
+		next.max_reprojection_error = std::max(0.0, pixels);
+		return true;
+	});
+}
+
+double AprilTagDetector::get_max_reprojection_error() const {
+	return config.copy().max_reprojection_error;
+}
+
+bool AprilTagDetector::start_shared_memory_publisher(const String &name) {
+	std::lock_guard<std::mutex> lock(shm_mutex);
+	std::string segment = name.utf8().get_data();
+	if (!shm_publisher.open(segment)) {
+		UtilityFunctions::print("Failed to create shared memory segment: ", name);
+		return false;
+	}
+	shm_family_count = 0;
+	UtilityFunctions::print("Publishing detections to shared memory: ", name);
+	return true;
+}
+
+void AprilTagDetector::stop_shared_memory_publisher() {
+	std::lock_guard<std::mutex> lock(shm_mutex);
+	shm_publisher.close();
+}
+
+bool AprilTagDetector::start_frame_sharing(const String &socket_path, int timeout_ms) {
+	std::string path = socket_path.utf8().get_data();
+	if (!frame_share.start(path, timeout_ms)) {
+		UtilityFunctions::print("Failed to listen for frame sharing clients on: ", socket_path);
+		return false;
+	}
+	UtilityFunctions::print("Sharing camera frames on: ", socket_path);
+	return true;
+}
+
+void AprilTagDetector::stop_frame_sharing() {
+	// Held requests go back to the camera
+	frame_share.stop();
+}
+
+bool AprilTagDetector::start_detection_log(const String &path) {
+	// Accepts user:// and res:// paths as well as plain filesystem paths
+	std::string file = ProjectSettings::get_singleton()->globalize_path(path).utf8().get_data();
+	if (!detection_log.open(file)) {
+		UtilityFunctions::print("Failed to open detection log: ", path);
+		return false;
+	}
+	UtilityFunctions::print("Recording detections to: ", path);
+	return true;
+}
+
+void AprilTagDetector::stop_detection_log() {
+	detection_log.close();
+}
+
+bool AprilTagDetector::is_detection_log_open() const {
+	return detection_log.is_open();
+}
+
+void AprilTagDetector::start_trace() {
+	FrameTrace::start();
+}
+
+void AprilTagDetector::stop_trace() {
+	FrameTrace::stop();
+}
+
+bool AprilTagDetector::is_tracing() const {
+	return FrameTrace::is_enabled();
+}
+
+// Can be called while tracing; the rings keep recording
+bool AprilTagDetector::dump_trace(const String &path) {
+	std::string file = ProjectSettings::get_singleton()->globalize_path(path).utf8().get_data();
+	int64_t spans = FrameTrace::dump(file);
+	if (spans < 0) {
+		UtilityFunctions::print("Failed to write trace: ", path);
+		return false;
+	}
+	UtilityFunctions::print("Trace written: ", path, ", ", String::num_int64(spans), " spans");
+	return true;
+}
+
+bool AprilTagDetector::start_frame_recording(const String &path) {
+	std::string file = ProjectSettings::get_singleton()->globalize_path(path).utf8().get_data();
+	if (!frame_recorder.open(file)) {
+		UtilityFunctions::print("Failed to open frame recording: ", path);
+		return false;
+	}
+	UtilityFunctions::print("Recording frames to: ", path);
+	return true;
+}
+
+void AprilTagDetector::stop_frame_recording() {
+	frame_recorder.close();
+}
+
+bool AprilTagDetector::start_replay(const String &path, double speed, bool loop, int buffers) {
+	if (camera_running) {
+		UtilityFunctions::print("Stop the camera before starting a replay");
+		return false;
+	}
+	std::string file = ProjectSettings::get_singleton()->globalize_path(path).utf8().get_data();
+	current_instance = this;
+	bool started = replay.start(file, [this](cv::Mat& frame, uint64_t timestamp_ns, uint64_t sequence) {
+		complete_frame(frame, timestamp_ns, sequence);
+	}, speed, buffers, loop);
+	if (!started) {
+		UtilityFunctions::print("Failed to open frame recording: ", path);
+		return false;
+	}
+	UtilityFunctions::print("Replaying ", path, " at ", String::num(speed), "x");
+	return true;
+}
+
+void AprilTagDetector::stop_replay() {
+	replay.stop();
+}
+
+bool AprilTagDetector::is_replaying() const {
+	return replay.is_running();
+}
+
+Dictionary AprilTagDetector::get_replay_report() const {
+	FrameReplay::Report report = replay.report();
+	Dictionary result;
+	result["frames"] = (int64_t)report.frames;
+	result["delivered"] = (int64_t)report.delivered;
+	result["dropped"] = (int64_t)report.dropped;
+	
+	// Release time vs recorded time, and queueing before detection started
+	Dictionary pacing;
+	pacing["mean_us"] = report.pacing_mean_us;
+	pacing["p99_us"] = report.pacing_p99_us;
+	pacing["max_us"] = report.pacing_max_us;
+	result["pacing"] = pacing;
+	Dictionary latency;
+	latency["mean_us"] = report.latency_mean_us;
+	latency["p99_us"] = report.latency_p99_us;
+	latency["max_us"] = report.latency_max_us;
+	result["latency"] = latency;
+	return result;
+}
+
+bool AprilTagDetector::has_stereo_calibration() const {
+	return has_stereo_section;
+}
+
+void AprilTagDetector::set_stereo_time_tolerance_ms(double tolerance_ms) {
+	stereo.set_tolerance_ns((int64_t)(std::max(0.0, tolerance_ms) * 1e6));
+}
+
+double AprilTagDetector::get_stereo_time_tolerance_ms() const {
+	return stereo.get_tolerance_ns() / 1e6;
+}
+
+Array AprilTagDetector::get_latest_stereo_detections() {
+	Array results;
+	std::vector<FamilyEntry> families = config.copy().families;
+	for (const StereoMarker& marker : stereo.latest()) {
+		Dictionary result;
+		result["id"] = marker.id;
+		// Families are only ever appended, so this copy holds every index a frame used
+		result["family"] = String(families[marker.family].family->name.c_str());
+		result["timestamp_ns"] = (int64_t)marker.timestamp_ns;
+		result["time_offset_ns"] = marker.time_offset_ns;
+		result["rvec"] = Vector3(marker.rvec[0], marker.rvec[1], marker.rvec[2]);
+		result["tvec"] = Vector3(marker.tvec[0], marker.tvec[1], marker.tvec[2]);
+		result["ray_gap"] = marker.ray_gap;
+		Array corners;
+		for (const cv::Point3d& corner : marker.corners) {
+			corners.append(Vector3(corner.x, corner.y, corner.z));
+		}
+		result["corners_3d"] = corners;
+		results.append(result);
+	}
+	return results;
+}
+
+bool AprilTagDetector::set_calibration_board_charuco(int squares_x, int squares_y, double square_length, double marker_length, const String &family) {
+	cv::aruco::Dictionary dictionary;
+	if (!find_predefined_dictionary(family.utf8().get_data(), dictionary)) {
+		UtilityFunctions::print("Unknown marker family: ", family);
+		return false;
+	}
+	if (calibrator.is_running() || squares_x < 2 || squares_y < 2 || marker_length <= 0.0 || marker_length >= square_length) {
+		UtilityFunctions::print("Invalid ChArUco board, or calibration running");
+		return false;
+	}
+	calibrator.set_charuco_board(squares_x, squares_y, (float)square_length, (float)marker_length, dictionary);
+	return true;
+}
+
+bool AprilTagDetector::set_calibration_board_aprilgrid(int columns, int rows, double tag_size, double tag_spacing, const String &family) {
+	cv::aruco::Dictionary dictionary;
+	if (!find_predefined_dictionary(family.utf8().get_data(), dictionary)) {
+		UtilityFunctions::print("Unknown marker family: ", family);
+		return false;
+	}
+	if (calibrator.is_running() || columns < 2 || rows < 2 || tag_size <= 0.0 || tag_spacing <= 0.0) {
+		UtilityFunctions::print("Invalid AprilGrid board, or calibration running");
+		return false;
+	}
+	calibrator.set_aprilgrid_board(columns, rows, (float)tag_size, (float)tag_spacing, dictionary);
+	return true;
+}
+
+bool AprilTagDetector::start_calibration() {
+	if (!calibrator.start()) {
+		UtilityFunctions::print("Set a calibration board first");
+		return false;
+	}
+	return true;
+}
+
+void AprilTagDetector::stop_calibration() {
+	calibrator.stop();
+}
+
+bool AprilTagDetector::is_calibrating() const {
+	return calibrator.is_running();
+}
+
+Dictionary AprilTagDetector::get_calibration_status() const {
+	CameraCalibrator::Result result = calibrator.result();
+	Dictionary status;
+	status["examined_frames"] = calibrator.get_examined_frames();
+	status["board_frames"] = calibrator.get_board_frames();
+	status["views"] = calibrator.get_view_count();
+	status["calibrated"] = result.calibrated;
+	status["rms"] = result.calibrated ? result.rms : -1.0;
+	status["width"] = result.frame_size.width;
+	status["height"] = result.frame_size.height;
+	return status;
+}
+
+bool AprilTagDetector::save_calibration(const String &json_path) {
+	CameraCalibrator::Result result = calibrator.result();
+	if (!result.calibrated) {
+		UtilityFunctions::print("No calibration yet");
+		return false;
+	}
+	
+	Array matrix;
+	for (int i = 0; i < 3; i++) {
+		Array row;
+		for (int j = 0; j < 3; j++) {
+			row.append(result.camera_matrix.at<double>(i, j));
+		}
+		matrix.append(row);
+	}
+	Array coeffs;
+	for (int i = 0; i < 4; i++) {
+		Array coeff;
+		coeff.append(result.dist_coeffs.at<double>(i, 0));
+		coeffs.append(coeff);
+	}
+	Array resolution;
+	resolution.append(result.frame_size.width);
+	resolution.append(result.frame_size.height);
+	
+	Dictionary calibration;
+	calibration["camera_matrix"] = matrix;
+	calibration["dist_coeffs"] = coeffs;
+	calibration["distortion_model"] = "pinhole";
+	calibration["resolution"] = resolution;
+	calibration["rms"] = result.rms;
+	calibration["views"] = result.views;
+	Dictionary data;
+	data["calibration"] = calibration;
+	
+	Ref<FileAccess> file = FileAccess::open(json_path, FileAccess::WRITE);
+	if (file.is_null()) {
+		UtilityFunctions::print("Failed to open JSON file for writing: ", json_path);
+		return false;
+	}
+	file->store_string(JSON::stringify(data, "  ", false, true));
+	file->close();
+	UtilityFunctions::print("Calibration saved: ", json_path, ", rms ", String::num(result.rms, 3), " px");
+	return true;
+}
+
+// Use the running calibration's result for pose estimation right away
+bool AprilTagDetector::apply_calibration() {
+	CameraCalibrator::Result result = calibrator.result();
+	if (!result.calibrated) {
+		UtilityFunctions::print("No calibration yet");
+		return false;
+	}
+	config.update([&](DetectorConfig& next) {
+		next.has_camera_matrix = true;
+		next.camera_matrix = cv::Matx33d(result.camera_matrix);
+		next.dist_coeffs = result.dist_coeffs;
+		next.distortion_model = LensModel::MODEL_PINHOLE;
+		next.calibration_size = result.frame_size;
+		return true;
+	});
+	update_stereo_calibration();
+	return true;
+}
+
+void AprilTagDetector::set_frame_sharing_max_held(int frames) {
+	frame_share.set_max_held(frames);
+}
+
+int AprilTagDetector::get_frame_sharing_max_held() const {
+	return frame_share.get_max_held();
+}
+
+bool AprilTagDetector::set_contrast_mode(const String &mode) {
+	ContrastNormalizer::Mode contrast_mode;
+	if (mode == "none") {
+		contrast_mode = ContrastNormalizer::MODE_NONE;
+	} else if (mode == "clahe") {
+		contrast_mode = ContrastNormalizer::MODE_CLAHE;
+	} else if (mode == "local_normalization") {
+		contrast_mode = ContrastNormalizer::MODE_LOCAL_NORMALIZATION;
+	} else {
+		UtilityFunctions::print("Unknown contrast mode: ", mode);
+		return false;
+	}
+	config.update([&](DetectorConfig& next) {
+		next.contrast.mode = contrast_mode;
+		return true;
+	});
+	return true;
+}
+
+String AprilTagDetector::get_contrast_mode() const {
+	switch (config.copy().contrast.mode) {
+		case ContrastNormalizer::MODE_CLAHE:
+			return "clahe";
+		case ContrastNormalizer::MODE_LOCAL_NORMALIZATION:
+			return "local_normalization";
+		default:
+			return "none";
+	}
+}
+
+void AprilTagDetector::set_clahe_parameters(double clip_limit, int tile_grid) {
+	config.update([&](DetectorConfig& next) {
+		next.contrast.clip_limit = clip_limit;
+		next.contrast.tile_grid = tile_grid;
+		return true;
+	});
+}
+
+void AprilTagDetector::set_local_normalization_window(int window_size) {
+	config.update([&](DetectorConfig& next) {
+		next.contrast.window = window_size;
+		return true;
+	});
+}
+
+Dictionary AprilTagDetector::get_stats() const {
+	PipelineStatsSnapshot snapshot = stats.snapshot();
+	Dictionary result;
+	result["frames"] = (int64_t)snapshot.frames;
+	result["markers"] = (int64_t)snapshot.markers;
+	result["early_exits"] = (int64_t)snapshot.early_exits;
+	result["budget_overruns"] = (int64_t)snapshot.budget_overruns;
+	result["incomplete_frames"] = (int64_t)snapshot.incomplete_frames;
+	result["gated_markers"] = (int64_t)snapshot.gated_markers;
+	result["shared_frames"] = (int64_t)frame_share.get_shared_frames();
+	result["share_timeouts"] = (int64_t)frame_share.get_timeouts();
+	result["share_clients"] = frame_share.get_client_count();
+	result["logged_frames"] = (int64_t)detection_log.get_frames();
+	result["log_dropped_frames"] = (int64_t)detection_log.get_dropped_frames();
+	result["recorded_frames"] = (int64_t)frame_recorder.get_frames();
+	result["recording_dropped_frames"] = (int64_t)frame_recorder.get_dropped_frames();
+	result["stereo_pairs"] = (int64_t)stereo.get_pairs();
+	result["stereo_unpaired_frames"] = (int64_t)stereo.get_unpaired_frames();
+	result["stereo_dropped_frames"] = (int64_t)stereo.get_dropped_frames();
+	result["cpu_kernels"] = String(cpu_kernels().name);
+	
+	// Per stage: {"last_us", "avg_us", "max_us", "samples"}
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		const StageTiming& timing = snapshot.stages[i];
+		Dictionary stage;
+		stage["samples"] = (int64_t)timing.samples;
+		stage["last_us"] = timing.last_us;
+		stage["avg_us"] = timing.samples > 0 ? timing.total_us / timing.samples : 0.0;
+		stage["max_us"] = timing.max_us;
+		result[PipelineStats::stage_name((PipelineStage)i)] = stage;
+	}
+	return result;
+}
+
+void AprilTagDetector::reset_stats() {
+	stats.reset();
 }
\ No newline at end of file
@@ -6,12 +6,30 @@
 #include <godot_cpp/variant/array.hpp>
 #include <godot_cpp/variant/dictionary.hpp>
 #include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/packed_vector2_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
 #include <godot_cpp/classes/image.hpp>
 #include <godot_cpp/classes/image_texture.hpp>
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/aruco.hpp>
 #include <libcamera/libcamera.h>
+#include "detection_engine.h"
+#include "batch_pose.h"
+#include "pose_tracker.h"
+#include "contrast_normalizer.h"
+#include "pipeline_stats.h"
+#include "shm_publisher.h"
+#include "frame_share.h"
+#include "detection_log.h"
+#include "frame_replay.h"
+#include "stereo_matcher.h"
+#include "camera_calibrator.h"
+#include "lens_model.h"
+#include "config_snapshot.h"
+#include "frame_trace.h"
+#include "cpu_kernels.h"
+#include "preview_overlay.h"
 #include <memory>
 #include <atomic>
 
@@ -20,21 +38,116 @@ namespace godot {
 class AprilTagDetector : public Resource {
 	GDCLASS(AprilTagDetector, Resource)
 
+public:
+	// What the frame thread reads each frame. Published whole and never
+	// changed afterwards, so a frame sees one consistent configuration
+	struct DetectorConfig {
+		bool has_camera_matrix = false;
+		cv::Matx33d camera_matrix = cv::Matx33d::eye();
+		cv::Mat dist_coeffs;
+		LensModel::Model distortion_model = LensModel::MODEL_PINHOLE;
+		cv::Size calibration_size; // Resolution camera_matrix describes, empty if unknown
+		double marker_size = 0.05;
+		bool batched_pose = false; // All markers of a frame through BatchPoseSolver
+		int pose_refinement_iterations = 2;
+		bool pose_disambiguation = false;
+		double pose_ambiguity_ratio = 4.0; // See PoseTracker::set_ambiguity_ratio
+		std::vector<FamilyEntry> families; // Only ever appended to; enabled ones have their tables built
+		uint64_t families_version = 0; // Bumped with every change to families
+		cv::aruco::DetectorParameters detector_params;
+		uint64_t detector_params_version = 0; // Bumped with every change to detector_params
+		std::vector<DetectionMask::Polygon> detection_regions;
+		cv::Matx33d detection_region_reference = cv::Matx33d::eye(); // Intrinsics the regions' pixels refer to
+		uint64_t detection_regions_version = 0;
+		ContrastNormalizer::Settings contrast;
+		std::vector<MarkerId> expected_markers; // Expected-set mode when not empty
+		uint64_t expected_markers_version = 0;
+		int expected_search_budget_us = 0; // See DetectionEngine::set_expected_search_budget_us
+		bool detection_engine = false; // Our engine even where the stock detector would do
+		bool run_segmentation = false; // See DetectionEngine::set_run_segmentation_enabled
+		int frame_budget_us = 0; // See DetectionEngine::set_frame_budget_us
+		int max_decode_hamming = -1; // Confidence gates, see DetectionEngine::set_max_hamming
+		float min_corner_sharpness = 0.0f;
+		double max_reprojection_error = 0.0; // Publication gate in pixels, 0 = off
+		
+		bool calibrated() const { return has_camera_matrix && !dist_coeffs.empty(); }
+		double family_marker_size(int family) const {
+			double size = family < (int)families.size() ? families[family].marker_size : 0.0;
+			return size > 0.0 ? size : marker_size;
+		}
+		int find_family(const std::string &name) const {
+			for (size_t i = 0; i < families.size(); i++) {
+				if (families[i].family->name == name) {
+					return (int)i;
+				}
+			}
+			return -1;
+		}
+		bool is_expected(int family, int id) const {
+			for (const MarkerId& marker : expected_markers) {
+				if (marker.family == family && marker.id == id) {
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
 private:
-	cv::Mat camera_matrix;
-	cv::Mat dist_coeffs;
+	ConfigSnapshot<DetectorConfig> config; // Setters publish, frames read without locking
+	uint64_t applied_params_version; // Frame thread: detector_params_version in `detector` and the engine
+	uint64_t applied_families_version; // Frame thread: families_version in the engine
+	uint64_t applied_regions_version; // Frame thread: detection_regions_version in the engine's mask
+	uint64_t applied_expected_version; // Frame thread: expected_markers_version in the engine
+	uint64_t stereo_params_version; // Same for stereo_engine
+	uint64_t stereo_families_version;
+	LensModel lens; // Corner undistortion table for the current calibration
 	cv::aruco::Dictionary aruco_dict;
-	cv::aruco::DetectorParameters detector_params;
 	cv::aruco::ArucoDetector detector;
-	bool is_initialized;
-	double marker_size;
+	DetectionEngine detection_engine; // Integral-image threshold front-end
+	BatchPoseSolver pose_solver; // Float32 SIMD IPPE over all markers of a frame
+	std::vector<cv::Point2f> pose_corners; // Reused across frames
+	std::vector<cv::Point2f> pose_normalized;
+	PoseTracker pose_tracker; // Picks between the two IPPE solutions over time; frame thread only
+	std::atomic<bool> pose_tracker_reset; // Set by the Godot thread, cleared by the frame thread
+	ContrastNormalizer contrast_normalizer; // Optional CLAHE / local normalisation before detection; frame thread only
+	PipelineStats stats;
+	std::atomic<bool> last_frame_complete;
+	ShmPublisher shm_publisher; // Result sets for other local processes
+	std::mutex shm_mutex;
+	int shm_family_count;
+	FrameShareServer frame_share; // Raw camera buffers for other local processes
+	DetectionLogWriter detection_log; // Full result history, written on its own thread
+	std::vector<LogMarker> log_markers; // Reused across frames
+	FrameRecordingWriter frame_recorder; // Raw frames for replay
+	FrameReplay replay; // Stands in for the camera while running
+	StereoMatcher stereo; // Pairs and triangulates detections of the two cameras
+	// The "stereo" calibration section as loaded, before rescaling to the stream
+	struct StereoSection {
+		cv::Matx33d camera_matrix = cv::Matx33d::eye();
+		cv::Mat dist_coeffs;
+		LensModel::Model distortion_model = LensModel::MODEL_PINHOLE;
+		cv::Size calibration_size; // Empty if unknown
+		cv::Matx33d rotation = cv::Matx33d::eye();
+		cv::Vec3d translation;
+	};
+	bool has_stereo_section;
+	StereoSection stereo_section;
+	cv::Size stream_size; // Of the first camera, empty until it is configured
+	cv::Size stereo_stream_size;
+	DetectionEngine stereo_engine; // Second camera's detector, same families as the first
+	std::vector<DetectedMarker> stereo_markers; // Reused across frames
+	CameraCalibrator calibrator; // Background calibration from the live stream
 	
 	// libcamera members
 	std::unique_ptr<libcamera::CameraManager> camera_manager;
 	std::shared_ptr<libcamera::Camera> camera;
 	std::unique_ptr<libcamera::FrameBufferAllocator> allocator;
 	std::vector<std::unique_ptr<libcamera::Request>> requests;
-	bool camera_running;
+	std::shared_ptr<libcamera::Camera> stereo_camera; // Optional second camera of a stereo pair
+	std::unique_ptr<libcamera::FrameBufferAllocator> stereo_allocator;
+	std::vector<std::unique_ptr<libcamera::Request>> stereo_requests;
+	std::atomic<bool> camera_running; // Also read by the frame-sharing thread in requeue_request
 	
 	// Video feedback members
 	bool video_feedback_enabled;
@@ -43,6 +156,8 @@ private:
 	std::mutex frame_mutex;
 	Ref<ImageTexture> cached_texture; // Reuse texture instead of creating new ones
 	PackedByteArray cached_byte_array; // Reuse byte array for memory efficiency
+	std::atomic<bool> preview_overlay_enabled; // Detections drawn into the preview itself; set by Godot, read per frame
+	std::vector<OverlayMarker> overlay_markers; // Frame thread only
 	
 	// Video feedback dimensions
 	static constexpr int VIDEO_WIDTH = 400;
@@ -56,6 +171,7 @@ public:
 	// Frame skipping for performance (public for callback access)
 	static std::atomic<int> frame_skip_counter;
 	static constexpr int PROCESS_EVERY_N_FRAMES = 1; // Process every frame for faster detection updates
+	static constexpr uint64_t STEREO_CAMERA_COOKIE = 1; // Request cookie of the second camera
 	
 protected:
 	static void _bind_methods();
@@ -75,12 +191,129 @@ public:
 	Ref<ImageTexture> get_current_frame_texture();
 	void set_video_feedback_enabled(bool enabled);
 	bool get_video_feedback_enabled() const;
+	void set_preview_overlay_enabled(bool enabled);
+	bool get_preview_overlay_enabled() const;
+	void set_detection_engine_enabled(bool enabled);
+	bool get_detection_engine_enabled() const;
+	void set_run_segmentation_enabled(bool enabled);
+	bool get_run_segmentation_enabled() const;
+	void set_batched_pose_enabled(bool enabled);
+	bool get_batched_pose_enabled() const;
+	void set_pose_refinement_iterations(int iterations);
+	int get_pose_refinement_iterations() const;
+	void set_pose_disambiguation_enabled(bool enabled);
+	bool get_pose_disambiguation_enabled() const;
+	void set_pose_ambiguity_ratio(double ratio);
+	double get_pose_ambiguity_ratio() const;
+	
+	// Marker families decoded in one shared pass (e.g. "apriltag_36h11", "aruco_4x4_50")
+	bool set_marker_family_enabled(const String &family, bool enabled);
+	bool set_marker_family_size(const String &family, double size);
+	Array get_marker_families() const;
+	
+	// Detection regions in pixels of the current camera resolution. They are
+	// rasterised once and follow later rescaling of the camera matrix.
+	bool add_detection_roi(const PackedVector2Array &polygon);
+	bool add_detection_exclusion(const PackedVector2Array &polygon);
+	void clear_detection_regions();
+	
+	// Expected-set mode: stop detecting as soon as these markers are found,
+	// searching their last known positions first
+	bool add_expected_markers(const String &family, const PackedInt32Array &ids);
+	void clear_expected_markers();
+	void set_expected_search_budget_us(int budget_us);
+	int get_expected_search_budget_us() const;
+	
+	// Hard bound on detection time per frame (0 = none). Frames cut short are
+	// reported as incomplete and the next frame resumes where this one stopped.
+	void set_frame_budget_us(int budget_us);
+	int get_frame_budget_us() const;
+	bool is_last_frame_complete() const;
+	
+	// Confidence gates: marginal decodes and blurred markers are dropped before
+	// pose estimation, poses with a large reprojection error before publication
+	void set_max_decode_hamming(int bits);
+	int get_max_decode_hamming() const;
+	void set_min_corner_sharpness(double sharpness);
+	double get_min_corner_sharpness() const;
+	void set_max_reprojection_error(double pixels);
+	double get_max_reprojection_error() const;
+	
+	// Publish every result set into a POSIX shared-memory ring for other
+	// processes (layout and reader helpers in apriltag_shm.h)
+	bool start_shared_memory_publisher(const String &name);
+	void stop_shared_memory_publisher();
+	
+	// Pass raw camera buffers (dmabuf fds) to other processes over a UNIX
+	// socket, protocol in apriltag_frame_share.h. A buffer is requeued once
+	// every client released it or after timeout_ms
+	bool start_frame_sharing(const String &socket_path, int timeout_ms);
+	void stop_frame_sharing();
+	void set_frame_sharing_max_held(int frames);
+	int get_frame_sharing_max_held() const;
+	
+	// Append every result set to a binary log, read back with AprilTagLog
+	bool start_detection_log(const String &path);
+	void stop_detection_log();
+	bool is_detection_log_open() const;
+	
+	// Per-thread spans of every frame stage, written as Chrome trace-event
+	// JSON for ui.perfetto.dev
+	void start_trace();
+	void stop_trace();
+	bool is_tracing() const;
+	bool dump_trace(const String &path);
+	
+	// Record raw frames, then replay them in place of the camera with their
+	// original timing (scaled by speed) and a pool of `buffers` requests
+	bool start_frame_recording(const String &path);
+	void stop_frame_recording();
+	bool start_replay(const String &path, double speed, bool loop, int buffers);
+	void stop_replay();
+	bool is_replaying() const;
+	Dictionary get_replay_report() const;
+	
+	// Stereo pair: the second camera's detections are matched to the first's by
+	// sensor timestamp and triangulated, using the "stereo" calibration section
+	bool initialize_stereo_camera();
+	bool has_stereo_calibration() const;
+	void set_stereo_time_tolerance_ms(double tolerance_ms);
+	double get_stereo_time_tolerance_ms() const;
+	Array get_latest_stereo_detections();
+	
+	// Calibration mode: board views are picked from the live stream and
+	// calibrateCamera reruns on its own thread after each new view
+	bool set_calibration_board_charuco(int squares_x, int squares_y, double square_length, double marker_length, const String &family);
+	bool set_calibration_board_aprilgrid(int columns, int rows, double tag_size, double tag_spacing, const String &family);
+	bool start_calibration();
+	void stop_calibration();
+	bool is_calibrating() const;
+	Dictionary get_calibration_status() const;
+	// Writes the format load_camera_parameters reads, with the resolution
+	bool save_calibration(const String &json_path);
+	bool apply_calibration();
+	
+	// Contrast normalisation before detection: "none", "clahe" or "local_normalization"
+	bool set_contrast_mode(const String &mode);
+	String get_contrast_mode() const;
+	void set_clahe_parameters(double clip_limit, int tile_grid);
+	void set_local_normalization_window(int window_size);
+	
+	// Frame counts and per-stage timings in microseconds
+	Dictionary get_stats() const;
+	void reset_stats();
 	
 	void set_camera_matrix(const Array &matrix);
 	void set_distortion_coefficients(const Array &coeffs);
+	// "pinhole" (4, 5, 8, 12 or 14 coefficients) or "fisheye" (4)
+	bool set_distortion_model(const String &model);
+	String get_distortion_model() const;
 	void set_marker_size(double size);
 	Array get_camera_matrix() const;
 	Array get_distortion_coefficients() const;
+	// Keys named as DetectorParameters' fields in snake_case; taken up on the next frame
+	bool set_detector_parameters(const Dictionary &parameters);
+	Dictionary get_detector_parameters() const;
 	
 	// Helper method to adjust camera calibration for different resolution
 	void adjust_camera_matrix_for_resolution(int actual_width, int actual_height, int calibration_width, int calibration_height);
@@ -88,15 +321,43 @@ public:
 	// Detection result structure for Godot
 	struct DetectionResult {
 		int marker_id;
+		String family;
 		Vector3 rvec;
 		Vector3 tvec;
+		bool ambiguous; // Both planar solutions fit about equally well
+		bool incomplete; // Frame budget ran out before the whole frame was searched
+		int hamming; // Bits corrected by the decode, -1 if unknown
+		float sharpness; // Corner sharpness, 1 = crisp edges
+		double reprojection_error; // RMS pixels, -1 without a pose
 		Array corners;
 	};
 	
 	// Public access methods for callback
-	void process_frame_for_detection(cv::Mat& frame, std::vector<DetectionResult>& results);
-	void store_frame_for_video_feedback(cv::Mat& frame);
+	// `overlay`, if given, receives the published markers for the preview overlay
+	void process_frame_for_detection(cv::Mat& frame, std::vector<DetectionResult>& results, uint64_t timestamp_ns = 0, uint64_t sequence = 0,
+		std::vector<OverlayMarker>* overlay = nullptr);
+	void complete_frame(cv::Mat& frame, uint64_t timestamp_ns, uint64_t sequence);
+	void complete_stereo_frame(cv::Mat& frame, uint64_t timestamp_ns);
+	void store_frame_for_video_feedback(cv::Mat& frame, const std::vector<OverlayMarker>* overlay = nullptr);
 	void requeue_request(libcamera::Request* request);
+	bool share_frame(libcamera::Request* request, const libcamera::StreamConfiguration& config, const libcamera::FrameBuffer* buffer);
+
+private:
+	bool configure_camera(std::shared_ptr<libcamera::Camera> cam, std::unique_ptr<libcamera::FrameBufferAllocator>& alloc,
+		std::vector<std::unique_ptr<libcamera::Request>>& reqs, uint64_t cookie, cv::Size& size);
+	bool load_stereo_calibration(const Dictionary &section);
+	void update_stereo_calibration();
+	void prepare_stereo_engine();
+	bool uses_stock_detector(const DetectorConfig &cfg) const;
+	bool add_detection_region(const PackedVector2Array &polygon, bool include);
+	void estimate_poses_batched(const DetectorConfig &cfg, const std::vector<DetectedMarker> &markers, std::vector<DetectionResult> &results);
+	void estimate_pose_both_solutions(const DetectedMarker &marker, const cv::Point2f normalized[4], double size, DetectionResult &result);
+	void apply_pose(const DetectedMarker &marker, const PoseTracker::Solution solutions[2], DetectionResult &result);
+	double reprojection_error_px(const DetectedMarker &marker, double size, const DetectionResult &result) const;
+	void fill_overlay(const DetectorConfig &cfg, const std::vector<DetectedMarker> &markers,
+		const std::vector<DetectionResult> &results, std::vector<OverlayMarker> &overlay) const;
+	void publish_results(const std::vector<DetectedMarker> &markers, const std::vector<DetectionResult> &results,
+		uint64_t timestamp_ns, uint64_t sequence, bool complete);
 };
 
 }
@@ -0,0 +1,134 @@
+/*
+ * Raw frame sharing protocol, for clients in other processes. Plain C.
+ *
+ * The detector listens on a UNIX-domain SOCK_SEQPACKET socket. For every
+ * shared frame each connected client receives one apriltag_frame_message
+ * with the frame's dmabuf file descriptors attached (SCM_RIGHTS, one per
+ * plane). The camera buffer stays out of the capture queue until every
+ * client has sent an apriltag_frame_release for it, or until timeout_ms has
+ * passed; after that the buffer may be overwritten by the camera at any time.
+ *
+ * The descriptors belong to the client: close them once the frame is
+ * released. mmap them read-only.
+ *
+ * Client usage:
+ *
+ *     int sock = apriltag_frame_share_connect(APRILTAG_FRAME_SHARE_DEFAULT_PATH);
+ *     apriltag_frame_message msg;
+ *     int fds[APRILTAG_FRAME_SHARE_MAX_PLANES];
+ *     int n = apriltag_frame_share_receive(sock, &msg, fds);
+ *     if (n > 0) {
+ *         void *data = mmap(NULL, msg.planes[0].offset + msg.planes[0].length,
+ *                 PROT_READ, MAP_SHARED, fds[0], 0);
+ *         ...
+ *         apriltag_frame_share_release(sock, msg.frame_id);
+ *         for (int i = 0; i < n; i++) close(fds[i]);
+ *     }
+ */
+#ifndef APRILTAG_FRAME_SHARE_H
+#define APRILTAG_FRAME_SHARE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define APRILTAG_FRAME_SHARE_DEFAULT_PATH "/tmp/apriltag_frames.sock"
+#define APRILTAG_FRAME_SHARE_MAGIC 0x46545041u /* "APTF" */
+#define APRILTAG_FRAME_SHARE_VERSION 1
+#define APRILTAG_FRAME_SHARE_MAX_PLANES 4
+
+typedef struct {
+	uint32_t offset; /* Bytes into the plane's fd */
+	uint32_t length;
+} apriltag_frame_plane;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t frame_id; /* Echo back in apriltag_frame_release */
+	uint64_t sequence; /* libcamera frame sequence */
+	uint64_t timestamp_ns; /* libcamera sensor timestamp */
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride; /* Bytes per row of plane 0 */
+	uint32_t fourcc; /* DRM fourcc, e.g. "R8  " for 8-bit monochrome */
+	uint32_t timeout_ms; /* The buffer is requeued after this even without a release */
+	uint32_t plane_count; /* Number of attached fds, same order as planes */
+	apriltag_frame_plane planes[APRILTAG_FRAME_SHARE_MAX_PLANES];
+} apriltag_frame_message;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t frame_id;
+} apriltag_frame_release;
+
+/* Returns a connected socket, or -1 */
+static inline int apriltag_frame_share_connect(const char *path) {
+	struct sockaddr_un addr;
+	int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0) {
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	if (connect(sock, (const struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/* Blocks for the next frame. Returns the number of fds stored in `fds`,
+ * 0 when the server closed the connection, -1 on error. */
+static inline int apriltag_frame_share_receive(int sock, apriltag_frame_message *msg, int fds[APRILTAG_FRAME_SHARE_MAX_PLANES]) {
+	union {
+		char buffer[CMSG_SPACE(sizeof(int) * APRILTAG_FRAME_SHARE_MAX_PLANES)];
+		struct cmsghdr align;
+	} control;
+	struct iovec iov;
+	struct msghdr header;
+	struct cmsghdr *cmsg;
+	ssize_t received;
+	int count = 0;
+
+	iov.iov_base = msg;
+	iov.iov_len = sizeof(*msg);
+	memset(&header, 0, sizeof(header));
+	header.msg_iov = &iov;
+	header.msg_iovlen = 1;
+	header.msg_control = control.buffer;
+	header.msg_controllen = sizeof(control.buffer);
+
+	received = recvmsg(sock, &header, MSG_CMSG_CLOEXEC);
+	if (received <= 0) {
+		return (int)received;
+	}
+	for (cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(&header, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+			count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+			memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * count);
+		}
+	}
+	if (received != sizeof(*msg) || msg->magic != APRILTAG_FRAME_SHARE_MAGIC ||
+			msg->version != APRILTAG_FRAME_SHARE_VERSION || count != (int)msg->plane_count) {
+		while (count > 0) {
+			close(fds[--count]);
+		}
+		return -1;
+	}
+	return count;
+}
+
+static inline int apriltag_frame_share_release(int sock, uint64_t frame_id) {
+	apriltag_frame_release release;
+	release.magic = APRILTAG_FRAME_SHARE_MAGIC;
+	release.reserved = 0;
+	release.frame_id = frame_id;
+	return send(sock, &release, sizeof(release), MSG_NOSIGNAL) == (ssize_t)sizeof(release) ? 0 : -1;
+}
+
+#endif
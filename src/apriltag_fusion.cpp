@@ -0,0 +1,166 @@
+#include "apriltag_fusion.h"
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/json.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+#include <godot_cpp/variant/vector3.hpp>
+#include <algorithm>
+
+using namespace godot;
+
+void AprilTagFusion::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("load_config", "path"), &AprilTagFusion::load_config);
+	ClassDB::bind_method(D_METHOD("add_camera", "name", "segment", "camera_to_world"), &AprilTagFusion::add_camera);
+	ClassDB::bind_method(D_METHOD("clear_cameras"), &AprilTagFusion::clear_cameras);
+	ClassDB::bind_method(D_METHOD("get_camera_count"), &AprilTagFusion::get_camera_count);
+	ClassDB::bind_method(D_METHOD("set_max_age_ms", "age_ms"), &AprilTagFusion::set_max_age_ms);
+	ClassDB::bind_method(D_METHOD("get_max_age_ms"), &AprilTagFusion::get_max_age_ms);
+	ClassDB::bind_method(D_METHOD("start", "period_us"), &AprilTagFusion::start, DEFVAL(2000));
+	ClassDB::bind_method(D_METHOD("stop"), &AprilTagFusion::stop);
+	ClassDB::bind_method(D_METHOD("is_running"), &AprilTagFusion::is_running);
+	ClassDB::bind_method(D_METHOD("get_fused_detections"), &AprilTagFusion::get_fused_detections);
+	ClassDB::bind_method(D_METHOD("get_stats"), &AprilTagFusion::get_stats);
+}
+
+bool AprilTagFusion::load_config(const String &path) {
+	if (fusion.is_running()) {
+		UtilityFunctions::print("Stop fusion before loading a configuration");
+		return false;
+	}
+
+	Ref<FileAccess> file = FileAccess::open(path, FileAccess::READ);
+	if (file.is_null()) {
+		UtilityFunctions::print("Failed to open fusion configuration: ", path);
+		return false;
+	}
+	String json_text = file->get_as_text();
+	file->close();
+
+	Ref<JSON> json = memnew(JSON);
+	if (json->parse(json_text) != OK) {
+		UtilityFunctions::print("Failed to parse JSON: ", json->get_error_message());
+		return false;
+	}
+
+	Dictionary data = json->get_data();
+	if (!data.has("cameras")) {
+		UtilityFunctions::print("Fusion configuration missing 'cameras'");
+		return false;
+	}
+
+	clear_cameras();
+	Array cameras = data["cameras"];
+	for (int i = 0; i < cameras.size(); i++) {
+		Dictionary camera = cameras[i];
+		if (!camera.has("segment") || !camera.has("rotation") || !camera.has("translation")) {
+			UtilityFunctions::print("Fusion camera ", String::num_int64(i), " needs segment, rotation and translation");
+			return false;
+		}
+
+		Array rotation = camera["rotation"];
+		Array translation = camera["translation"];
+		if (rotation.size() != 3 || translation.size() != 3) {
+			UtilityFunctions::print("Invalid extrinsics for fusion camera ", String::num_int64(i));
+			return false;
+		}
+		Basis basis;
+		for (int r = 0; r < 3; r++) {
+			Array row = rotation[r];
+			if (row.size() != 3) {
+				UtilityFunctions::print("Invalid extrinsics for fusion camera ", String::num_int64(i));
+				return false;
+			}
+			basis.rows[r] = Vector3(row[0], row[1], row[2]);
+		}
+
+		String segment = camera["segment"];
+		String name = camera.has("name") ? String(camera["name"]) : segment;
+		if (!add_camera(name, segment, Transform3D(basis, Vector3(translation[0], translation[1], translation[2])))) {
+			return false;
+		}
+	}
+
+	if (data.has("max_age_ms")) {
+		set_max_age_ms(data["max_age_ms"]);
+	}
+	UtilityFunctions::print("Fusion configuration loaded: ", String::num_int64(fusion.get_camera_count()), " cameras");
+	return true;
+}
+
+bool AprilTagFusion::add_camera(const String &name, const String &segment, const Transform3D &camera_to_world) {
+	const Basis& b = camera_to_world.basis;
+	cv::Matx33d rotation(b.rows[0].x, b.rows[0].y, b.rows[0].z,
+		b.rows[1].x, b.rows[1].y, b.rows[1].z,
+		b.rows[2].x, b.rows[2].y, b.rows[2].z);
+	cv::Vec3d translation(camera_to_world.origin.x, camera_to_world.origin.y, camera_to_world.origin.z);
+	if (fusion.add_camera(name.utf8().get_data(), segment.utf8().get_data(), rotation, translation) < 0) {
+		UtilityFunctions::print("Stop fusion before adding cameras");
+		return false;
+	}
+	return true;
+}
+
+void AprilTagFusion::clear_cameras() {
+	fusion.clear_cameras();
+}
+
+int AprilTagFusion::get_camera_count() const {
+	return fusion.get_camera_count();
+}
+
+void AprilTagFusion::set_max_age_ms(double age_ms) {
+	fusion.set_max_age_ns((int64_t)(std::max(0.0, age_ms) * 1e6));
+}
+
+double AprilTagFusion::get_max_age_ms() const {
+	return fusion.get_max_age_ns() / 1e6;
+}
+
+bool AprilTagFusion::start(int period_us) {
+	if (!fusion.start(period_us)) {
+		UtilityFunctions::print("Fusion needs at least one camera");
+		return false;
+	}
+	return true;
+}
+
+void AprilTagFusion::stop() {
+	fusion.stop();
+}
+
+bool AprilTagFusion::is_running() const {
+	return fusion.is_running();
+}
+
+Array AprilTagFusion::get_fused_detections() const {
+	Array results;
+	for (const FusedMarker& marker : fusion.latest()) {
+		Dictionary result;
+		result["id"] = marker.id;
+		result["family"] = String(marker.family.c_str());
+		result["timestamp_ns"] = (int64_t)marker.timestamp_ns;
+		result["position"] = Vector3(marker.position[0], marker.position[1], marker.position[2]);
+		result["rvec"] = Vector3(marker.rvec[0], marker.rvec[1], marker.rvec[2]);
+		result["cameras"] = marker.cameras;
+		result["spread"] = marker.spread;
+		results.append(result);
+	}
+	return results;
+}
+
+Dictionary AprilTagFusion::get_stats() const {
+	Dictionary result;
+	result["fused_frames"] = (int64_t)fusion.get_fused_frames();
+
+	// Per camera: {"name", "connected", "frames"}
+	Array cameras;
+	for (int i = 0; i < fusion.get_camera_count(); i++) {
+		Dictionary camera;
+		camera["name"] = String(fusion.get_camera_name(i).c_str());
+		camera["connected"] = fusion.is_camera_connected(i);
+		camera["frames"] = (int64_t)fusion.get_camera_frames(i);
+		cameras.append(camera);
+	}
+	result["cameras"] = cameras;
+	return result;
+}
@@ -0,0 +1,47 @@
+#ifndef APRILTAG_FUSION_H
+#define APRILTAG_FUSION_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/transform3d.hpp>
+
+#include "pose_fusion.h"
+
+namespace godot {
+
+// Fuses the detections of several cameras, each run by its own detector
+// process that publishes with AprilTagDetector.start_shared_memory_publisher(),
+// into one world frame
+class AprilTagFusion : public RefCounted {
+	GDCLASS(AprilTagFusion, RefCounted)
+
+private:
+	PoseFusion fusion;
+
+protected:
+	static void _bind_methods();
+
+public:
+	// {"max_age_ms": 50, "cameras": [{"name", "segment", "rotation": 3x3, "translation": [x, y, z]}]}
+	// with each camera's pose in the world (camera to world)
+	bool load_config(const String &path);
+	bool add_camera(const String &name, const String &segment, const Transform3D &camera_to_world);
+	void clear_cameras();
+	int get_camera_count() const;
+
+	void set_max_age_ms(double age_ms);
+	double get_max_age_ms() const;
+
+	bool start(int period_us);
+	void stop();
+	bool is_running() const;
+
+	// {"id", "family", "timestamp_ns", "position", "rvec", "cameras", "spread"}, world frame
+	Array get_fused_detections() const;
+	Dictionary get_stats() const;
+};
+
+}
+
+#endif
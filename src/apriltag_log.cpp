@@ -0,0 +1,113 @@
+#include "apriltag_log.h"
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/vector3.hpp>
+
+using namespace godot;
+
+void AprilTagLog::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("open", "path"), &AprilTagLog::open);
+	ClassDB::bind_method(D_METHOD("close"), &AprilTagLog::close);
+	ClassDB::bind_method(D_METHOD("is_open"), &AprilTagLog::is_open);
+	ClassDB::bind_method(D_METHOD("get_frame_count"), &AprilTagLog::get_frame_count);
+	ClassDB::bind_method(D_METHOD("get_start_time_ns"), &AprilTagLog::get_start_time_ns);
+	ClassDB::bind_method(D_METHOD("get_end_time_ns"), &AprilTagLog::get_end_time_ns);
+	ClassDB::bind_method(D_METHOD("was_recovered"), &AprilTagLog::was_recovered);
+	ClassDB::bind_method(D_METHOD("get_family_names"), &AprilTagLog::get_family_names);
+	ClassDB::bind_method(D_METHOD("next_frame"), &AprilTagLog::next_frame);
+	ClassDB::bind_method(D_METHOD("seek", "timestamp_ns"), &AprilTagLog::seek);
+	ClassDB::bind_method(D_METHOD("rewind"), &AprilTagLog::rewind);
+}
+
+bool AprilTagLog::open(const String &path) {
+	std::string file = ProjectSettings::get_singleton()->globalize_path(path).utf8().get_data();
+	if (!reader.open(file)) {
+		UtilityFunctions::print("Failed to open detection log: ", path);
+		return false;
+	}
+	if (reader.was_recovered()) {
+		UtilityFunctions::print("Detection log was not closed cleanly, index rebuilt: ", path);
+	}
+	return true;
+}
+
+void AprilTagLog::close() {
+	reader.close();
+}
+
+bool AprilTagLog::is_open() const {
+	return reader.is_open();
+}
+
+int64_t AprilTagLog::get_frame_count() const {
+	return (int64_t)reader.get_frame_count();
+}
+
+int64_t AprilTagLog::get_start_time_ns() const {
+	return (int64_t)reader.get_start_time();
+}
+
+int64_t AprilTagLog::get_end_time_ns() const {
+	return (int64_t)reader.get_end_time();
+}
+
+bool AprilTagLog::was_recovered() const {
+	return reader.was_recovered();
+}
+
+PackedStringArray AprilTagLog::get_family_names() const {
+	PackedStringArray names;
+	for (const std::string& name : reader.get_family_names()) {
+		names.append(String(name.c_str()));
+	}
+	return names;
+}
+
+Dictionary AprilTagLog::next_frame() {
+	Dictionary result;
+	if (!reader.next(frame)) {
+		return result;
+	}
+	
+	const std::vector<std::string>& families = reader.get_family_names();
+	bool incomplete = (frame.flags & LOG_FRAME_INCOMPLETE) != 0;
+	Array detections;
+	for (const LogMarker& marker : frame.markers) {
+		Dictionary detection;
+		detection["id"] = marker.id;
+		detection["family"] = marker.family >= 0 && marker.family < (int)families.size() ?
+			String(families[marker.family].c_str()) : String();
+		detection["ambiguous"] = (marker.flags & LOG_MARKER_AMBIGUOUS) != 0;
+		detection["incomplete"] = incomplete;
+		detection["hamming"] = marker.hamming;
+		detection["corner_sharpness"] = marker.sharpness;
+		detection["reprojection_error"] = marker.reprojection_error;
+		detection["rvec"] = Vector3(marker.rvec[0], marker.rvec[1], marker.rvec[2]);
+		detection["tvec"] = Vector3(marker.tvec[0], marker.tvec[1], marker.tvec[2]);
+		Array corners;
+		for (int k = 0; k < 4; k++) {
+			Array point;
+			point.append(marker.corners[k * 2]);
+			point.append(marker.corners[k * 2 + 1]);
+			corners.append(point);
+		}
+		detection["corners"] = corners;
+		detections.append(detection);
+	}
+	
+	result["timestamp_ns"] = (int64_t)frame.timestamp_ns;
+	result["sequence"] = (int64_t)frame.sequence;
+	result["incomplete"] = incomplete;
+	result["detections"] = detections;
+	return result;
+}
+
+bool AprilTagLog::seek(int64_t timestamp_ns) {
+	return reader.seek(timestamp_ns < 0 ? 0 : (uint64_t)timestamp_ns);
+}
+
+void AprilTagLog::rewind() {
+	reader.rewind();
+}
@@ -0,0 +1,43 @@
+#ifndef APRILTAG_LOG_H
+#define APRILTAG_LOG_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+
+#include "detection_log.h"
+
+namespace godot {
+
+// GDScript reader for logs written by AprilTagDetector.start_detection_log()
+class AprilTagLog : public RefCounted {
+	GDCLASS(AprilTagLog, RefCounted)
+
+private:
+	DetectionLogReader reader;
+	LogFrame frame; // Reused across next_frame() calls
+
+protected:
+	static void _bind_methods();
+
+public:
+	bool open(const String &path);
+	void close();
+	bool is_open() const;
+
+	int64_t get_frame_count() const;
+	int64_t get_start_time_ns() const;
+	int64_t get_end_time_ns() const;
+	bool was_recovered() const;
+	PackedStringArray get_family_names() const;
+
+	// Frames in recording order; an empty Dictionary at the end of the log.
+	// Detections use the keys of AprilTagDetector.get_latest_detections()
+	Dictionary next_frame();
+	bool seek(int64_t timestamp_ns);
+	void rewind();
+};
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Shared-memory layout of published detections, for readers in other
+ * processes. Plain C, no dependencies beyond GCC/Clang atomic builtins.
+ *
+ * The detector writes every result set into a ring of fixed-size slots, each
+ * guarded by a seqlock: the slot's sequence is odd while it is being written.
+ * Readers never block the writer and never wait for it. The writer only
+ * touches the slot after the newest one, so reading the newest slot takes a
+ * single pass except when a reader stalls for a whole ring of frames.
+ *
+ * Reader usage:
+ *
+ *     int fd = shm_open(APRILTAG_SHM_DEFAULT_NAME, O_RDONLY, 0);
+ *     const apriltag_shm_segment *seg = mmap(NULL, sizeof(apriltag_shm_segment),
+ *             PROT_READ, MAP_SHARED, fd, 0);
+ *     apriltag_shm_frame frame;
+ *     if (apriltag_shm_valid(seg) && apriltag_shm_read_latest(seg, &frame)) {
+ *         for (uint32_t i = 0; i < frame.count; i++) { ... frame.markers[i] ... }
+ *     }
+ */
+#ifndef APRILTAG_SHM_H
+#define APRILTAG_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define APRILTAG_SHM_DEFAULT_NAME "/apriltag_detections"
+#define APRILTAG_SHM_MAGIC 0x47545041u /* "APTG" */
+#define APRILTAG_SHM_VERSION 1
+#define APRILTAG_SHM_SLOTS 8
+#define APRILTAG_SHM_MAX_MARKERS 64
+#define APRILTAG_SHM_MAX_FAMILIES 16
+#define APRILTAG_SHM_NAME_LENGTH 32
+
+/* apriltag_shm_marker.flags */
+#define APRILTAG_SHM_HAS_POSE 0x1u
+#define APRILTAG_SHM_AMBIGUOUS 0x2u
+
+/* apriltag_shm_frame.flags */
+#define APRILTAG_SHM_INCOMPLETE 0x1u /* Frame budget ran out, see set_frame_budget_us */
+#define APRILTAG_SHM_TRUNCATED 0x2u  /* More than APRILTAG_SHM_MAX_MARKERS were detected */
+
+typedef struct {
+	int32_t id;
+	int32_t family; /* Index into apriltag_shm_segment.family_names */
+	float corners[8]; /* x0 y0 .. x3 y3, pixels, clockwise from the marker's top-left */
+	float rvec[3]; /* Rodrigues rotation, camera frame */
+	float tvec[3]; /* Metres, camera frame */
+	int32_t hamming;
+	float sharpness;
+	float reprojection_error;
+	uint32_t flags;
+} apriltag_shm_marker;
+
+typedef struct {
+	uint32_t sequence; /* Seqlock: odd while the slot is being written */
+	uint32_t count;
+	uint32_t flags;
+	uint32_t reserved;
+	uint64_t frame_number; /* 1 for the first published frame */
+	uint64_t timestamp_ns; /* libcamera sensor timestamp, nanoseconds */
+	apriltag_shm_marker markers[APRILTAG_SHM_MAX_MARKERS];
+} apriltag_shm_frame;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t max_markers;
+	uint64_t latest; /* frame_number of the newest complete slot, 0 before the first */
+	char family_names[APRILTAG_SHM_MAX_FAMILIES][APRILTAG_SHM_NAME_LENGTH];
+	apriltag_shm_frame slots[APRILTAG_SHM_SLOTS];
+} apriltag_shm_segment;
+
+static inline int apriltag_shm_valid(const apriltag_shm_segment *seg) {
+	return seg && seg->magic == APRILTAG_SHM_MAGIC && seg->version == APRILTAG_SHM_VERSION;
+}
+
+/* Copy the slot holding `frame_number`. Returns 1 on success, 0 if the slot
+ * was overwritten or is being written. Never blocks. */
+static inline int apriltag_shm_read_frame(const apriltag_shm_segment *seg, uint64_t frame_number, apriltag_shm_frame *out) {
+	const apriltag_shm_frame *slot = &seg->slots[frame_number % APRILTAG_SHM_SLOTS];
+	uint32_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+	if (before & 1u) {
+		return 0;
+	}
+	memcpy(out, slot, sizeof(*out));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	uint32_t after = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+	return before == after && out->frame_number == frame_number;
+}
+
+/* Copy the newest frame. Returns 0 if nothing was published yet or the
+ * writer lapped the reader during the copy; retry at the next poll. */
+static inline int apriltag_shm_read_latest(const apriltag_shm_segment *seg, apriltag_shm_frame *out) {
+	uint64_t latest = __atomic_load_n(&seg->latest, __ATOMIC_ACQUIRE);
+	return latest != 0 && apriltag_shm_read_frame(seg, latest, out);
+}
+
+#endif
@@ -0,0 +1,375 @@
+#include "batch_pose.h"
+#include "simd_float.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+struct LanePose {
+	vfloat r[9]; // Row-major rotation
+	vfloat t[3];
+	vfloat error;
+};
+
+// Model corners of a square of half side h, matching estimatePoseSingleMarkers
+static const float MODEL_X[4] = { -1.0f, 1.0f, 1.0f, -1.0f };
+static const float MODEL_Y[4] = { 1.0f, 1.0f, -1.0f, -1.0f };
+
+// Least-squares translation for a known rotation: each corner gives
+// tx - u*tz = u*(r2.X) - r0.X and ty - v*tz = v*(r2.X) - r1.X
+void solve_translation(const vfloat *u, const vfloat *v, vfloat h, LanePose &pose) {
+	const vfloat *r = pose.r;
+	vfloat su = {}, sv = {}, suv = {}, sbx = {}, sby = {}, sub = {};
+	for (int k = 0; k < 4; k++) {
+		vfloat x = h * MODEL_X[k];
+		vfloat y = h * MODEL_Y[k];
+		vfloat rx = r[0] * x + r[1] * y;
+		vfloat ry = r[3] * x + r[4] * y;
+		vfloat rz = r[6] * x + r[7] * y;
+		vfloat bx = u[k] * rz - rx;
+		vfloat by = v[k] * rz - ry;
+		su += u[k];
+		sv += v[k];
+		suv += u[k] * u[k] + v[k] * v[k];
+		sbx += bx;
+		sby += by;
+		sub += u[k] * bx + v[k] * by;
+	}
+	vfloat tz = (-sub + (su * sbx + sv * sby) * 0.25f) / (suv - (su * su + sv * sv) * 0.25f);
+	pose.t[0] = (sbx + su * tz) * 0.25f;
+	pose.t[1] = (sby + sv * tz) * 0.25f;
+	pose.t[2] = tz;
+}
+
+vfloat reprojection_error(const vfloat *u, const vfloat *v, vfloat h, const LanePose &pose) {
+	const vfloat *r = pose.r;
+	vfloat total = {};
+	for (int k = 0; k < 4; k++) {
+		vfloat x = h * MODEL_X[k];
+		vfloat y = h * MODEL_Y[k];
+		vfloat iz = 1.0f / (r[6] * x + r[7] * y + pose.t[2]);
+		vfloat du = (r[0] * x + r[1] * y + pose.t[0]) * iz - u[k];
+		vfloat dv = (r[3] * x + r[4] * y + pose.t[1]) * iz - v[k];
+		total += du * du + dv * dv;
+	}
+	return total;
+}
+
+// IPPE for a square: both rotations from the homography's Jacobian at the
+// marker centre, translations by least squares
+void solve_ippe(const vfloat *u, const vfloat *v, vfloat h, LanePose *out) {
+	// Homography from the unit square to the quad (Heckbert), corner k at
+	// (0,0), (1,0), (1,1), (0,1)
+	vfloat sx = u[0] - u[1] + u[2] - u[3];
+	vfloat sy = v[0] - v[1] + v[2] - v[3];
+	vfloat dx1 = u[1] - u[2];
+	vfloat dx2 = u[3] - u[2];
+	vfloat dy1 = v[1] - v[2];
+	vfloat dy2 = v[3] - v[2];
+	vfloat det = dx1 * dy2 - dx2 * dy1;
+	vfloat g = (sx * dy2 - dx2 * sy) / det;
+	vfloat hh = (dx1 * sy - sx * dy1) / det;
+	vfloat a = u[1] - u[0] + g * u[1];
+	vfloat b = u[3] - u[0] + hh * u[3];
+	vfloat d = v[1] - v[0] + g * v[1];
+	vfloat e = v[3] - v[0] + hh * v[3];
+
+	// Image of the marker centre and the Jacobian there, in model units
+	// (unit square u = (x + h) / 2h, v = (h - y) / 2h)
+	vfloat iw = 1.0f / (0.5f * g + 0.5f * hh + 1.0f);
+	vfloat p = (0.5f * a + 0.5f * b + u[0]) * iw;
+	vfloat q = (0.5f * d + 0.5f * e + v[0]) * iw;
+	vfloat k = 0.5f / h;
+	vfloat j00 = (a - g * p) * iw * k;
+	vfloat j01 = -(b - hh * p) * iw * k;
+	vfloat j10 = (d - g * q) * iw * k;
+	vfloat j11 = -(e - hh * q) * iw * k;
+
+	// Rotation taking the viewing ray (p, q, 1) onto the z axis, transposed
+	vfloat inv_norm = 1.0f / v_sqrt(p * p + q * q + 1.0f);
+	vfloat ax = p * inv_norm;
+	vfloat ay = q * inv_norm;
+	vfloat c = 1.0f / (1.0f + inv_norm);
+	vfloat rv00 = 1.0f - ax * ax * c;
+	vfloat rv01 = -ax * ay * c;
+	vfloat rv02 = ax;
+	vfloat rv10 = rv01;
+	vfloat rv11 = 1.0f - ay * ay * c;
+	vfloat rv12 = ay;
+	vfloat rv20 = -ax;
+	vfloat rv21 = -ay;
+	vfloat rv22 = 1.0f - (ax * ax + ay * ay) * c;
+
+	vfloat b00 = rv00 - p * rv20;
+	vfloat b01 = rv01 - p * rv21;
+	vfloat b10 = rv10 - q * rv20;
+	vfloat b11 = rv11 - q * rv21;
+	vfloat inv_det = 1.0f / (b00 * b11 - b01 * b10);
+	vfloat a00 = inv_det * (b11 * j00 - b01 * j10);
+	vfloat a01 = inv_det * (b11 * j01 - b01 * j11);
+	vfloat a10 = inv_det * (b00 * j10 - b10 * j00);
+	vfloat a11 = inv_det * (b00 * j11 - b10 * j01);
+
+	// Largest singular value of A
+	vfloat ata00 = a00 * a00 + a01 * a01;
+	vfloat ata01 = a00 * a10 + a01 * a11;
+	vfloat ata11 = a10 * a10 + a11 * a11;
+	vfloat diff = ata00 - ata11;
+	vfloat gamma = v_sqrt(0.5f * (ata00 + ata11 + v_sqrt(diff * diff + 4.0f * ata01 * ata01)));
+	vfloat inv_gamma = 1.0f / gamma;
+
+	vfloat rt00 = a00 * inv_gamma;
+	vfloat rt01 = a01 * inv_gamma;
+	vfloat rt10 = a10 * inv_gamma;
+	vfloat rt11 = a11 * inv_gamma;
+	vfloat zero = {};
+	vfloat b0 = v_sqrt(v_max(zero, 1.0f - rt00 * rt00 - rt10 * rt10));
+	vfloat b1 = v_sqrt(v_max(zero, 1.0f - rt01 * rt01 - rt11 * rt11));
+	b1 = (-rt00 * rt01 - rt10 * rt11) < zero ? -b1 : b1;
+
+	// The two solutions differ in the sign of the out-of-plane components;
+	// column 2 is the cross product of columns 0 and 1
+	for (int s = 0; s < 2; s++) {
+		vfloat m20 = s == 0 ? b0 : -b0;
+		vfloat m21 = s == 0 ? b1 : -b1;
+		vfloat m02 = rt10 * m21 - m20 * rt11;
+		vfloat m12 = m20 * rt01 - rt00 * m21;
+		vfloat m22 = rt00 * rt11 - rt01 * rt10;
+
+		vfloat *r = out[s].r;
+		r[0] = rv00 * rt00 + rv01 * rt10 + rv02 * m20;
+		r[1] = rv00 * rt01 + rv01 * rt11 + rv02 * m21;
+		r[2] = rv00 * m02 + rv01 * m12 + rv02 * m22;
+		r[3] = rv10 * rt00 + rv11 * rt10 + rv12 * m20;
+		r[4] = rv10 * rt01 + rv11 * rt11 + rv12 * m21;
+		r[5] = rv10 * m02 + rv11 * m12 + rv12 * m22;
+		r[6] = rv20 * rt00 + rv21 * rt10 + rv22 * m20;
+		r[7] = rv20 * rt01 + rv21 * rt11 + rv22 * m21;
+		r[8] = rv20 * m02 + rv21 * m12 + rv22 * m22;
+
+		solve_translation(u, v, h, out[s]);
+		out[s].error = reprojection_error(u, v, h, out[s]);
+	}
+}
+
+// Gauss-Newton on the reprojection error. Rotation updates are applied on the
+// left through the Cayley map, which needs no trigonometry and stays
+// branch-free across lanes.
+void refine(const vfloat *u, const vfloat *v, vfloat h, LanePose &pose, int iterations) {
+	for (int it = 0; it < iterations; it++) {
+		vfloat jtj[6][6] = {};
+		vfloat jtr[6] = {};
+		const vfloat *r = pose.r;
+
+		for (int k = 0; k < 4; k++) {
+			vfloat x = h * MODEL_X[k];
+			vfloat y = h * MODEL_Y[k];
+			vfloat qx = r[0] * x + r[1] * y;
+			vfloat qy = r[3] * x + r[4] * y;
+			vfloat qz = r[6] * x + r[7] * y;
+			vfloat cx = qx + pose.t[0];
+			vfloat cy = qy + pose.t[1];
+			vfloat iz = 1.0f / (qz + pose.t[2]);
+			vfloat pu = cx * iz;
+			vfloat pv = cy * iz;
+			vfloat iz2u = pu * iz;
+			vfloat iz2v = pv * iz;
+
+			// d(residual)/d(omega, t) for the u and v rows
+			vfloat ju[6] = { -iz2u * qy, iz * qz + iz2u * qx, -iz * qy, iz, {}, -iz2u };
+			vfloat jv[6] = { -iz * qz - iz2v * qy, iz2v * qx, iz * qx, {}, iz, -iz2v };
+			vfloat ru = pu - u[k];
+			vfloat rv = pv - v[k];
+
+			for (int i = 0; i < 6; i++) {
+				jtr[i] += ju[i] * ru + jv[i] * rv;
+				for (int j = 0; j <= i; j++) {
+					jtj[i][j] += ju[i] * ju[j] + jv[i] * jv[j];
+				}
+			}
+		}
+
+		// Cholesky solve of JtJ * delta = -Jtr, lightly damped
+		vfloat l[6][6] = {};
+		for (int i = 0; i < 6; i++) {
+			for (int j = 0; j <= i; j++) {
+				vfloat sum = jtj[i][j];
+				for (int m = 0; m < j; m++) {
+					sum -= l[i][m] * l[j][m];
+				}
+				if (i == j) {
+					l[i][i] = v_sqrt(v_max(sum + sum * 1e-6f, v_set(1e-12f)));
+				} else {
+					l[i][j] = sum / l[j][j];
+				}
+			}
+		}
+		vfloat z[6];
+		for (int i = 0; i < 6; i++) {
+			vfloat sum = -jtr[i];
+			for (int m = 0; m < i; m++) {
+				sum -= l[i][m] * z[m];
+			}
+			z[i] = sum / l[i][i];
+		}
+		vfloat delta[6];
+		for (int i = 5; i >= 0; i--) {
+			vfloat sum = z[i];
+			for (int m = i + 1; m < 6; m++) {
+				sum -= l[m][i] * delta[m];
+			}
+			delta[i] = sum / l[i][i];
+		}
+
+		// R <- cayley(omega) * R with c = omega / 2:
+		// cayley = I + 2/(1 + c.c) * ([c]x + c c^T - (c.c) I)
+		vfloat cx = delta[0] * 0.5f;
+		vfloat cy = delta[1] * 0.5f;
+		vfloat cz = delta[2] * 0.5f;
+		vfloat cc = cx * cx + cy * cy + cz * cz;
+		vfloat s = 2.0f / (1.0f + cc);
+		vfloat d[9] = {
+			1.0f + s * (cx * cx - cc), s * (cx * cy - cz), s * (cx * cz + cy),
+			s * (cx * cy + cz), 1.0f + s * (cy * cy - cc), s * (cy * cz - cx),
+			s * (cx * cz - cy), s * (cy * cz + cx), 1.0f + s * (cz * cz - cc)
+		};
+		vfloat updated[9];
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				updated[i * 3 + j] = d[i * 3] * r[j] + d[i * 3 + 1] * r[3 + j] + d[i * 3 + 2] * r[6 + j];
+			}
+		}
+		for (int i = 0; i < 9; i++) {
+			pose.r[i] = updated[i];
+		}
+		pose.t[0] += delta[3];
+		pose.t[1] += delta[4];
+		pose.t[2] += delta[5];
+	}
+	pose.error = reprojection_error(u, v, h, pose);
+}
+
+} // namespace
+
+void BatchPoseSolver::clear() {
+	count = 0;
+	for (int k = 0; k < 4; k++) {
+		corner_x[k].clear();
+		corner_y[k].clear();
+	}
+	half_size.clear();
+}
+
+void BatchPoseSolver::add(const cv::Point2f *normalized, float marker_size) {
+	for (int k = 0; k < 4; k++) {
+		corner_x[k].push_back(normalized[k].x);
+		corner_y[k].push_back(normalized[k].y);
+	}
+	half_size.push_back(marker_size * 0.5f);
+	count++;
+}
+
+void BatchPoseSolver::solve(int refine_iterations) {
+	// Pad to whole lanes with a well-conditioned square so spare lanes stay finite
+	const size_t padded = (count + VFLOAT_LANES - 1) / VFLOAT_LANES * VFLOAT_LANES;
+	for (int k = 0; k < 4; k++) {
+		corner_x[k].resize(padded, MODEL_X[k] * 0.05f);
+		corner_y[k].resize(padded, -MODEL_Y[k] * 0.05f);
+	}
+	half_size.resize(padded, 0.05f);
+	for (int s = 0; s < 2; s++) {
+		for (auto &column : rotation[s]) {
+			column.resize(padded);
+		}
+		for (auto &column : translation[s]) {
+			column.resize(padded);
+		}
+		error[s].resize(padded);
+	}
+
+	for (size_t first = 0; first < padded; first += VFLOAT_LANES) {
+		solve_lanes(first, refine_iterations);
+	}
+
+	// Drop the padding again so add() keeps appending in place
+	for (int k = 0; k < 4; k++) {
+		corner_x[k].resize(count);
+		corner_y[k].resize(count);
+	}
+	half_size.resize(count);
+}
+
+void BatchPoseSolver::solve_lanes(size_t first, int refine_iterations) {
+	vfloat u[4], v[4];
+	for (int k = 0; k < 4; k++) {
+		u[k] = v_load(&corner_x[k][first]);
+		v[k] = v_load(&corner_y[k][first]);
+	}
+	vfloat h = v_load(&half_size[first]);
+
+	LanePose poses[2];
+	solve_ippe(u, v, h, poses);
+	if (refine_iterations > 0) {
+		refine(u, v, h, poses[0], refine_iterations);
+		refine(u, v, h, poses[1], refine_iterations);
+	}
+
+	// Per lane, solution 0 is the better one
+	vmask swap = poses[1].error < poses[0].error;
+	for (int s = 0; s < 2; s++) {
+		const LanePose &primary = poses[s];
+		const LanePose &other = poses[1 - s];
+		for (int i = 0; i < 9; i++) {
+			v_store(&rotation[s][i][first], swap ? other.r[i] : primary.r[i]);
+		}
+		for (int i = 0; i < 3; i++) {
+			v_store(&translation[s][i][first], swap ? other.t[i] : primary.t[i]);
+		}
+		v_store(&error[s][first], swap ? other.error : primary.error);
+	}
+}
+
+void BatchPoseSolver::rotation_to_rvec(const float *r, cv::Vec3d &rvec) {
+	double cos_theta = std::max(-1.0, std::min(1.0, (r[0] + r[4] + r[8] - 1.0) * 0.5));
+	double theta = std::acos(cos_theta);
+	double x = r[7] - r[5];
+	double y = r[2] - r[6];
+	double z = r[3] - r[1];
+	double sin2 = std::sqrt(x * x + y * y + z * z); // 2 sin(theta)
+
+	if (sin2 > 1e-5) {
+		double scale = theta / sin2;
+		rvec = cv::Vec3d(x * scale, y * scale, z * scale);
+	} else if (cos_theta > 0.0) {
+		rvec = cv::Vec3d(x * 0.5, y * 0.5, z * 0.5);
+	} else {
+		// Half turn: axis from the diagonal, signs from the off-diagonal terms
+		double ax = std::sqrt(std::max(0.0, (r[0] + 1.0) * 0.5));
+		double ay = std::sqrt(std::max(0.0, (r[4] + 1.0) * 0.5));
+		double az = std::sqrt(std::max(0.0, (r[8] + 1.0) * 0.5));
+		if (ax >= ay && ax >= az) {
+			ay = r[1] < 0.0 ? -ay : ay;
+			az = r[2] < 0.0 ? -az : az;
+		} else if (ay >= az) {
+			ax = r[1] < 0.0 ? -ax : ax;
+			az = r[5] < 0.0 ? -az : az;
+		} else {
+			ax = r[2] < 0.0 ? -ax : ax;
+			ay = r[5] < 0.0 ? -ay : ay;
+		}
+		rvec = cv::Vec3d(ax * theta, ay * theta, az * theta);
+	}
+}
+
+void BatchPoseSolver::get_pose(size_t index, int solution, cv::Vec3d &rvec, cv::Vec3d &tvec) const {
+	float r[9];
+	for (int i = 0; i < 9; i++) {
+		r[i] = rotation[solution][i][index];
+	}
+	rotation_to_rvec(r, rvec);
+	tvec = cv::Vec3d(translation[solution][0][index], translation[solution][1][index], translation[solution][2][index]);
+}
+
+float BatchPoseSolver::get_error(size_t index, int solution) const {
+	return error[solution][index];
+}
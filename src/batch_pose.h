@@ -0,0 +1,47 @@
+#ifndef BATCH_POSE_H
+#define BATCH_POSE_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Pose of many square markers at once, solved in float32 across SIMD lanes.
+//
+// Each marker is solved with IPPE for a known square (Collins & Bartoli),
+// which yields both planar pose solutions in closed form, followed by an
+// optional Gauss-Newton refinement of the reprojection error. Inputs are the
+// undistorted, normalised corners of every marker in structure-of-arrays
+// layout, so one cv::undistortPoints call can serve the whole frame and each
+// SIMD lane handles a different marker.
+class BatchPoseSolver {
+public:
+	void clear();
+
+	// Corners are normalised image coordinates (x/z, y/z) in ArUco order:
+	// top-left, top-right, bottom-right, bottom-left
+	void add(const cv::Point2f *normalized, float marker_size);
+	size_t size() const { return count; }
+
+	void solve(int refine_iterations);
+
+	// Solution 0 has the lower reprojection error, solution 1 is the mirrored
+	// IPPE alternative
+	void get_pose(size_t index, int solution, cv::Vec3d &rvec, cv::Vec3d &tvec) const;
+	// Sum of squared reprojection errors over the four corners, normalised units
+	float get_error(size_t index, int solution) const;
+
+	static void rotation_to_rvec(const float *rotation, cv::Vec3d &rvec);
+
+private:
+	void solve_lanes(size_t first, int refine_iterations);
+
+	size_t count = 0;
+	std::vector<float> corner_x[4];
+	std::vector<float> corner_y[4];
+	std::vector<float> half_size;
+
+	std::vector<float> rotation[2][9]; // Row-major
+	std::vector<float> translation[2][3];
+	std::vector<float> error[2];
+};
+
+#endif
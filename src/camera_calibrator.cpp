@@ -0,0 +1,256 @@
+#include "camera_calibrator.h"
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Fewer points than this constrain a view too weakly to keep
+const int MIN_CHARUCO_CORNERS = 8;
+const int MIN_GRID_MARKERS = 4;
+
+double distance(const cv::Point2f &a, const cv::Point2f &b) {
+	return std::hypot(a.x - b.x, a.y - b.y);
+}
+
+}
+
+CameraCalibrator::~CameraCalibrator() {
+	stop();
+}
+
+void CameraCalibrator::set_charuco_board(int squares_x, int squares_y, float square_length, float marker_length, const cv::aruco::Dictionary &dictionary) {
+	if (running) {
+		return;
+	}
+	board_type = BOARD_CHARUCO;
+	charuco_board = std::make_unique<cv::aruco::CharucoBoard>(cv::Size(squares_x, squares_y), square_length, marker_length, dictionary);
+	grid_board.reset();
+}
+
+void CameraCalibrator::set_aprilgrid_board(int columns, int rows, float tag_size, float tag_spacing, const cv::aruco::Dictionary &dictionary) {
+	if (running) {
+		return;
+	}
+	board_type = BOARD_APRILGRID;
+	grid_board = std::make_unique<cv::aruco::GridBoard>(cv::Size(columns, rows), tag_size, tag_size * tag_spacing, dictionary);
+	charuco_board.reset();
+}
+
+bool CameraCalibrator::start() {
+	if (running) {
+		return true;
+	}
+	if (!charuco_board && !grid_board) {
+		return false;
+	}
+
+	// Subpixel corners matter far more here than detection speed
+	cv::aruco::DetectorParameters params;
+	params.cornerRefinementMethod = cv::aruco::CORNER_REFINE_SUBPIX;
+	if (charuco_board) {
+		charuco_detector = std::make_unique<cv::aruco::CharucoDetector>(*charuco_board, cv::aruco::CharucoParameters(), params);
+	} else {
+		marker_detector = std::make_unique<cv::aruco::ArucoDetector>(grid_board->getDictionary(), params);
+	}
+
+	views.clear();
+	object_views.clear();
+	image_views.clear();
+	frame_size = cv::Size();
+	{
+		std::lock_guard<std::mutex> lock(result_mutex);
+		current = Result();
+	}
+	examined = board_frames = view_count = 0;
+	last_offer = std::chrono::steady_clock::time_point();
+	busy = false;
+
+	running = true;
+	worker = std::thread(&CameraCalibrator::run, this);
+	return true;
+}
+
+void CameraCalibrator::stop() {
+	if (!running) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		running = false;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+void CameraCalibrator::offer(const cv::Mat &frame) {
+	if (!running || busy.load(std::memory_order_acquire)) {
+		return;
+	}
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - last_offer < std::chrono::milliseconds(interval_ms)) {
+		return;
+	}
+	last_offer = now;
+
+	frame.copyTo(pending);
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		busy.store(true, std::memory_order_release);
+	}
+	wake.notify_one();
+}
+
+CameraCalibrator::Result CameraCalibrator::result() const {
+	std::lock_guard<std::mutex> lock(result_mutex);
+	Result copy = current;
+	copy.camera_matrix = current.camera_matrix.clone();
+	copy.dist_coeffs = current.dist_coeffs.clone();
+	return copy;
+}
+
+void CameraCalibrator::run() {
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(wake_mutex);
+			wake.wait(lock, [this]() { return !running || busy.load(std::memory_order_acquire); });
+			if (!running) {
+				return;
+			}
+		}
+		process(pending);
+		busy.store(false, std::memory_order_release);
+	}
+}
+
+void CameraCalibrator::process(const cv::Mat &gray) {
+	examined++;
+	if ((int)views.size() >= max_views) {
+		return;
+	}
+
+	// A resolution change invalidates every view
+	if (gray.size() != frame_size) {
+		views.clear();
+		object_views.clear();
+		image_views.clear();
+		frame_size = gray.size();
+		view_count = 0;
+	}
+
+	std::vector<cv::Point3f> object_points;
+	std::vector<cv::Point2f> image_points;
+	if (!find_board(gray, object_points, image_points)) {
+		return;
+	}
+	board_frames++;
+
+	View view;
+	describe(object_points, image_points, gray.size(), view);
+	for (const View &kept : views) {
+		double d2 = 0.0;
+		for (int i = 0; i < 5; i++) {
+			d2 += (view.descriptor[i] - kept.descriptor[i]) * (view.descriptor[i] - kept.descriptor[i]);
+		}
+		if (d2 < min_view_distance * min_view_distance) {
+			return;
+		}
+	}
+
+	views.push_back(view);
+	object_views.push_back(std::move(object_points));
+	image_views.push_back(std::move(image_points));
+	view_count = (int)views.size();
+	if ((int)views.size() >= min_views) {
+		calibrate();
+	}
+}
+
+bool CameraCalibrator::find_board(const cv::Mat &gray, std::vector<cv::Point3f> &object_points, std::vector<cv::Point2f> &image_points) {
+	if (charuco_detector) {
+		std::vector<cv::Point2f> corners;
+		std::vector<int> ids;
+		charuco_detector->detectBoard(gray, corners, ids);
+		if ((int)ids.size() < MIN_CHARUCO_CORNERS) {
+			return false;
+		}
+		charuco_board->matchImagePoints(corners, ids, object_points, image_points);
+	} else {
+		std::vector<std::vector<cv::Point2f>> corners;
+		std::vector<int> ids;
+		marker_detector->detectMarkers(gray, corners, ids);
+		if ((int)ids.size() < MIN_GRID_MARKERS) {
+			return false;
+		}
+		grid_board->matchImagePoints(corners, ids, object_points, image_points);
+	}
+	return image_points.size() >= 4;
+}
+
+// Where the board's outline lands in the image: centre, apparent size and
+// the foreshortening of opposite edges, all relative to the image
+void CameraCalibrator::describe(const std::vector<cv::Point3f> &object_points, const std::vector<cv::Point2f> &image_points,
+		const cv::Size &size, View &view) const {
+	float min_x = object_points[0].x, max_x = min_x, min_y = object_points[0].y, max_y = min_y;
+	std::vector<cv::Point2f> board(object_points.size());
+	for (size_t i = 0; i < object_points.size(); i++) {
+		board[i] = cv::Point2f(object_points[i].x, object_points[i].y);
+		min_x = std::min(min_x, board[i].x);
+		max_x = std::max(max_x, board[i].x);
+		min_y = std::min(min_y, board[i].y);
+		max_y = std::max(max_y, board[i].y);
+	}
+	cv::Mat homography = cv::findHomography(board, image_points);
+	std::vector<cv::Point2f> outline = {
+		{ min_x, min_y }, { max_x, min_y }, { max_x, max_y }, { min_x, max_y }
+	};
+	std::vector<cv::Point2f> quad;
+	if (homography.empty()) {
+		cv::Rect box = cv::boundingRect(image_points);
+		quad = { cv::Point2f(box.x, box.y), cv::Point2f(box.x + box.width, box.y),
+			cv::Point2f(box.x + box.width, box.y + box.height), cv::Point2f(box.x, box.y + box.height) };
+	} else {
+		cv::perspectiveTransform(outline, quad, homography);
+	}
+
+	double width = size.width, height = size.height;
+	cv::Point2f centre = (quad[0] + quad[1] + quad[2] + quad[3]) * 0.25f;
+	double top = distance(quad[0], quad[1]), bottom = distance(quad[3], quad[2]);
+	double left = distance(quad[0], quad[3]), right = distance(quad[1], quad[2]);
+	view.descriptor[0] = centre.x / width;
+	view.descriptor[1] = centre.y / height;
+	view.descriptor[2] = std::sqrt(std::abs(cv::contourArea(quad)) / (width * height));
+	view.descriptor[3] = (right - left) / std::max(1e-6, right + left);
+	view.descriptor[4] = (bottom - top) / std::max(1e-6, bottom + top);
+}
+
+void CameraCalibrator::calibrate() {
+	cv::Mat camera_matrix, dist_coeffs;
+	int flags = cv::CALIB_FIX_K3;
+	{
+		std::lock_guard<std::mutex> lock(result_mutex);
+		if (current.calibrated && current.frame_size == frame_size) {
+			// Each run starts from the last estimate and converges in a few iterations
+			camera_matrix = current.camera_matrix.clone();
+			dist_coeffs = current.dist_coeffs.clone();
+			flags |= cv::CALIB_USE_INTRINSIC_GUESS;
+		}
+	}
+
+	std::vector<cv::Mat> rvecs, tvecs;
+	double rms;
+	try {
+		rms = cv::calibrateCamera(object_views, image_views, frame_size, camera_matrix, dist_coeffs, rvecs, tvecs, flags);
+	} catch (const cv::Exception &) {
+		return; // Degenerate set so far; the next view may fix it
+	}
+
+	std::lock_guard<std::mutex> lock(result_mutex);
+	current.calibrated = true;
+	current.rms = rms;
+	current.camera_matrix = camera_matrix;
+	current.dist_coeffs = dist_coeffs.reshape(1, (int)dist_coeffs.total()).rowRange(0, 4).clone();
+	current.frame_size = frame_size;
+	current.views = (int)views.size();
+}
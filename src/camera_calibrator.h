@@ -0,0 +1,110 @@
+#ifndef CAMERA_CALIBRATOR_H
+#define CAMERA_CALIBRATOR_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Calibrates the camera from the live stream. The capture thread offers
+// frames; one is copied only when the calibration thread is idle and the
+// last copy is at least `interval` old, so capture never waits. The
+// calibration thread finds the board, keeps the view only if it differs
+// enough from the views kept so far (position, size and tilt in the image),
+// and reruns calibrateCamera from the previous estimate after each new view.
+//
+// The lens model is the 4-coefficient pinhole one (k1 k2 p1 p2).
+class CameraCalibrator {
+public:
+	enum BoardType {
+		BOARD_CHARUCO,
+		BOARD_APRILGRID,
+	};
+
+	struct Result {
+		bool calibrated;
+		double rms; // Reprojection error in pixels
+		cv::Mat camera_matrix;
+		cv::Mat dist_coeffs; // 4x1
+		cv::Size frame_size;
+		int views;
+	};
+
+	~CameraCalibrator();
+
+	// Squares of `square_length`, markers of `marker_length` (same unit as the poses)
+	void set_charuco_board(int squares_x, int squares_y, float square_length, float marker_length, const cv::aruco::Dictionary &dictionary);
+	// Kalibr-style grid: tags of `tag_size`, gaps of `tag_spacing` * tag_size
+	void set_aprilgrid_board(int columns, int rows, float tag_size, float tag_spacing, const cv::aruco::Dictionary &dictionary);
+	BoardType get_board_type() const { return board_type; }
+
+	// Views closer than this to a kept view are skipped (descriptor units,
+	// roughly a fraction of the image)
+	void set_min_view_distance(double distance) { min_view_distance = distance; }
+	double get_min_view_distance() const { return min_view_distance; }
+	void set_min_views(int views) { min_views = views; }
+	void set_max_views(int views) { max_views = views; }
+	void set_interval_ms(int interval) { interval_ms = interval; }
+
+	bool start();
+	void stop();
+	bool is_running() const { return running; }
+
+	// Capture thread; returns at once
+	void offer(const cv::Mat &frame);
+
+	Result result() const;
+	int get_examined_frames() const { return examined; }
+	int get_board_frames() const { return board_frames; }
+	int get_view_count() const { return view_count; }
+
+private:
+	struct View {
+		double descriptor[5]; // Centre x, y, size, tilt x, y
+	};
+
+	void run();
+	void process(const cv::Mat &gray);
+	bool find_board(const cv::Mat &gray, std::vector<cv::Point3f> &object_points, std::vector<cv::Point2f> &image_points);
+	void describe(const std::vector<cv::Point3f> &object_points, const std::vector<cv::Point2f> &image_points,
+		const cv::Size &size, View &view) const;
+	void calibrate();
+
+	BoardType board_type = BOARD_CHARUCO;
+	std::unique_ptr<cv::aruco::CharucoBoard> charuco_board;
+	std::unique_ptr<cv::aruco::GridBoard> grid_board;
+	std::unique_ptr<cv::aruco::CharucoDetector> charuco_detector;
+	std::unique_ptr<cv::aruco::ArucoDetector> marker_detector;
+
+	double min_view_distance = 0.15;
+	int min_views = 8;
+	int max_views = 40;
+	int interval_ms = 200;
+
+	std::atomic<bool> running{false};
+	std::atomic<bool> busy{false}; // `pending` belongs to the calibration thread while set
+	cv::Mat pending;
+	std::chrono::steady_clock::time_point last_offer;
+	std::thread worker;
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+
+	// Calibration thread only
+	std::vector<View> views;
+	std::vector<std::vector<cv::Point3f>> object_views;
+	std::vector<std::vector<cv::Point2f>> image_views;
+	cv::Size frame_size;
+
+	mutable std::mutex result_mutex;
+	Result current = {};
+	std::atomic<int> examined{0};
+	std::atomic<int> board_frames{0};
+	std::atomic<int> view_count{0};
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "code_table.h"
+#include <algorithm>
+
+static constexpr int CODE_BITS = 49;
+static constexpr uint64_t CODE_MASK = (uint64_t(1) << CODE_BITS) - 1;
+static constexpr int ID_SHIFT = 49;
+static constexpr uint64_t ID_MASK = 0x3FF;
+static constexpr int ROTATION_SHIFT = 59;
+static constexpr int HAMMING_SHIFT = 61;
+static constexpr uint64_t OCCUPIED = uint64_t(1) << 63;
+
+// Source cell read at (row, col) for a code rotated `rotation` quarter turns,
+// matching the byte streams of cv::aruco::Dictionary::getByteListFromBits
+static constexpr int rotated_source(int n, int rotation, int row, int col) {
+	switch (rotation) {
+		case 1:
+			return col * n + (n - 1 - row);
+		case 2:
+			return (n - 1 - row) * n + (n - 1 - col);
+		case 3:
+			return (n - 1 - col) * n + row;
+		default:
+			return row * n + col;
+	}
+}
+
+// Rotation r applied to rotation 1 must land on rotation r + 1
+static constexpr bool rotations_compose(int n) {
+	for (int r = 0; r < 3; r++) {
+		for (int i = 0; i < n * n; i++) {
+			int once = rotated_source(n, 1, i / n, i % n);
+			if (rotated_source(n, r, once / n, once % n) != rotated_source(n, r + 1, i / n, i % n)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+static_assert(rotations_compose(4) && rotations_compose(5) && rotations_compose(6), "rotation map is inconsistent");
+
+static inline size_t hash_slot(uint64_t code, int shift) {
+	return (size_t)((code * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+uint64_t CodeTable::code_from_bits(const cv::Mat &bits) {
+	uint64_t code = 0;
+	for (int y = 0; y < bits.rows; y++) {
+		for (int x = 0; x < bits.cols; x++) {
+			code = (code << 1) | (bits.at<uint8_t>(y, x) & 1);
+		}
+	}
+	return code;
+}
+
+void CodeTable::build(const cv::aruco::Dictionary &dict, int max_hamming) {
+	slots.clear();
+	entries = 0;
+
+	const int n = dict.markerSize;
+	const int bits = n * n;
+	const int ids = dict.bytesList.rows;
+	if (bits > CODE_BITS || ids > (int)ID_MASK + 1) {
+		return;
+	}
+
+	const int radius = std::max(0, std::min(max_hamming, MAX_HAMMING));
+	size_t patterns = 1;
+	if (radius >= 1) {
+		patterns += bits;
+	}
+	if (radius >= 2) {
+		patterns += (size_t)bits * (bits - 1) / 2;
+	}
+
+	// Keep the load factor at or below 3/4
+	const size_t expected = (size_t)ids * 4 * patterns;
+	size_t size = 16;
+	int log2_size = 4;
+	while (size * 3 < expected * 4) {
+		size <<= 1;
+		log2_size++;
+	}
+	slots.assign(size, 0);
+	mask = size - 1;
+	shift = 64 - log2_size;
+
+	std::vector<uint8_t> cells(bits);
+	for (int id = 0; id < ids; id++) {
+		cv::Mat marker_bits = cv::aruco::Dictionary::getBitsFromByteList(dict.bytesList.rowRange(id, id + 1), n);
+		for (int i = 0; i < bits; i++) {
+			cells[i] = marker_bits.at<uint8_t>(i / n, i % n);
+		}
+
+		for (int rotation = 0; rotation < 4; rotation++) {
+			uint64_t code = 0;
+			for (int i = 0; i < bits; i++) {
+				code = (code << 1) | cells[rotated_source(n, rotation, i / n, i % n)];
+			}
+
+			insert(code, id, rotation, 0);
+			for (int a = 0; a < bits && radius >= 1; a++) {
+				const uint64_t one = code ^ (uint64_t(1) << a);
+				insert(one, id, rotation, 1);
+				for (int b = a + 1; b < bits && radius >= 2; b++) {
+					insert(one ^ (uint64_t(1) << b), id, rotation, 2);
+				}
+			}
+		}
+	}
+}
+
+void CodeTable::insert(uint64_t code, int id, int rotation, int hamming) {
+	const uint64_t packed = OCCUPIED | ((uint64_t)hamming << HAMMING_SHIFT) | ((uint64_t)rotation << ROTATION_SHIFT) |
+			((uint64_t)id << ID_SHIFT) | code;
+
+	size_t i = hash_slot(code, shift);
+	while (slots[i] & OCCUPIED) {
+		if ((slots[i] & CODE_MASK) == code) {
+			// Pattern reachable from two codes: keep the closer one
+			if (hamming < (int)((slots[i] >> HAMMING_SHIFT) & 3)) {
+				slots[i] = packed;
+			}
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+	slots[i] = packed;
+	entries++;
+}
+
+bool CodeTable::lookup(uint64_t code, int &id, int &rotation, int &hamming) const {
+	if (slots.empty() || code > CODE_MASK) {
+		return false;
+	}
+
+	size_t i = hash_slot(code, shift);
+	while (slots[i] & OCCUPIED) {
+		const uint64_t slot = slots[i];
+		if ((slot & CODE_MASK) == code) {
+			id = (int)((slot >> ID_SHIFT) & ID_MASK);
+			rotation = (int)((slot >> ROTATION_SHIFT) & 3);
+			hamming = (int)((slot >> HAMMING_SHIFT) & 3);
+			return true;
+		}
+		i = (i + 1) & mask;
+	}
+	return false;
+}
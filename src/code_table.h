@@ -0,0 +1,43 @@
+#ifndef CODE_TABLE_H
+#define CODE_TABLE_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+#include <cstdint>
+#include <vector>
+
+// Rotation-aware decode table for a marker dictionary.
+//
+// Every code of the dictionary, in each of its four rotations, is expanded to
+// all bit patterns within `max_hamming` flips and stored in one open-addressing
+// hash table. Decoding a candidate is then a single lookup whose cost does not
+// depend on the dictionary size, instead of a Hamming scan over every code.
+// Rotations follow cv::aruco::Dictionary::identify, so corner reordering works
+// the same way for both paths.
+class CodeTable {
+public:
+	// Largest supported radius; radius 3 on 36h11 would need ~18M entries
+	static constexpr int MAX_HAMMING = 2;
+
+	void build(const cv::aruco::Dictionary &dict, int max_hamming);
+	bool is_built() const { return !slots.empty(); }
+
+	// Pack a CV_8UC1 0/1 bit matrix row-major, first cell in the highest bit
+	static uint64_t code_from_bits(const cv::Mat &bits);
+
+	bool lookup(uint64_t code, int &id, int &rotation, int &hamming) const;
+
+	size_t entry_count() const { return entries; }
+
+private:
+	void insert(uint64_t code, int id, int rotation, int hamming);
+
+	// Slot layout: [0, 49) code, [49, 59) id, [59, 61) rotation, [61, 63) hamming,
+	// bit 63 occupied
+	std::vector<uint64_t> slots;
+	uint64_t mask = 0;
+	int shift = 64;
+	size_t entries = 0;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// RCU-style holder of an immutable configuration. Writers copy the current
+// value, change the copy and swap it in with one atomic store; the frame
+// thread picks up whichever value is current when its frame starts and
+// keeps it, unchanged, until the frame ends. Reading takes no lock and
+// never waits.
+//
+// Replaced values are freed by later writers, once the reader has finished
+// every frame that could still be using them (quiescent-state reclamation).
+// Only one thread reads through Reader at a time: the camera callback or the
+// replay delivery thread. Other threads read a copy().
+template <typename T>
+class ConfigSnapshot {
+public:
+	ConfigSnapshot() : current(new T()) {}
+	~ConfigSnapshot() {
+		delete current.load(std::memory_order_relaxed);
+		for (const Retired &retired : retired_values) {
+			delete retired.value;
+		}
+	}
+
+	// Frame thread: the value stays valid until the Reader goes away
+	class Reader {
+	public:
+		explicit Reader(ConfigSnapshot &snapshot) : owner(snapshot) {
+			owner.active.store(true, std::memory_order_seq_cst);
+			value = owner.current.load(std::memory_order_seq_cst);
+		}
+		~Reader() {
+			owner.epoch.fetch_add(1, std::memory_order_release);
+			owner.active.store(false, std::memory_order_release);
+		}
+		const T &operator*() const { return *value; }
+		const T *operator->() const { return value; }
+
+	private:
+		ConfigSnapshot &owner;
+		const T *value;
+	};
+
+	// Any thread
+	T copy() const {
+		std::lock_guard<std::mutex> lock(writer_mutex);
+		return *current.load(std::memory_order_relaxed);
+	}
+
+	// Copy, change through `edit`, publish. Returns false (and publishes
+	// nothing) if `edit` does
+	template <typename Edit>
+	bool update(Edit edit) {
+		std::lock_guard<std::mutex> lock(writer_mutex);
+		std::unique_ptr<T> next(new T(*current.load(std::memory_order_relaxed)));
+		if (!edit(*next)) {
+			return false;
+		}
+		T *previous = current.exchange(next.release(), std::memory_order_seq_cst);
+
+		// A frame that may hold `previous` has finished once the epoch moves
+		// past the value read here; an idle reader holds nothing
+		bool reading = active.load(std::memory_order_seq_cst);
+		uint64_t now = epoch.load(std::memory_order_acquire);
+		if (reading) {
+			retired_values.push_back({ previous, now });
+		} else {
+			delete previous;
+		}
+		reclaim(now, reading);
+		return true;
+	}
+
+private:
+	struct Retired {
+		T *value;
+		uint64_t epoch;
+	};
+
+	void reclaim(uint64_t now, bool reading) {
+		size_t kept = 0;
+		for (size_t i = 0; i < retired_values.size(); i++) {
+			if (!reading || retired_values[i].epoch < now) {
+				delete retired_values[i].value;
+			} else {
+				retired_values[kept++] = retired_values[i];
+			}
+		}
+		retired_values.resize(kept);
+	}
+
+	std::atomic<T *> current;
+	std::atomic<bool> active{false};
+	std::atomic<uint64_t> epoch{0};
+	mutable std::mutex writer_mutex;
+	std::vector<Retired> retired_values;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "contrast_normalizer.h"
+#include "simd_float.h"
+#include <algorithm>
+#include <cmath>
+
+// Output mid-grey and spread of one local standard deviation
+static const float TARGET_MEAN = 128.0f;
+static const float TARGET_STD = 48.0f;
+// Floor on the local deviation so flat regions are not amplified into noise
+static const float MIN_STD = 4.0f;
+
+void ContrastNormalizer::configure(const Settings &next) {
+	const int tile_grid = std::max(1, next.tile_grid);
+	if (next.clip_limit != settings.clip_limit || tile_grid != settings.tile_grid) {
+		clahe.release();
+	}
+	settings.mode = next.mode;
+	settings.clip_limit = next.clip_limit;
+	settings.tile_grid = tile_grid;
+	settings.window = std::max(3, next.window | 1);
+}
+
+const cv::Mat &ContrastNormalizer::apply(const cv::Mat &gray) {
+	switch (settings.mode) {
+		case MODE_CLAHE:
+			if (clahe.empty()) {
+				clahe = cv::createCLAHE(settings.clip_limit, cv::Size(settings.tile_grid, settings.tile_grid));
+			}
+			clahe->apply(gray, output);
+			return output;
+		case MODE_LOCAL_NORMALIZATION:
+			normalize_local(gray);
+			return output;
+		default:
+			return gray;
+	}
+}
+
+void ContrastNormalizer::normalize_local(const cv::Mat &gray) {
+	const cv::Size box(settings.window, settings.window);
+	gray.convertTo(pixels, CV_32F);
+	cv::multiply(pixels, pixels, squares);
+	cv::boxFilter(pixels, mean, CV_32F, box, cv::Point(-1, -1), true, cv::BORDER_REFLECT);
+	cv::boxFilter(squares, sq_mean, CV_32F, box, cv::Point(-1, -1), true, cv::BORDER_REFLECT);
+	normalized.create(gray.size(), CV_32F);
+
+	const vfloat v_target_mean = v_set(TARGET_MEAN);
+	const vfloat v_target_std = v_set(TARGET_STD);
+	const vfloat v_min_var = v_set(MIN_STD * MIN_STD);
+	const int cols = gray.cols;
+
+	for (int y = 0; y < gray.rows; y++) {
+		const float *p = pixels.ptr<float>(y);
+		const float *m = mean.ptr<float>(y);
+		const float *s = sq_mean.ptr<float>(y);
+		float *out = normalized.ptr<float>(y);
+
+		int x = 0;
+		for (; x + VFLOAT_LANES <= cols; x += VFLOAT_LANES) {
+			vfloat vm = v_load(m + x);
+			vfloat var = v_max(v_load(s + x) - vm * vm, v_min_var);
+			vfloat value = v_target_mean + (v_load(p + x) - vm) * v_target_std / v_sqrt(var);
+			v_store(out + x, value);
+		}
+		for (; x < cols; x++) {
+			float var = std::max(s[x] - m[x] * m[x], MIN_STD * MIN_STD);
+			out[x] = TARGET_MEAN + (p[x] - m[x]) * TARGET_STD / std::sqrt(var);
+		}
+	}
+
+	// Saturating conversion back to 8 bits
+	normalized.convertTo(output, CV_8U);
+}
@@ -0,0 +1,53 @@
+#ifndef CONTRAST_NORMALIZER_H
+#define CONTRAST_NORMALIZER_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+// Optional contrast normalisation ahead of detection, so short exposures
+// (dim, low-contrast frames) still threshold cleanly.
+//
+//   CLAHE:               OpenCV's tile-based contrast-limited equalisation
+//   local normalisation: (x - mean) / stddev over a box window, remapped to
+//                        a fixed mid-grey and spread, evaluated with float
+//                        SIMD lanes on top of box-filtered moments
+class ContrastNormalizer {
+public:
+	enum Mode {
+		MODE_NONE,
+		MODE_CLAHE,
+		MODE_LOCAL_NORMALIZATION
+	};
+
+	struct Settings {
+		Mode mode = MODE_NONE;
+		double clip_limit = 3.0;
+		int tile_grid = 8;
+		int window = 31; // Box window for the local moments, made odd and at least 3
+	};
+
+	// Called by the thread that calls apply(), before it; the CLAHE object is
+	// only rebuilt when its clip limit or tile grid changed
+	void configure(const Settings &next);
+	Mode get_mode() const { return settings.mode; }
+
+	// Returns `gray` itself for MODE_NONE, otherwise an internal buffer that
+	// stays valid until the next call. The input is never written, so frames
+	// mapped read-only from the camera can be passed directly.
+	const cv::Mat &apply(const cv::Mat &gray);
+
+private:
+	void normalize_local(const cv::Mat &gray);
+
+	Settings settings;
+	cv::Ptr<cv::CLAHE> clahe;
+
+	cv::Mat output;
+	cv::Mat pixels;    // CV_32F copy of the frame
+	cv::Mat squares;   // pixels^2
+	cv::Mat mean;      // Box means of pixels
+	cv::Mat sq_mean;   // Box means of squares
+	cv::Mat normalized;
+};
+
+#endif
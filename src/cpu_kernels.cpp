@@ -0,0 +1,96 @@
+#include "cpu_kernels.h"
+#include <cstdlib>
+#include <cstring>
+
+static void unpack_to_8bit_scalar(const uint16_t *src, uint8_t *dst, size_t count, int shift) {
+	const uint32_t half = 1u << (shift - 1);
+	for (size_t i = 0; i < count; i++) {
+		// Adding half - 1, plus 1 when the quotient is odd, rounds ties to even
+		uint32_t value = src[i];
+		uint32_t rounded = (value + half - 1 + ((value >> shift) & 1)) >> shift;
+		dst[i] = (uint8_t)(rounded > 255 ? 255 : rounded);
+	}
+}
+
+static void add_rows_scalar(uint32_t *out, const uint32_t *above, int count) {
+	for (int x = 0; x < count; x++) {
+		out[x] += above[x];
+	}
+}
+
+static void threshold_row_scalar(const uint8_t *src, const uint32_t *top, const uint32_t *bottom, uint8_t *dst,
+		int x_begin, int x_end, int radius, int area, int delta) {
+	for (int x = x_begin; x < x_end; x++) {
+		uint32_t sum = (bottom[x + radius + 1] - bottom[x - radius]) - (top[x + radius + 1] - top[x - radius]);
+		dst[x] = (int32_t)(src[x] + delta) * area <= (int32_t)sum ? 255 : 0;
+	}
+}
+
+const CpuKernels CPU_KERNELS_SCALAR = {
+	CPU_SCALAR, "scalar", unpack_to_8bit_scalar, add_rows_scalar, threshold_row_scalar
+};
+
+static bool cpu_has(CpuLevel level) {
+	switch (level) {
+		case CPU_SCALAR:
+			return true;
+#if defined(__aarch64__)
+		case CPU_NEON:
+			return true; // Advanced SIMD is mandatory on arm64
+#endif
+#if defined(__x86_64__)
+		case CPU_SSE41:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("sse4.1");
+		case CPU_AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return false;
+	}
+}
+
+const CpuKernels *cpu_kernels_for(CpuLevel level) {
+	if (!cpu_has(level)) {
+		return nullptr;
+	}
+	switch (level) {
+		case CPU_SCALAR:
+			return &CPU_KERNELS_SCALAR;
+#if defined(__aarch64__)
+		case CPU_NEON:
+			return &CPU_KERNELS_NEON;
+#endif
+#if defined(__x86_64__)
+		case CPU_SSE41:
+			return &CPU_KERNELS_SSE41;
+		case CPU_AVX2:
+			return &CPU_KERNELS_AVX2;
+#endif
+		default:
+			return nullptr;
+	}
+}
+
+// Levels are ordered by preference within each architecture
+static const CpuKernels &select_kernels() {
+	const char *cap = getenv("APRILTAG_CPU");
+	const CpuKernels *best = &CPU_KERNELS_SCALAR;
+	for (int level = 0; level < CPU_LEVEL_COUNT; level++) {
+		const CpuKernels *candidate = cpu_kernels_for((CpuLevel)level);
+		if (!candidate) {
+			continue;
+		}
+		best = candidate;
+		if (cap && strcmp(cap, candidate->name) == 0) {
+			break;
+		}
+	}
+	return *best;
+}
+
+const CpuKernels &cpu_kernels() {
+	static const CpuKernels &selected = select_kernels();
+	return selected;
+}
@@ -0,0 +1,60 @@
+#ifndef CPU_KERNELS_H
+#define CPU_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Hand-written per-pixel kernels, built for several instruction sets in one
+// binary: scalar and NEON on arm64, scalar, SSE4.1 and AVX2 on x86_64. The
+// best variant the CPU supports is picked once, on first use, so a single
+// .so per architecture runs its fastest path on a Pi 4, a Pi 5 or a
+// desktop. Every variant produces exactly the scalar result.
+//
+// APRILTAG_CPU=scalar|neon|sse4.1|avx2 in the environment caps the choice,
+// for comparing variants on one machine.
+
+enum CpuLevel {
+	CPU_SCALAR,
+	CPU_NEON,
+	CPU_SSE41,
+	CPU_AVX2,
+	CPU_LEVEL_COUNT
+};
+
+struct CpuKernels {
+	CpuLevel level;
+	const char *name;
+
+	// 16-bit samples to 8 bits: value / 2^shift rounded half to even and
+	// saturated, as cv::Mat::convertTo with scale 1 / 2^shift. shift is in
+	// [2, 8]: 8 for 16-bit samples, 2 for 10-bit ones
+	void (*unpack_to_8bit)(const uint16_t *src, uint8_t *dst, size_t count, int shift);
+
+	// out[x] += above[x] for x in [0, count): the vertical half of an
+	// integral image row
+	void (*add_rows)(uint32_t *out, const uint32_t *above, int count);
+
+	// Mean-C threshold of columns [x_begin, x_end), whose windows of
+	// 2 * radius + 1 columns lie inside the row: 255 where
+	// (src + delta) * area <= window sum, else 0. `top` and `bottom` are the
+	// integral rows above and below the window
+	void (*threshold_row)(const uint8_t *src, const uint32_t *top, const uint32_t *bottom, uint8_t *dst,
+		int x_begin, int x_end, int radius, int area, int delta);
+};
+
+// The variant in use
+const CpuKernels &cpu_kernels();
+// A specific variant, or nullptr if this build or CPU lacks it
+const CpuKernels *cpu_kernels_for(CpuLevel level);
+
+// Variants, defined in their own files so each can be compiled for its ISA
+extern const CpuKernels CPU_KERNELS_SCALAR;
+#if defined(__aarch64__)
+extern const CpuKernels CPU_KERNELS_NEON;
+#endif
+#if defined(__x86_64__)
+extern const CpuKernels CPU_KERNELS_SSE41;
+extern const CpuKernels CPU_KERNELS_AVX2;
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+// NEON variants. Advanced SIMD is part of every arm64 core (Cortex-A72 on
+// the Pi 4, Cortex-A76 on the Pi 5), so these need no special flags.
+#if defined(__aarch64__)
+
+#include "cpu_kernels.h"
+#include <arm_neon.h>
+
+// Quotient plus one where the remainder is over half, or exactly half with
+// an odd quotient
+static inline uint16x8_t round_shift_neon(uint16x8_t value, int16x8_t right, uint16x8_t mask, uint16x8_t half, uint16x8_t one) {
+	uint16x8_t quotient = vshlq_u16(value, right);
+	uint16x8_t remainder = vandq_u16(value, mask);
+	uint16x8_t up = vorrq_u16(vcgtq_u16(remainder, half), vandq_u16(vceqq_u16(remainder, half), vtstq_u16(quotient, one)));
+	return vsubq_u16(quotient, up);
+}
+
+static void unpack_to_8bit_neon(const uint16_t *src, uint8_t *dst, size_t count, int shift) {
+	const int16x8_t right = vdupq_n_s16((int16_t)-shift);
+	const uint16x8_t mask = vdupq_n_u16((uint16_t)((1 << shift) - 1));
+	const uint16x8_t half = vdupq_n_u16((uint16_t)(1 << (shift - 1)));
+	const uint16x8_t one = vdupq_n_u16(1);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		uint16x8_t a = round_shift_neon(vld1q_u16(src + i), right, mask, half, one);
+		uint16x8_t b = round_shift_neon(vld1q_u16(src + i + 8), right, mask, half, one);
+		vst1q_u8(dst + i, vcombine_u8(vqmovn_u16(a), vqmovn_u16(b)));
+	}
+	CPU_KERNELS_SCALAR.unpack_to_8bit(src + i, dst + i, count - i, shift);
+}
+
+static void add_rows_neon(uint32_t *out, const uint32_t *above, int count) {
+	int x = 0;
+	for (; x + 4 <= count; x += 4) {
+		vst1q_u32(out + x, vaddq_u32(vld1q_u32(out + x), vld1q_u32(above + x)));
+	}
+	CPU_KERNELS_SCALAR.add_rows(out + x, above + x, count - x);
+}
+
+static inline int32x4_t window_sum_neon(const uint32_t *top, const uint32_t *bottom, int left, int right) {
+	uint32x4_t s = vsubq_u32(vsubq_u32(vld1q_u32(bottom + right), vld1q_u32(bottom + left)),
+			vsubq_u32(vld1q_u32(top + right), vld1q_u32(top + left)));
+	return vreinterpretq_s32_u32(s);
+}
+
+static void threshold_row_neon(const uint8_t *src, const uint32_t *top, const uint32_t *bottom, uint8_t *dst,
+		int x_begin, int x_end, int radius, int area, int delta) {
+	const int32x4_t v_area = vdupq_n_s32(area);
+	const int32x4_t v_bias = vdupq_n_s32(delta * area);
+	int x = x_begin;
+	for (; x + 16 <= x_end; x += 16) {
+		uint8x16_t px = vld1q_u8(src + x);
+		uint16x8_t lo = vmovl_u8(vget_low_u8(px));
+		uint16x8_t hi = vmovl_u8(vget_high_u8(px));
+		int32x4_t p0 = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(lo)));
+		int32x4_t p1 = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(lo)));
+		int32x4_t p2 = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(hi)));
+		int32x4_t p3 = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(hi)));
+
+		uint32x4_t m0 = vcleq_s32(vmlaq_s32(v_bias, p0, v_area), window_sum_neon(top, bottom, x - radius, x + radius + 1));
+		uint32x4_t m1 = vcleq_s32(vmlaq_s32(v_bias, p1, v_area), window_sum_neon(top, bottom, x + 4 - radius, x + 4 + radius + 1));
+		uint32x4_t m2 = vcleq_s32(vmlaq_s32(v_bias, p2, v_area), window_sum_neon(top, bottom, x + 8 - radius, x + 8 + radius + 1));
+		uint32x4_t m3 = vcleq_s32(vmlaq_s32(v_bias, p3, v_area), window_sum_neon(top, bottom, x + 12 - radius, x + 12 + radius + 1));
+
+		uint16x8_t m01 = vcombine_u16(vmovn_u32(m0), vmovn_u32(m1));
+		uint16x8_t m23 = vcombine_u16(vmovn_u32(m2), vmovn_u32(m3));
+		vst1q_u8(dst + x, vcombine_u8(vmovn_u16(m01), vmovn_u16(m23)));
+	}
+	CPU_KERNELS_SCALAR.threshold_row(src, top, bottom, dst, x, x_end, radius, area, delta);
+}
+
+const CpuKernels CPU_KERNELS_NEON = {
+	CPU_NEON, "neon", unpack_to_8bit_neon, add_rows_neon, threshold_row_neon
+};
+
+#endif
@@ -0,0 +1,146 @@
+// SSE4.1 and AVX2 variants. Each function is compiled for its own ISA with a
+// target attribute, so the file builds with the baseline x86_64 flags and
+// nothing here runs unless cpu_kernels() found the feature.
+#if defined(__x86_64__)
+
+#include "cpu_kernels.h"
+#include <immintrin.h>
+
+#define SSE41 __attribute__((target("sse4.1")))
+#define AVX2 __attribute__((target("avx2")))
+
+// Quotient plus one where the remainder is over half, or exactly half with
+// an odd quotient; remainders are below 256 so signed compares suffice
+SSE41 static inline __m128i round_shift_sse41(__m128i value, __m128i count, __m128i mask, __m128i half, __m128i one) {
+	__m128i quotient = _mm_srl_epi16(value, count);
+	__m128i remainder = _mm_and_si128(value, mask);
+	__m128i odd = _mm_cmpeq_epi16(_mm_and_si128(quotient, one), one);
+	__m128i up = _mm_or_si128(_mm_cmpgt_epi16(remainder, half), _mm_and_si128(_mm_cmpeq_epi16(remainder, half), odd));
+	return _mm_sub_epi16(quotient, up);
+}
+
+SSE41 static void unpack_to_8bit_sse41(const uint16_t *src, uint8_t *dst, size_t count, int shift) {
+	const __m128i shift_count = _mm_cvtsi32_si128(shift);
+	const __m128i mask = _mm_set1_epi16((short)((1 << shift) - 1));
+	const __m128i half = _mm_set1_epi16((short)(1 << (shift - 1)));
+	const __m128i one = _mm_set1_epi16(1);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i a = round_shift_sse41(_mm_loadu_si128((const __m128i *)(src + i)), shift_count, mask, half, one);
+		__m128i b = round_shift_sse41(_mm_loadu_si128((const __m128i *)(src + i + 8)), shift_count, mask, half, one);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+	}
+	CPU_KERNELS_SCALAR.unpack_to_8bit(src + i, dst + i, count - i, shift);
+}
+
+SSE41 static void add_rows_sse41(uint32_t *out, const uint32_t *above, int count) {
+	int x = 0;
+	for (; x + 4 <= count; x += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(out + x));
+		__m128i b = _mm_loadu_si128((const __m128i *)(above + x));
+		_mm_storeu_si128((__m128i *)(out + x), _mm_add_epi32(a, b));
+	}
+	CPU_KERNELS_SCALAR.add_rows(out + x, above + x, count - x);
+}
+
+SSE41 static inline __m128i window_sum_sse41(const uint32_t *top, const uint32_t *bottom, int left, int right) {
+	__m128i bl = _mm_loadu_si128((const __m128i *)(bottom + left));
+	__m128i br = _mm_loadu_si128((const __m128i *)(bottom + right));
+	__m128i tl = _mm_loadu_si128((const __m128i *)(top + left));
+	__m128i tr = _mm_loadu_si128((const __m128i *)(top + right));
+	return _mm_sub_epi32(_mm_sub_epi32(br, bl), _mm_sub_epi32(tr, tl));
+}
+
+SSE41 static void threshold_row_sse41(const uint8_t *src, const uint32_t *top, const uint32_t *bottom, uint8_t *dst,
+		int x_begin, int x_end, int radius, int area, int delta) {
+	const __m128i v_area = _mm_set1_epi32(area);
+	const __m128i v_bias = _mm_set1_epi32(delta * area);
+	int x = x_begin;
+	for (; x + 16 <= x_end; x += 16) {
+		__m128i px = _mm_loadu_si128((const __m128i *)(src + x));
+		__m128i m[4];
+		for (int k = 0; k < 4; k++) {
+			__m128i p = _mm_cvtepu8_epi32(k == 0 ? px : k == 1 ? _mm_srli_si128(px, 4) : k == 2 ? _mm_srli_si128(px, 8) : _mm_srli_si128(px, 12));
+			__m128i lhs = _mm_add_epi32(_mm_mullo_epi32(p, v_area), v_bias);
+			// Lanes are all-ones where the pixel is brighter than the threshold
+			m[k] = _mm_cmpgt_epi32(lhs, window_sum_sse41(top, bottom, x + 4 * k - radius, x + 4 * k + radius + 1));
+		}
+		__m128i bytes = _mm_packs_epi16(_mm_packs_epi32(m[0], m[1]), _mm_packs_epi32(m[2], m[3]));
+		_mm_storeu_si128((__m128i *)(dst + x), _mm_xor_si128(bytes, _mm_set1_epi8(-1)));
+	}
+	CPU_KERNELS_SCALAR.threshold_row(src, top, bottom, dst, x, x_end, radius, area, delta);
+}
+
+const CpuKernels CPU_KERNELS_SSE41 = {
+	CPU_SSE41, "sse4.1", unpack_to_8bit_sse41, add_rows_sse41, threshold_row_sse41
+};
+
+AVX2 static inline __m256i round_shift_avx2(__m256i value, __m128i count, __m256i mask, __m256i half, __m256i one) {
+	__m256i quotient = _mm256_srl_epi16(value, count);
+	__m256i remainder = _mm256_and_si256(value, mask);
+	__m256i odd = _mm256_cmpeq_epi16(_mm256_and_si256(quotient, one), one);
+	__m256i up = _mm256_or_si256(_mm256_cmpgt_epi16(remainder, half), _mm256_and_si256(_mm256_cmpeq_epi16(remainder, half), odd));
+	return _mm256_sub_epi16(quotient, up);
+}
+
+AVX2 static void unpack_to_8bit_avx2(const uint16_t *src, uint8_t *dst, size_t count, int shift) {
+	const __m128i shift_count = _mm_cvtsi32_si128(shift);
+	const __m256i mask = _mm256_set1_epi16((short)((1 << shift) - 1));
+	const __m256i half = _mm256_set1_epi16((short)(1 << (shift - 1)));
+	const __m256i one = _mm256_set1_epi16(1);
+	size_t i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i a = round_shift_avx2(_mm256_loadu_si256((const __m256i *)(src + i)), shift_count, mask, half, one);
+		__m256i b = round_shift_avx2(_mm256_loadu_si256((const __m256i *)(src + i + 16)), shift_count, mask, half, one);
+		// Packing works per 128-bit lane; restore the order across lanes
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+		_mm256_storeu_si256((__m256i *)(dst + i), packed);
+	}
+	CPU_KERNELS_SCALAR.unpack_to_8bit(src + i, dst + i, count - i, shift);
+}
+
+AVX2 static void add_rows_avx2(uint32_t *out, const uint32_t *above, int count) {
+	int x = 0;
+	for (; x + 8 <= count; x += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(out + x));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(above + x));
+		_mm256_storeu_si256((__m256i *)(out + x), _mm256_add_epi32(a, b));
+	}
+	CPU_KERNELS_SCALAR.add_rows(out + x, above + x, count - x);
+}
+
+AVX2 static inline __m256i window_sum_avx2(const uint32_t *top, const uint32_t *bottom, int left, int right) {
+	__m256i bl = _mm256_loadu_si256((const __m256i *)(bottom + left));
+	__m256i br = _mm256_loadu_si256((const __m256i *)(bottom + right));
+	__m256i tl = _mm256_loadu_si256((const __m256i *)(top + left));
+	__m256i tr = _mm256_loadu_si256((const __m256i *)(top + right));
+	return _mm256_sub_epi32(_mm256_sub_epi32(br, bl), _mm256_sub_epi32(tr, tl));
+}
+
+AVX2 static void threshold_row_avx2(const uint8_t *src, const uint32_t *top, const uint32_t *bottom, uint8_t *dst,
+		int x_begin, int x_end, int radius, int area, int delta) {
+	const __m256i v_area = _mm256_set1_epi32(area);
+	const __m256i v_bias = _mm256_set1_epi32(delta * area);
+	int x = x_begin;
+	for (; x + 16 <= x_end; x += 16) {
+		__m128i px = _mm_loadu_si128((const __m128i *)(src + x));
+		__m256i lhs0 = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvtepu8_epi32(px), v_area), v_bias);
+		__m256i lhs1 = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(px, 8)), v_area), v_bias);
+		__m256i sum0 = window_sum_avx2(top, bottom, x - radius, x + radius + 1);
+		__m256i sum1 = window_sum_avx2(top, bottom, x + 8 - radius, x + 8 + radius + 1);
+
+		// Lanes are all-ones where the pixel is brighter than the threshold
+		__m256i m0 = _mm256_cmpgt_epi32(lhs0, sum0);
+		__m256i m1 = _mm256_cmpgt_epi32(lhs1, sum1);
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(m0, m1), 0xD8);
+		__m128i bytes = _mm_packs_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+		_mm_storeu_si128((__m128i *)(dst + x), _mm_xor_si128(bytes, _mm_set1_epi8(-1)));
+	}
+	CPU_KERNELS_SCALAR.threshold_row(src, top, bottom, dst, x, x_end, radius, area, delta);
+}
+
+const CpuKernels CPU_KERNELS_AVX2 = {
+	CPU_AVX2, "avx2", unpack_to_8bit_avx2, add_rows_avx2, threshold_row_avx2
+};
+
+#endif
@@ -0,0 +1,662 @@
+#include "detection_engine.h"
+#include "frame_trace.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+DetectionEngine::DetectionEngine() : use_run_segmentation(false), expected_search_budget_us(0), early_exit(false),
+		frame_budget_us(0), complete(true), next_tile(0), largest_marker_height(0),
+		gate_max_hamming(-1), gate_min_sharpness(0.0f), gated(0), outline_count(0) {
+}
+
+int MarkerFamily::decode_radius(const cv::aruco::Dictionary &dict, double error_correction_rate) {
+	// Same correction budget as Dictionary::identify, capped at what the table holds
+	int radius = (int)(dict.maxCorrectionBits * error_correction_rate);
+	return std::min(radius, CodeTable::MAX_HAMMING);
+}
+
+std::shared_ptr<const MarkerFamily> MarkerFamily::create(const std::string &name, const cv::aruco::Dictionary &dict) {
+	std::shared_ptr<MarkerFamily> family = std::make_shared<MarkerFamily>();
+	family->name = name;
+	family->dictionary = dict;
+	return family;
+}
+
+std::shared_ptr<const MarkerFamily> MarkerFamily::with_table(const std::shared_ptr<const MarkerFamily> &family, double error_correction_rate) {
+	const int radius = decode_radius(family->dictionary, error_correction_rate);
+	if (family->table_radius == radius) {
+		return family;
+	}
+	std::shared_ptr<MarkerFamily> rebuilt = std::make_shared<MarkerFamily>();
+	rebuilt->name = family->name;
+	rebuilt->dictionary = family->dictionary;
+	rebuilt->table.build(rebuilt->dictionary, radius);
+	rebuilt->table_radius = radius;
+	return rebuilt;
+}
+
+void DetectionEngine::set_dictionary(const cv::aruco::Dictionary &dict) {
+	std::string name = families.empty() ? std::string("default") : families[0].family->name;
+	families.clear();
+	add_family(name, dict, 0.0, true);
+}
+
+void DetectionEngine::set_parameters(const cv::aruco::DetectorParameters &p) {
+	params = p;
+}
+
+int DetectionEngine::add_family(const std::string &name, const cv::aruco::Dictionary &dict, double marker_size, bool enabled) {
+	FamilyEntry entry;
+	entry.family = MarkerFamily::with_table(MarkerFamily::create(name, dict), params.errorCorrectionRate);
+	entry.enabled = enabled;
+	entry.marker_size = marker_size;
+	families.push_back(std::move(entry));
+	return (int)families.size() - 1;
+}
+
+int DetectionEngine::get_enabled_family_count() const {
+	int count = 0;
+	for (const FamilyEntry &entry : families) {
+		count += entry.enabled ? 1 : 0;
+	}
+	return count;
+}
+
+void DetectionEngine::set_run_segmentation_enabled(bool enabled) {
+	use_run_segmentation = enabled;
+}
+
+bool DetectionEngine::get_run_segmentation_enabled() const {
+	return use_run_segmentation;
+}
+
+void DetectionEngine::add_expected_marker(int family, int id) {
+	for (const ExpectedMarker &expected : expected_markers) {
+		if (expected.family == family && expected.id == id) {
+			return;
+		}
+	}
+	expected_markers.push_back({ family, id, cv::Rect(), EXPECTED_TRACK_FRAMES + 1 });
+}
+
+void DetectionEngine::set_expected_markers(const std::vector<MarkerId> &ids) {
+	std::vector<ExpectedMarker> next;
+	next.reserve(ids.size());
+	for (const MarkerId &marker : ids) {
+		ExpectedMarker entry = { marker.family, marker.id, cv::Rect(), EXPECTED_TRACK_FRAMES + 1 };
+		for (const ExpectedMarker &expected : expected_markers) {
+			if (expected.family == marker.family && expected.id == marker.id) {
+				entry = expected;
+				break;
+			}
+		}
+		next.push_back(entry);
+	}
+	expected_markers.swap(next);
+}
+
+void DetectionEngine::set_expected_search_budget_us(int budget_us) {
+	expected_search_budget_us = std::max(0, budget_us);
+}
+
+int DetectionEngine::get_expected_search_budget_us() const {
+	return expected_search_budget_us;
+}
+
+void DetectionEngine::set_frame_budget_us(int budget_us) {
+	frame_budget_us = std::max(0, budget_us);
+	next_tile = 0;
+}
+
+int DetectionEngine::get_frame_budget_us() const {
+	return frame_budget_us;
+}
+
+void DetectionEngine::detect(const cv::Mat &gray, std::vector<DetectedMarker> &markers) {
+	markers.clear();
+	early_exit = false;
+	complete = true;
+	gated = 0;
+	if (gray.empty() || get_enabled_family_count() == 0) {
+		return;
+	}
+	const Clock::time_point start = Clock::now();
+
+	// Only rasterises when the frame size or intrinsics changed
+	mask.update(gray.size());
+
+	// One integral image serves every window size
+	{
+		TraceSpan span("threshold prepare");
+		threshold.prepare(gray);
+	}
+
+	const Clock::time_point frame_deadline = frame_budget_us > 0 ?
+			start + std::chrono::microseconds(frame_budget_us) : Clock::time_point::max();
+
+	if (expected_markers.empty()) {
+		search_frame(gray, markers, frame_deadline);
+	} else {
+		// Last known places of the expected markers first; most frames end here
+		find_expected_regions(gray.size());
+		if (!regions.empty()) {
+			complete &= collect_candidates(frame_deadline);
+			complete &= decode_candidates(gray, markers, frame_deadline);
+		}
+
+		// Anything still missing is searched for in the whole frame, within the budget
+		early_exit = expected_complete(markers);
+		if (!early_exit) {
+			Clock::time_point deadline = frame_deadline;
+			if (expected_search_budget_us > 0) {
+				deadline = std::min(deadline, start + std::chrono::microseconds(expected_search_budget_us));
+			}
+			search_frame(gray, markers, deadline);
+		}
+		update_expected_tracks(markers);
+	}
+
+	largest_marker_height = 0;
+	for (const DetectedMarker &marker : markers) {
+		largest_marker_height = std::max(largest_marker_height, cv::boundingRect(marker.corners).height);
+	}
+
+	if (params.cornerRefinementMethod == cv::aruco::CORNER_REFINE_SUBPIX) {
+		cv::TermCriteria criteria(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS,
+				params.cornerRefinementMaxIterations, params.cornerRefinementMinAccuracy);
+		cv::Size window(params.cornerRefinementWinSize, params.cornerRefinementWinSize);
+		for (DetectedMarker &marker : markers) {
+			cv::cornerSubPix(gray, marker.corners, window, cv::Size(-1, -1), criteria);
+		}
+	}
+
+	apply_sharpness_gate(gray, markers);
+}
+
+void DetectionEngine::score_markers(const cv::Mat &gray, std::vector<DetectedMarker> &markers) {
+	gated = 0;
+	const int border = params.markerBorderBits;
+	size_t kept = 0;
+	for (size_t i = 0; i < markers.size(); i++) {
+		DetectedMarker &marker = markers[i];
+		const cv::aruco::Dictionary &dict = families[marker.family].family->dictionary;
+		const int n = dict.markerSize;
+		if (extract_bits(gray, marker.corners, n, cell_bits)) {
+			marker.hamming = dict.getDistanceToId(cell_bits(cv::Rect(border, border, n, n)), marker.id, true);
+		}
+		if (gate_max_hamming >= 0 && marker.hamming > gate_max_hamming) {
+			gated++;
+			continue;
+		}
+		if (kept != i) {
+			markers[kept] = std::move(marker);
+		}
+		kept++;
+	}
+	markers.resize(kept);
+	apply_sharpness_gate(gray, markers);
+}
+
+// Bilinear sample, clamped to the frame
+static float sample_bilinear(const cv::Mat &gray, float x, float y) {
+	x = std::min(std::max(x, 0.0f), (float)gray.cols - 1.001f);
+	y = std::min(std::max(y, 0.0f), (float)gray.rows - 1.001f);
+	const int x0 = (int)x;
+	const int y0 = (int)y;
+	const float fx = x - x0;
+	const float fy = y - y0;
+	const uint8_t *r0 = gray.ptr<uint8_t>(y0);
+	const uint8_t *r1 = gray.ptr<uint8_t>(y0 + 1);
+	const float top = r0[x0] + (r0[x0 + 1] - r0[x0]) * fx;
+	const float bottom = r1[x0] + (r1[x0 + 1] - r1[x0]) * fx;
+	return top + (bottom - top) * fy;
+}
+
+float DetectionEngine::corner_sharpness(const cv::Mat &gray, const std::vector<cv::Point2f> &corners, int cells) const {
+	// Across the black border's outer edge, near each end of every side: the
+	// step over 2 px relative to the full step between the middle of the
+	// border cell and the quiet zone. A crisp edge scores 1, a ramp w px wide
+	// about 2 / w.
+	static const float ALONG[2] = { 0.2f, 0.8f };
+	static const float MIN_CONTRAST = 10.0f;
+	const cv::Point2f center = (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25f;
+
+	float perimeter = 0.0f;
+	for (int k = 0; k < 4; k++) {
+		cv::Point2f d = corners[(k + 1) % 4] - corners[k];
+		perimeter += std::sqrt(d.dot(d));
+	}
+	const float reach = std::max(1.5f, perimeter / (8.0f * cells));
+
+	float total = 0.0f;
+	int samples = 0;
+	for (int k = 0; k < 4; k++) {
+		const cv::Point2f a = corners[k];
+		const cv::Point2f b = corners[(k + 1) % 4];
+		const cv::Point2f d = b - a;
+		const float length = std::sqrt(d.dot(d));
+		if (length < 1.0f) {
+			continue;
+		}
+		cv::Point2f normal(-d.y / length, d.x / length);
+		if (normal.dot((a + b) * 0.5f - center) < 0.0f) {
+			normal = -normal;
+		}
+
+		for (float t : ALONG) {
+			const cv::Point2f p = a + d * t;
+			const float wide = sample_bilinear(gray, p.x + reach * normal.x, p.y + reach * normal.y) -
+					sample_bilinear(gray, p.x - reach * normal.x, p.y - reach * normal.y);
+			if (wide < MIN_CONTRAST) {
+				continue;
+			}
+			const float narrow = sample_bilinear(gray, p.x + normal.x, p.y + normal.y) -
+					sample_bilinear(gray, p.x - normal.x, p.y - normal.y);
+			total += std::min(std::max(narrow / wide, 0.0f), 1.0f);
+			samples++;
+		}
+	}
+	return samples > 0 ? total / samples : 0.0f;
+}
+
+void DetectionEngine::apply_sharpness_gate(const cv::Mat &gray, std::vector<DetectedMarker> &markers) {
+	size_t kept = 0;
+	for (size_t i = 0; i < markers.size(); i++) {
+		const int cells = families[markers[i].family].family->dictionary.markerSize + 2 * params.markerBorderBits;
+		markers[i].sharpness = corner_sharpness(gray, markers[i].corners, cells);
+		if (markers[i].sharpness < gate_min_sharpness) {
+			gated++;
+			continue;
+		}
+		if (kept != i) {
+			markers[kept] = std::move(markers[i]);
+		}
+		kept++;
+	}
+	markers.resize(kept);
+}
+
+void DetectionEngine::search_frame(const cv::Mat &gray, std::vector<DetectedMarker> &markers, Clock::time_point deadline) {
+	if (deadline == Clock::time_point::max()) {
+		regions.assign(1, cv::Rect(0, 0, gray.cols, gray.rows));
+		collect_candidates(deadline);
+		decode_candidates(gray, markers, deadline);
+		return;
+	}
+
+	// Horizontal bands, each reaching up into the previous one by a bit more
+	// than the tallest recent marker so a marker on a seam is whole in one band
+	const int band = (gray.rows + FRAME_TILES - 1) / FRAME_TILES;
+	const int overlap = std::min(band, std::max(gray.rows / 16, largest_marker_height * 5 / 4));
+
+	for (int n = 0; n < FRAME_TILES; n++) {
+		const int tile = (next_tile + n) % FRAME_TILES;
+		// The first band always runs so every frame makes progress
+		if (n > 0 && Clock::now() > deadline) {
+			complete = false;
+			next_tile = tile;
+			return;
+		}
+
+		const int y0 = std::max(0, tile * band - overlap);
+		const int y1 = std::min(gray.rows, (tile + 1) * band);
+		if (y1 <= y0) {
+			continue;
+		}
+		regions.assign(1, cv::Rect(0, y0, gray.cols, y1 - y0));
+		bool finished = collect_candidates(deadline);
+		finished = decode_candidates(gray, markers, deadline) && finished;
+		if (!finished) {
+			// Retry the interrupted band next frame, unless it was the one this
+			// frame started with: move on so no band can starve the others
+			complete = false;
+			next_tile = n > 0 ? tile : (tile + 1) % FRAME_TILES;
+			return;
+		}
+	}
+	next_tile = 0;
+}
+
+bool DetectionEngine::collect_candidates(Clock::time_point deadline) {
+	candidates.clear();
+	bool finished = true;
+	const int step = std::max(1, params.adaptiveThreshWinSizeStep);
+	const int scales = std::max(1, (params.adaptiveThreshWinSizeMax - params.adaptiveThreshWinSizeMin) / step + 1);
+	for (int i = 0; i < scales; i++) {
+		// The first scale always runs so a tight budget still yields something
+		if (i > 0 && Clock::now() > deadline) {
+			finished = false;
+			break;
+		}
+		int window = params.adaptiveThreshWinSizeMin + i * step;
+		if (window % 2 == 0) {
+			window++;
+		}
+		for (const cv::Rect &region : regions) {
+			{
+				TraceSpan span("threshold");
+				threshold.apply(std::max(3, window), params.adaptiveThreshConstant, binary, &mask, region);
+			}
+			TraceSpan span("contours");
+			find_candidates(binary, region, candidates);
+		}
+	}
+	merge_candidates(candidates);
+	return finished;
+}
+
+bool DetectionEngine::decode_candidates(const cv::Mat &gray, std::vector<DetectedMarker> &markers, Clock::time_point deadline) {
+	TraceSpan span("decode");
+	for (Candidate &candidate : candidates) {
+		if (Clock::now() > deadline) {
+			return false;
+		}
+
+		DetectedMarker marker;
+		if (!decode_candidate(gray, candidate, marker)) {
+			continue;
+		}
+
+		// Inner and outer contours of one marker can both decode, as can the
+		// same marker found again by the full-frame pass; keep the first
+		cv::Point2f center = (candidate.corners[0] + candidate.corners[2]) * 0.5f;
+		bool duplicate = false;
+		for (size_t j = 0; j < markers.size() && !duplicate; j++) {
+			if (markers[j].id != marker.id || markers[j].family != marker.family) {
+				continue;
+			}
+			cv::Point2f other = (markers[j].corners[0] + markers[j].corners[2]) * 0.5f;
+			cv::Point2f delta = center - other;
+			double half_side = candidate.perimeter / 8.0;
+			duplicate = delta.dot(delta) < half_side * half_side;
+		}
+		if (duplicate) {
+			continue;
+		}
+
+		markers.push_back(std::move(marker));
+		if (!expected_markers.empty() && expected_complete(markers)) {
+			break;
+		}
+	}
+	return true;
+}
+
+bool DetectionEngine::expected_complete(const std::vector<DetectedMarker> &markers) const {
+	for (const ExpectedMarker &expected : expected_markers) {
+		bool found = false;
+		for (const DetectedMarker &marker : markers) {
+			if (marker.family == expected.family && marker.id == expected.id) {
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void DetectionEngine::find_expected_regions(const cv::Size &frame) {
+	regions.clear();
+	const cv::Rect bounds(0, 0, frame.width, frame.height);
+	for (const ExpectedMarker &expected : expected_markers) {
+		if (expected.frames_since_seen > EXPECTED_TRACK_FRAMES || expected.last_box.empty()) {
+			continue;
+		}
+		// Grow by the marker's own size on every side to allow for motion
+		const cv::Rect &box = expected.last_box;
+		const int margin = std::max(box.width, box.height);
+		cv::Rect region = cv::Rect(box.x - margin, box.y - margin, box.width + 2 * margin, box.height + 2 * margin) & bounds;
+		if (region.empty()) {
+			continue;
+		}
+
+		// Overlapping regions are thresholded once, as their union
+		for (size_t i = 0; i < regions.size();) {
+			if ((regions[i] & region).empty()) {
+				i++;
+				continue;
+			}
+			region |= regions[i];
+			regions.erase(regions.begin() + i);
+			i = 0;
+		}
+		regions.push_back(region);
+	}
+}
+
+void DetectionEngine::update_expected_tracks(const std::vector<DetectedMarker> &markers) {
+	for (ExpectedMarker &expected : expected_markers) {
+		expected.frames_since_seen++;
+		for (const DetectedMarker &marker : markers) {
+			if (marker.family == expected.family && marker.id == expected.id) {
+				expected.last_box = cv::boundingRect(marker.corners);
+				expected.frames_since_seen = 0;
+				break;
+			}
+		}
+	}
+}
+
+void DetectionEngine::find_candidates(const cv::Mat &binary_img, const cv::Rect &region, std::vector<Candidate> &out) {
+	// Perimeter limits are relative to the whole frame, not the region
+	const int max_dim = std::max(binary_img.cols, binary_img.rows);
+	const double min_perimeter = params.minMarkerPerimeterRate * max_dim;
+	const double max_perimeter = params.maxMarkerPerimeterRate * max_dim;
+	const cv::Mat view = binary_img(region);
+
+	if (use_run_segmentation) {
+		// Contours are reused as outline storage; only the first outline_count are valid
+		segmentation.find_outlines(view, min_perimeter, max_perimeter, contours, outline_count);
+		for (size_t i = 0; i < outline_count; i++) {
+			for (cv::Point &p : contours[i]) {
+				p += region.tl();
+			}
+			add_candidate(contours[i], cv::arcLength(contours[i], true), binary_img.size(), out);
+		}
+		return;
+	}
+
+	contours.clear();
+	cv::findContours(view, contours, cv::RETR_LIST, cv::CHAIN_APPROX_NONE, region.tl());
+	for (const auto &contour : contours) {
+		add_candidate(contour, (double)contour.size(), binary_img.size(), out);
+	}
+}
+
+void DetectionEngine::add_candidate(const std::vector<cv::Point> &polygon, double perimeter, const cv::Size &frame, std::vector<Candidate> &out) {
+	const int max_dim = std::max(frame.width, frame.height);
+	if (perimeter < params.minMarkerPerimeterRate * max_dim || perimeter > params.maxMarkerPerimeterRate * max_dim) {
+		return;
+	}
+
+	cv::approxPolyDP(polygon, approx, perimeter * params.polygonalApproxAccuracyRate, true);
+	if (approx.size() != 4 || !cv::isContourConvex(approx)) {
+		return;
+	}
+
+	// Reject quads with a collapsed side
+	double min_side_sq = DBL_MAX;
+	for (int j = 0; j < 4; j++) {
+		cv::Point side = approx[j] - approx[(j + 1) % 4];
+		min_side_sq = std::min(min_side_sq, (double)side.dot(side));
+	}
+	const double min_side = params.minCornerDistanceRate * perimeter;
+	if (min_side_sq < min_side * min_side) {
+		return;
+	}
+
+	// Reject quads touching the frame edge, their bits would be cut off
+	const int border = params.minDistanceToBorder;
+	for (const cv::Point &p : approx) {
+		if (p.x < border || p.y < border || p.x > frame.width - 1 - border || p.y > frame.height - 1 - border) {
+			return;
+		}
+	}
+
+	Candidate candidate;
+	candidate.perimeter = perimeter;
+	candidate.corners.assign(approx.begin(), approx.end());
+
+	// Order corners clockwise in image coordinates
+	cv::Point2f d1 = candidate.corners[1] - candidate.corners[0];
+	cv::Point2f d2 = candidate.corners[2] - candidate.corners[0];
+	if (d1.x * d2.y - d1.y * d2.x < 0.0f) {
+		std::swap(candidate.corners[1], candidate.corners[3]);
+	}
+	out.push_back(std::move(candidate));
+}
+
+void DetectionEngine::merge_candidates(std::vector<Candidate> &found) {
+	// Different window sizes trace the same edge within a pixel or two. Merge
+	// quads closer than half a cell; the inner contour of a marker's black
+	// border sits a full cell away and is left alone. With several families
+	// the finest grid sets the cell size.
+	int cells = 0;
+	for (const FamilyEntry &entry : families) {
+		if (entry.enabled) {
+			cells = std::max(cells, entry.family->dictionary.markerSize + 2 * params.markerBorderBits);
+		}
+	}
+	std::vector<Candidate> &kept = merged;
+	kept.clear();
+
+	for (Candidate &candidate : found) {
+		const double tolerance = candidate.perimeter / (4.0 * cells) * 0.5;
+		bool merged = false;
+		for (const Candidate &other : kept) {
+			for (int shift = 0; shift < 4 && !merged; shift++) {
+				double total = 0.0;
+				for (int k = 0; k < 4; k++) {
+					cv::Point2f d = candidate.corners[k] - other.corners[(k + shift) % 4];
+					total += std::sqrt(d.dot(d));
+				}
+				merged = total * 0.25 < tolerance;
+			}
+			if (merged) {
+				break;
+			}
+		}
+		if (!merged) {
+			kept.push_back(std::move(candidate));
+		}
+	}
+	found.swap(kept);
+}
+
+bool DetectionEngine::extract_bits(const cv::Mat &gray, const std::vector<cv::Point2f> &quad, int marker_size, cv::Mat &bits) {
+	const int cells = marker_size + 2 * params.markerBorderBits;
+	const int cell_size = params.perspectiveRemovePixelPerCell;
+	const float side = (float)(cells * cell_size);
+
+	const cv::Point2f target[4] = {
+		cv::Point2f(0, 0), cv::Point2f(side - 1, 0), cv::Point2f(side - 1, side - 1), cv::Point2f(0, side - 1)
+	};
+	cv::Mat transform = cv::getPerspectiveTransform(quad.data(), target);
+	cv::warpPerspective(gray, warped, transform, cv::Size((int)side, (int)side), cv::INTER_NEAREST);
+
+	// A uniform patch cannot be a marker
+	cv::Scalar mean, stddev;
+	cv::meanStdDev(warped, mean, stddev);
+	if (stddev[0] < params.minOtsuStdDev) {
+		return false;
+	}
+
+	cv::threshold(warped, warped, 125, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+
+	const int margin = (int)(params.perspectiveRemoveIgnoredMarginPerCell * cell_size);
+	const int inner = cell_size - 2 * margin;
+	bits.create(cells, cells, CV_8UC1);
+	for (int y = 0; y < cells; y++) {
+		for (int x = 0; x < cells; x++) {
+			cv::Mat square = warped(cv::Rect(x * cell_size + margin, y * cell_size + margin, inner, inner));
+			bits.at<uint8_t>(y, x) = cv::countNonZero(square) > (int)square.total() / 2 ? 1 : 0;
+		}
+	}
+
+	// The border must be black apart from a tolerated number of flipped cells
+	const int border = params.markerBorderBits;
+	int border_errors = 0;
+	for (int y = 0; y < cells; y++) {
+		for (int x = 0; x < cells; x++) {
+			bool in_border = y < border || y >= cells - border || x < border || x >= cells - border;
+			if (in_border && bits.at<uint8_t>(y, x) != 0) {
+				border_errors++;
+			}
+		}
+	}
+	const int max_border_errors = (int)(marker_size * marker_size * params.maxErroneousBitsInBorderRate);
+	return border_errors <= max_border_errors;
+}
+
+bool DetectionEngine::decode_quad(const cv::Mat &gray, const std::vector<cv::Point2f> &quad, DetectedMarker &marker) {
+	Candidate candidate;
+	candidate.corners = quad;
+	candidate.perimeter = cv::arcLength(quad, true);
+	return decode_candidate(gray, candidate, marker);
+}
+
+bool DetectionEngine::decode_candidate(const cv::Mat &gray, Candidate &candidate, DetectedMarker &marker) {
+	const int border = params.markerBorderBits;
+	int extracted_size = -1;
+	bool extracted = false;
+	bool marginal = false;
+
+	for (size_t f = 0; f < families.size(); f++) {
+		if (!families[f].enabled) {
+			continue;
+		}
+		const MarkerFamily &family = *families[f].family;
+
+		// Families sharing a grid size share one warp and bit sampling
+		const int n = family.dictionary.markerSize;
+		if (n != extracted_size) {
+			extracted = extract_bits(gray, candidate.corners, n, cell_bits);
+			extracted_size = n;
+		}
+		if (!extracted) {
+			continue;
+		}
+
+		cv::Mat payload = cell_bits(cv::Rect(border, border, n, n));
+		int id = -1;
+		int rotation = 0;
+		int hamming = 0;
+		if (family.table.is_built() && family.table_radius == MarkerFamily::decode_radius(family.dictionary, params.errorCorrectionRate)) {
+			// One hash probe regardless of dictionary size
+			if (!family.table.lookup(CodeTable::code_from_bits(payload), id, rotation, hamming)) {
+				continue;
+			}
+		} else if (family.dictionary.identify(payload.clone(), id, rotation, params.errorCorrectionRate)) {
+			// Markers too large for a table, or a table built for another
+			// radius, fall back to OpenCV's Hamming scan
+			hamming = family.dictionary.getDistanceToId(payload, id, true);
+		} else {
+			continue;
+		}
+
+		// Marginal decodes never reach the pose stage; another family of the
+		// same grid size may still match the candidate exactly
+		if (gate_max_hamming >= 0 && hamming > gate_max_hamming) {
+			marginal = true;
+			continue;
+		}
+
+		// Rotate so corner 0 is the marker's own top-left
+		if (rotation != 0) {
+			std::rotate(candidate.corners.begin(), candidate.corners.begin() + 4 - rotation, candidate.corners.end());
+		}
+		marker.id = id;
+		marker.family = (int)f;
+		marker.corners = candidate.corners;
+		marker.hamming = hamming;
+		return true;
+	}
+	if (marginal) {
+		gated++;
+	}
+	return false;
+}
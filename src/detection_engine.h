@@ -0,0 +1,207 @@
+#ifndef DETECTION_ENGINE_H
+#define DETECTION_ENGINE_H
+
+#include "adaptive_threshold.h"
+#include "code_table.h"
+#include "run_segmentation.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/aruco.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One decoded marker
+struct DetectedMarker {
+	int id;
+	int family; // Index into DetectionEngine's families
+	std::vector<cv::Point2f> corners;
+	int hamming = -1; // Bits corrected by the decode, -1 if unknown
+	float sharpness = 0.0f; // Edge step over 2 px vs across the border cell, 1 = crisp
+};
+
+// A marker of one family, as in an expected set
+struct MarkerId {
+	int family;
+	int id;
+};
+
+// A dictionary decoded by the engine, e.g. AprilTag 36h11 or ArUco 4x4.
+// Never changed once made: engines and published configurations share it
+// through a shared_ptr, so its decode table is built before anyone sees it.
+struct MarkerFamily {
+	std::string name;
+	cv::aruco::Dictionary dictionary;
+	CodeTable table; // Empty until built, and for markers too large for one
+	int table_radius = -1; // Hamming radius `table` was built for
+
+	// Bits Dictionary::identify corrects at this rate, capped at what a table holds
+	static int decode_radius(const cv::aruco::Dictionary &dict, double error_correction_rate);
+
+	static std::shared_ptr<const MarkerFamily> create(const std::string &name, const cv::aruco::Dictionary &dict);
+	// `family` with a table for this rate: itself if it already has one, else
+	// a copy with a new table. The 36h11 table takes ~16 MB and tens of
+	// milliseconds, so this never runs on the frame thread.
+	static std::shared_ptr<const MarkerFamily> with_table(const std::shared_ptr<const MarkerFamily> &family, double error_correction_rate);
+};
+
+// One entry of a family list; DetectedMarker::family is the index
+struct FamilyEntry {
+	std::shared_ptr<const MarkerFamily> family;
+	bool enabled;
+	double marker_size; // Physical side in metres for the pose stage, 0 = detector default
+};
+
+// Square marker detection pipeline used in place of
+// cv::aruco::ArucoDetector::detectMarkers. It honours the same
+// DetectorParameters, but runs its own stages so each one can be tuned:
+//
+//   threshold -> candidate quads -> bit extraction -> decode -> refinement
+//
+// Several marker families can be enabled at once. Thresholding and quad
+// extraction run once per frame, and each candidate is decoded against
+// every enabled family in order until one matches.
+//
+// Buffers are members so that steady-state frames do not allocate.
+class DetectionEngine {
+public:
+	// Starts without families; see set_dictionary, add_family and set_families
+	DetectionEngine();
+
+	// Replace all families with a single dictionary
+	void set_dictionary(const cv::aruco::Dictionary &dict);
+	// Decode tables are not rebuilt here. A family whose table was built for
+	// another Hamming radius decodes through Dictionary::identify until it is
+	// handed one built for the new radius.
+	void set_parameters(const cv::aruco::DetectorParameters &params);
+
+	// Builds the family's table for the current parameters on the calling
+	// thread; returns the new family's index
+	int add_family(const std::string &name, const cv::aruco::Dictionary &dict, double marker_size, bool enabled);
+	// Replace the whole list, e.g. from a configuration published elsewhere
+	void set_families(const std::vector<FamilyEntry> &list) { families = list; }
+	const MarkerFamily &get_family(int index) const { return *families[index].family; }
+	bool is_family_enabled(int index) const { return families[index].enabled; }
+	int get_family_count() const { return (int)families.size(); }
+	int get_enabled_family_count() const;
+
+	// Extract candidates from run-length union-find components instead of
+	// cv::findContours
+	void set_run_segmentation_enabled(bool enabled);
+	bool get_run_segmentation_enabled() const;
+
+	// Static inclusion/exclusion regions, applied in the threshold stage
+	DetectionMask &get_mask() { return mask; }
+	const DetectionMask &get_mask() const { return mask; }
+
+	// Expected-set mode: candidates around the last known positions of the
+	// expected markers are decoded first, and detection stops as soon as all
+	// of them are found. Whatever is still missing is then searched for in
+	// the whole frame, for at most the budget (0 = no limit).
+	void add_expected_marker(int family, int id);
+	// Replace the whole set; markers that stay in it keep their last known positions
+	void set_expected_markers(const std::vector<MarkerId> &ids);
+	bool has_expected_markers() const { return !expected_markers.empty(); }
+	void set_expected_search_budget_us(int budget_us);
+	int get_expected_search_budget_us() const;
+	// Whether the last frame found every expected marker without the full-frame pass
+	bool last_frame_exited_early() const { return early_exit; }
+
+	// Per-frame time budget (0 = none). Under a budget the full-frame search
+	// runs in horizontal bands with deadline checks between threshold scales,
+	// bands and candidates; what is found in time is returned, the frame is
+	// flagged incomplete and the next frame resumes at the first band not
+	// covered.
+	void set_frame_budget_us(int budget_us);
+	int get_frame_budget_us() const;
+	bool last_frame_complete() const { return complete; }
+
+	// Confidence gates applied before markers reach the pose stage: decodes
+	// needing more than `max_hamming` corrected bits (-1 = off) and markers
+	// whose corner sharpness is below `min_sharpness` (0 = off) are dropped
+	void set_max_hamming(int max_hamming) { gate_max_hamming = max_hamming; }
+	int get_max_hamming() const { return gate_max_hamming; }
+	void set_min_corner_sharpness(float min_sharpness) { gate_min_sharpness = min_sharpness; }
+	float get_min_corner_sharpness() const { return gate_min_sharpness; }
+	// Markers dropped by the gates in the last frame
+	int last_frame_gated() const { return gated; }
+
+	// Fill hamming and sharpness for markers found by another detector, such
+	// as ArucoDetector, and apply the same gates
+	void score_markers(const cv::Mat &gray, std::vector<DetectedMarker> &markers);
+
+	// Detect markers in a CV_8UC1 frame. Corners are clockwise starting at the
+	// marker's top-left, as with ArucoDetector.
+	void detect(const cv::Mat &gray, std::vector<DetectedMarker> &markers);
+
+	// Decode one quad (corners clockwise) against the enabled families, as
+	// detect() does for each candidate; for benchmarks and outside quad sources
+	bool decode_quad(const cv::Mat &gray, const std::vector<cv::Point2f> &quad, DetectedMarker &marker);
+
+private:
+	struct Candidate {
+		std::vector<cv::Point2f> corners;
+		double perimeter;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	struct ExpectedMarker {
+		int family;
+		int id;
+		cv::Rect last_box;
+		int frames_since_seen;
+	};
+	// Frames a last known position keeps guiding the search
+	static constexpr int EXPECTED_TRACK_FRAMES = 5;
+
+	// Bands the frame is split into under a time budget
+	static constexpr int FRAME_TILES = 4;
+
+	void search_frame(const cv::Mat &gray, std::vector<DetectedMarker> &markers, Clock::time_point deadline);
+	// Both return false when the deadline cut them short
+	bool collect_candidates(Clock::time_point deadline);
+	bool decode_candidates(const cv::Mat &gray, std::vector<DetectedMarker> &markers, Clock::time_point deadline);
+	bool expected_complete(const std::vector<DetectedMarker> &markers) const;
+	void find_expected_regions(const cv::Size &frame);
+	void update_expected_tracks(const std::vector<DetectedMarker> &markers);
+	void find_candidates(const cv::Mat &binary, const cv::Rect &region, std::vector<Candidate> &out);
+	void add_candidate(const std::vector<cv::Point> &polygon, double perimeter, const cv::Size &frame, std::vector<Candidate> &out);
+	void merge_candidates(std::vector<Candidate> &found);
+	bool extract_bits(const cv::Mat &gray, const std::vector<cv::Point2f> &quad, int marker_size, cv::Mat &bits);
+	bool decode_candidate(const cv::Mat &gray, Candidate &candidate, DetectedMarker &marker);
+	float corner_sharpness(const cv::Mat &gray, const std::vector<cv::Point2f> &corners, int cells) const;
+	void apply_sharpness_gate(const cv::Mat &gray, std::vector<DetectedMarker> &markers);
+
+	std::vector<FamilyEntry> families;
+	cv::aruco::DetectorParameters params;
+
+	AdaptiveThreshold threshold;
+	DetectionMask mask;
+	RunSegmentation segmentation;
+	bool use_run_segmentation;
+	std::vector<ExpectedMarker> expected_markers;
+	int expected_search_budget_us;
+	bool early_exit;
+	int frame_budget_us;
+	bool complete;
+	int next_tile;
+	int largest_marker_height; // Sizes the band overlap
+	int gate_max_hamming;
+	float gate_min_sharpness;
+	int gated;
+
+	// Per-frame scratch, reused across frames
+	cv::Mat binary;
+	std::vector<cv::Rect> regions; // Parts of the frame thresholded this pass
+	cv::Mat warped;
+	cv::Mat cell_bits;
+	std::vector<std::vector<cv::Point>> contours;
+	size_t outline_count;
+	std::vector<cv::Point> approx;
+	std::vector<Candidate> candidates;
+	std::vector<Candidate> merged;
+};
+
+#endif
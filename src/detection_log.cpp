@@ -0,0 +1,402 @@
+// Logs outgrow 2 GiB within an hour; 32-bit Raspberry Pi OS needs 64-bit offsets
+#define _FILE_OFFSET_BITS 64
+
+#include "detection_log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const uint32_t LOG_MAGIC = 0x474c5441; // "ATLG"
+const uint32_t LOG_VERSION = 1;
+const uint32_t TRAILER_MAGIC = 0x494c5441; // "ATLI"
+
+enum RecordType : uint32_t {
+	RECORD_FRAME = 1,
+	RECORD_FAMILY = 2,
+	RECORD_INDEX = 3
+};
+
+struct FileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t index_interval;
+	uint32_t marker_size;
+};
+
+struct RecordHeader {
+	uint32_t type;
+	uint32_t size; // Payload bytes after this header
+};
+
+struct FrameHeader {
+	uint64_t timestamp_ns;
+	uint64_t sequence;
+	uint32_t flags;
+	uint32_t count; // LogMarkers following
+};
+
+struct Trailer {
+	uint64_t end_offset; // First record after the frame data
+	uint64_t frame_count;
+	uint64_t end_time;
+	uint32_t magic;
+	uint32_t reserved;
+};
+
+}
+
+DetectionLogWriter::~DetectionLogWriter() {
+	close();
+}
+
+bool DetectionLogWriter::open(const std::string &path) {
+	close();
+	FILE *opened = fopen(path.c_str(), "wb");
+	if (!opened) {
+		return false;
+	}
+	FileHeader header = { LOG_MAGIC, LOG_VERSION, LOG_INDEX_INTERVAL, sizeof(LogMarker) };
+	if (fwrite(&header, sizeof(header), 1, opened) != 1) {
+		fclose(opened);
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		file = opened;
+		file_offset = sizeof(header);
+		frames = 0;
+		dropped_frames = 0;
+		last_time = 0;
+		index.clear();
+		family_names.clear();
+		family_count = 0;
+		// About a second of 200 fps x 50 markers before the camera thread reallocates
+		pending.reserve(1 << 20);
+		stopping = false;
+	}
+	worker = std::thread(&DetectionLogWriter::run, this);
+	return true;
+}
+
+bool DetectionLogWriter::is_open() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return file != nullptr && !stopping;
+}
+
+void DetectionLogWriter::close() {
+	// From here on append() and set_family_name() drop what they are given,
+	// so the worker drains a queue that no longer grows
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!file || stopping) {
+			return;
+		}
+		stopping = true;
+	}
+	wake.notify_one();
+	worker.join();
+
+	// Family table, index and trailer let the reader open without a scan
+	std::lock_guard<std::mutex> lock(mutex);
+	Trailer trailer = { file_offset, frames, last_time, TRAILER_MAGIC, 0 };
+	for (size_t i = 0; i < family_names.size(); i++) {
+		int32_t family = (int32_t)i;
+		const std::string &name = family_names[i];
+		RecordHeader header = { RECORD_FAMILY, (uint32_t)(sizeof(family) + name.size()) };
+		fwrite(&header, sizeof(header), 1, file);
+		fwrite(&family, sizeof(family), 1, file);
+		fwrite(name.data(), 1, name.size(), file);
+	}
+	RecordHeader header = { RECORD_INDEX, (uint32_t)(index.size() * sizeof(LogIndexEntry)) };
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(index.data(), sizeof(LogIndexEntry), index.size(), file);
+	fwrite(&trailer, sizeof(trailer), 1, file);
+	fclose(file);
+	file = nullptr;
+	pending.clear();
+}
+
+void DetectionLogWriter::set_family_name(int index, const std::string &name) {
+	if (index < 0) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file || stopping) {
+		return;
+	}
+	if ((int)family_names.size() <= index) {
+		family_names.resize(index + 1);
+		family_count = index + 1;
+	}
+	if (family_names[index] == name) {
+		return;
+	}
+	family_names[index] = name;
+	int32_t family = index;
+	enqueue_record(RECORD_FAMILY, &family, sizeof(family), name.data(), name.size());
+	wake.notify_one();
+}
+
+void DetectionLogWriter::append(uint64_t timestamp_ns, uint64_t sequence, uint32_t flags, const LogMarker *markers, uint32_t count) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!file || stopping) {
+		return;
+	}
+	if (pending.size() > max_pending_bytes) {
+		dropped_frames++;
+		return;
+	}
+
+	if (frames % LOG_INDEX_INTERVAL == 0) {
+		index.push_back({ timestamp_ns, file_offset });
+	}
+	FrameHeader header = { timestamp_ns, sequence, flags, count };
+	enqueue_record(RECORD_FRAME, &header, sizeof(header), markers, count * sizeof(LogMarker));
+	frames++;
+	last_time = timestamp_ns;
+	lock.unlock();
+	wake.notify_one();
+}
+
+// Caller holds the mutex
+void DetectionLogWriter::enqueue_record(uint32_t type, const void *payload, uint32_t size, const void *extra, uint32_t extra_size) {
+	RecordHeader header = { type, size + extra_size };
+	const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&header);
+	pending.insert(pending.end(), bytes, bytes + sizeof(header));
+	bytes = static_cast<const uint8_t *>(payload);
+	pending.insert(pending.end(), bytes, bytes + size);
+	if (extra_size > 0) {
+		bytes = static_cast<const uint8_t *>(extra);
+		pending.insert(pending.end(), bytes, bytes + extra_size);
+	}
+	file_offset += sizeof(header) + size + extra_size;
+}
+
+void DetectionLogWriter::set_max_pending_bytes(size_t bytes) {
+	std::lock_guard<std::mutex> lock(mutex);
+	max_pending_bytes = bytes;
+}
+
+uint64_t DetectionLogWriter::get_frames() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return frames;
+}
+
+uint64_t DetectionLogWriter::get_dropped_frames() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return dropped_frames;
+}
+
+uint64_t DetectionLogWriter::get_bytes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return file_offset;
+}
+
+void DetectionLogWriter::run() {
+	std::vector<uint8_t> writing;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !pending.empty(); });
+			if (pending.empty()) {
+				return;
+			}
+			writing.swap(pending);
+		}
+		// Flushed per batch so a crash loses at most the frames still queued
+		fwrite(writing.data(), 1, writing.size(), file);
+		fflush(file);
+		writing.clear();
+	}
+}
+
+DetectionLogReader::~DetectionLogReader() {
+	close();
+}
+
+bool DetectionLogReader::open(const std::string &path) {
+	close();
+	file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+
+	FileHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != LOG_MAGIC ||
+			header.version != LOG_VERSION || header.marker_size != sizeof(LogMarker)) {
+		close();
+		return false;
+	}
+	fseeko(file, 0, SEEK_END);
+	uint64_t file_size = ftello(file);
+
+	recovered = !read_trailer(file_size);
+	if (recovered) {
+		scan(file_size);
+	}
+	start_time = index.empty() ? 0 : index.front().timestamp_ns;
+	rewind();
+	return true;
+}
+
+void DetectionLogReader::close() {
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+	index.clear();
+	family_names.clear();
+	data_end = frame_count = start_time = end_time = 0;
+	recovered = false;
+}
+
+bool DetectionLogReader::read_trailer(uint64_t file_size) {
+	Trailer trailer;
+	if (file_size < sizeof(FileHeader) + sizeof(Trailer) ||
+			fseeko(file, file_size - sizeof(Trailer), SEEK_SET) != 0 ||
+			fread(&trailer, sizeof(trailer), 1, file) != 1 || trailer.magic != TRAILER_MAGIC ||
+			trailer.end_offset > file_size - sizeof(Trailer)) {
+		return false;
+	}
+
+	fseeko(file, trailer.end_offset, SEEK_SET);
+	uint32_t type, size;
+	while ((uint64_t)ftello(file) < file_size - sizeof(Trailer) && read_record_header(type, size)) {
+		if (type == RECORD_FAMILY) {
+			read_family(size);
+		} else if (type == RECORD_INDEX) {
+			index.resize(size / sizeof(LogIndexEntry));
+			if (fread(index.data(), sizeof(LogIndexEntry), index.size(), file) != index.size()) {
+				index.clear();
+				family_names.clear();
+				return false;
+			}
+		} else {
+			fseeko(file, size, SEEK_CUR);
+		}
+	}
+	data_end = trailer.end_offset;
+	frame_count = trailer.frame_count;
+	end_time = trailer.end_time;
+	return true;
+}
+
+void DetectionLogReader::scan(uint64_t file_size) {
+	index.clear();
+	family_names.clear();
+	frame_count = 0;
+
+	uint64_t offset = sizeof(FileHeader);
+	fseeko(file, offset, SEEK_SET);
+	uint32_t type, size;
+	while (read_record_header(type, size)) {
+		uint64_t next = offset + sizeof(RecordHeader) + size;
+		if (next > file_size) {
+			break; // Torn last record
+		}
+		if (type == RECORD_FRAME) {
+			FrameHeader frame;
+			if (size < sizeof(frame) || fread(&frame, sizeof(frame), 1, file) != 1) {
+				break;
+			}
+			if (frame_count % LOG_INDEX_INTERVAL == 0) {
+				index.push_back({ frame.timestamp_ns, offset });
+			}
+			frame_count++;
+			end_time = frame.timestamp_ns;
+		} else if (type == RECORD_FAMILY) {
+			read_family(size);
+		} else if (type == RECORD_INDEX) {
+			break; // End records of a log whose trailer was torn
+		}
+		offset = next;
+		fseeko(file, offset, SEEK_SET);
+	}
+	data_end = offset;
+}
+
+bool DetectionLogReader::read_record_header(uint32_t &type, uint32_t &size) {
+	RecordHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1) {
+		return false;
+	}
+	type = header.type;
+	size = header.size;
+	return true;
+}
+
+void DetectionLogReader::read_family(uint32_t size) {
+	int32_t family;
+	if (size < sizeof(family) || fread(&family, sizeof(family), 1, file) != 1 || family < 0) {
+		return;
+	}
+	std::string name(size - sizeof(family), '\0');
+	if (fread(&name[0], 1, name.size(), file) != name.size()) {
+		return;
+	}
+	if ((int)family_names.size() <= family) {
+		family_names.resize(family + 1);
+	}
+	family_names[family] = name;
+}
+
+bool DetectionLogReader::next(LogFrame &frame) {
+	if (!file) {
+		return false;
+	}
+	uint32_t type, size;
+	while ((uint64_t)ftello(file) < data_end && read_record_header(type, size)) {
+		if (type != RECORD_FRAME) {
+			fseeko(file, size, SEEK_CUR);
+			continue;
+		}
+		FrameHeader header;
+		if (size < sizeof(header) || fread(&header, sizeof(header), 1, file) != 1 ||
+				size != sizeof(header) + header.count * sizeof(LogMarker)) {
+			return false;
+		}
+		frame.timestamp_ns = header.timestamp_ns;
+		frame.sequence = header.sequence;
+		frame.flags = header.flags;
+		frame.markers.resize(header.count);
+		return fread(frame.markers.data(), sizeof(LogMarker), header.count, file) == header.count;
+	}
+	return false;
+}
+
+bool DetectionLogReader::seek(uint64_t timestamp_ns) {
+	if (!file || index.empty()) {
+		return false;
+	}
+	// Last indexed frame at or before the target, then walk record headers
+	auto it = std::upper_bound(index.begin(), index.end(), timestamp_ns,
+			[](uint64_t t, const LogIndexEntry &entry) { return t < entry.timestamp_ns; });
+	uint64_t offset = it == index.begin() ? index.front().offset : (it - 1)->offset;
+
+	fseeko(file, offset, SEEK_SET);
+	uint32_t type, size;
+	while (offset < data_end && read_record_header(type, size)) {
+		if (type == RECORD_FRAME) {
+			uint64_t frame_time;
+			if (fread(&frame_time, sizeof(frame_time), 1, file) != 1) {
+				break;
+			}
+			if (frame_time >= timestamp_ns) {
+				fseeko(file, offset, SEEK_SET);
+				return true;
+			}
+		}
+		offset += sizeof(RecordHeader) + size;
+		fseeko(file, offset, SEEK_SET);
+	}
+	fseeko(file, data_end, SEEK_SET);
+	return false;
+}
+
+void DetectionLogReader::rewind() {
+	if (file) {
+		fseeko(file, sizeof(FileHeader), SEEK_SET);
+	}
+}
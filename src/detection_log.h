@@ -0,0 +1,134 @@
+#ifndef DETECTION_LOG_H
+#define DETECTION_LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Binary detection history. A log is a header followed by length-prefixed
+// records: one FRAME record per published result set, and FAMILY records
+// naming the family indices used by markers. A clean close appends the family
+// table, a sparse time index (one entry every LOG_INDEX_INTERVAL frames) and
+// a trailer; without them (crash, power loss) the reader rebuilds the index
+// with one pass over the record headers and ignores a torn last record.
+
+static const uint32_t LOG_INDEX_INTERVAL = 64;
+
+// One detected marker, 80 bytes on disk
+struct LogMarker {
+	int32_t id;
+	int32_t family;
+	float corners[8]; // x0 y0 .. x3 y3, pixels
+	float rvec[3];
+	float tvec[3];
+	int32_t hamming; // Decode margin: bits corrected, -1 if unknown
+	float sharpness; // Edge margin: corner sharpness
+	float reprojection_error; // RMS pixels, -1 without a pose
+	uint32_t flags; // LOG_MARKER_* bits
+};
+static_assert(sizeof(LogMarker) == 80, "LogMarker is written to disk as is");
+
+static const uint32_t LOG_MARKER_HAS_POSE = 0x1;
+static const uint32_t LOG_MARKER_AMBIGUOUS = 0x2;
+
+static const uint32_t LOG_FRAME_INCOMPLETE = 0x1;
+
+struct LogFrame {
+	uint64_t timestamp_ns;
+	uint64_t sequence;
+	uint32_t flags; // LOG_FRAME_* bits
+	std::vector<LogMarker> markers;
+};
+
+struct LogIndexEntry {
+	uint64_t timestamp_ns;
+	uint64_t offset; // File offset of a FRAME record
+};
+
+// Appends from the camera thread and writes on its own thread, so a slow
+// disk never stalls detection. Frames arriving while more than
+// max_pending_bytes are still unwritten are dropped and counted.
+class DetectionLogWriter {
+public:
+	~DetectionLogWriter();
+
+	bool open(const std::string &path);
+	// Stops taking frames, writes everything still pending, then the family
+	// table, index and trailer
+	void close();
+	bool is_open() const;
+
+	void set_family_name(int index, const std::string &name);
+	// Families named in this log so far, without taking the lock; 0 after open()
+	int get_family_count() const { return family_count; }
+	void append(uint64_t timestamp_ns, uint64_t sequence, uint32_t flags, const LogMarker *markers, uint32_t count);
+
+	void set_max_pending_bytes(size_t bytes);
+	uint64_t get_frames() const;
+	uint64_t get_dropped_frames() const;
+	uint64_t get_bytes() const;
+
+private:
+	void run();
+	void enqueue_record(uint32_t type, const void *payload, uint32_t size, const void *extra, uint32_t extra_size);
+
+	FILE *file = nullptr; // Set and cleared under the mutex
+	std::thread worker;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::vector<uint8_t> pending; // Filled by append(), swapped out by run()
+	size_t max_pending_bytes = 16 << 20;
+	uint64_t file_offset = 0; // Offset the next enqueued byte will land at
+	uint64_t frames = 0;
+	uint64_t dropped_frames = 0;
+	uint64_t last_time = 0;
+	std::vector<LogIndexEntry> index;
+	std::vector<std::string> family_names;
+	std::atomic<int> family_count{0}; // family_names.size()
+};
+
+class DetectionLogReader {
+public:
+	~DetectionLogReader();
+
+	bool open(const std::string &path);
+	void close();
+	bool is_open() const { return file != nullptr; }
+
+	// Next frame in file order, false at the end of the log
+	bool next(LogFrame &frame);
+	// Position before the first frame at or after `timestamp_ns`. O(log n)
+	// through the index plus at most LOG_INDEX_INTERVAL record headers
+	bool seek(uint64_t timestamp_ns);
+	void rewind();
+
+	uint64_t get_frame_count() const { return frame_count; }
+	uint64_t get_start_time() const { return start_time; }
+	uint64_t get_end_time() const { return end_time; }
+	// True when the log was not closed cleanly and its index was rebuilt
+	bool was_recovered() const { return recovered; }
+	const std::vector<std::string> &get_family_names() const { return family_names; }
+
+private:
+	bool read_trailer(uint64_t file_size);
+	void scan(uint64_t file_size);
+	bool read_record_header(uint32_t &type, uint32_t &size);
+	void read_family(uint32_t size);
+
+	FILE *file = nullptr;
+	uint64_t data_end = 0; // Offset where frame data ends
+	uint64_t frame_count = 0;
+	uint64_t start_time = 0;
+	uint64_t end_time = 0;
+	bool recovered = false;
+	std::vector<LogIndexEntry> index;
+	std::vector<std::string> family_names;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "detection_mask.h"
+#include <opencv2/imgproc.hpp>
+
+void DetectionMask::set_polygons(const std::vector<Polygon> &list, const cv::Matx33d &camera_matrix) {
+	polygons = list;
+	reference = camera_matrix;
+	if (polygons.empty()) {
+		mask.release();
+		active_rows.clear();
+	}
+	dirty = true;
+}
+
+void DetectionMask::update(const cv::Size &frame_size, const cv::Matx33d &camera_matrix) {
+	if (polygons.empty()) {
+		mask.release();
+		return;
+	}
+	if (!dirty && mask.cols == frame_size.width && mask.rows == frame_size.height && camera_matrix == rasterised_for) {
+		return;
+	}
+
+	// Regions added before calibration stay in raw pixels
+	const bool raw_pixels = reference == cv::Matx33d::eye();
+	const cv::Matx33d to_frame = raw_pixels ? cv::Matx33d::eye() : camera_matrix * reference.inv();
+	bool has_include = false;
+	for (const Polygon &polygon : polygons) {
+		has_include |= polygon.include;
+	}
+
+	mask.create(frame_size, CV_8UC1);
+	mask.setTo(cv::Scalar(has_include ? 0 : 255));
+
+	// Inclusions first so an exclusion always wins where they overlap
+	std::vector<std::vector<cv::Point>> scaled(1);
+	for (int pass = 0; pass < 2; pass++) {
+		const bool include = pass == 0;
+		for (const Polygon &polygon : polygons) {
+			if (polygon.include != include) {
+				continue;
+			}
+			scaled[0].clear();
+			for (const cv::Point2f &p : polygon.points) {
+				cv::Vec3d q = to_frame * cv::Vec3d(p.x, p.y, 1.0);
+				scaled[0].push_back(cv::Point(cvRound(q[0] / q[2]), cvRound(q[1] / q[2])));
+			}
+			cv::fillPoly(mask, scaled, cv::Scalar(include ? 255 : 0));
+		}
+	}
+
+	active_rows.assign(frame_size.height, 0);
+	for (int y = 0; y < frame_size.height; y++) {
+		active_rows[y] = cv::countNonZero(mask.row(y)) > 0 ? 1 : 0;
+	}
+
+	rasterised_for = camera_matrix;
+	dirty = false;
+}
@@ -0,0 +1,48 @@
+#ifndef DETECTION_MASK_H
+#define DETECTION_MASK_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Static inclusion/exclusion polygons rasterised into a detection mask.
+//
+// Polygons are given in pixels of the image the reference intrinsics describe.
+// When the frame size or camera matrix changes, the same pixel-to-ray
+// mapping is applied to the vertices (p' = K * K_ref^-1 * p), so an area
+// masked at calibration resolution stays masked after the camera matrix is
+// rescaled for another sensor mode. Rasterisation only happens on a change;
+// per frame the mask costs one AND per thresholded row.
+class DetectionMask {
+public:
+	// Inclusion polygons restrict detection to their union; exclusion
+	// polygons are removed from it
+	struct Polygon {
+		std::vector<cv::Point2f> points; // At least 3
+		bool include;
+	};
+
+	// Replace all polygons. `reference` is the intrinsics their coordinates
+	// refer to; identity means raw pixels. Rasterised by the next update()
+	void set_polygons(const std::vector<Polygon> &list, const cv::Matx33d &reference);
+	bool empty() const { return polygons.empty(); }
+
+	// Re-rasterise if the frame size, intrinsics or polygons changed
+	void update(const cv::Size &frame_size, const cv::Matx33d &camera_matrix);
+	// Same, keeping the intrinsics of the last rasterisation
+	void update(const cv::Size &frame_size) { update(frame_size, rasterised_for); }
+
+	// CV_8UC1, 255 where markers may be detected; empty when there are no polygons
+	const cv::Mat &get() const { return mask; }
+	// Rows with no detectable pixel, which the threshold stage skips
+	bool row_active(int y) const { return active_rows[y] != 0; }
+
+private:
+	std::vector<Polygon> polygons;
+	cv::Matx33d reference = cv::Matx33d::eye();
+	cv::Matx33d rasterised_for = cv::Matx33d::eye();
+	cv::Mat mask;
+	std::vector<uint8_t> active_rows;
+	bool dirty = true;
+};
+
+#endif
@@ -0,0 +1,189 @@
+// Recordings reach gigabytes within a minute; 32-bit Raspberry Pi OS needs 64-bit offsets
+#define _FILE_OFFSET_BITS 64
+
+#include "frame_recording.h"
+#include <algorithm>
+
+namespace {
+
+const uint32_t RECORDING_MAGIC = 0x52465441; // "ATFR"
+const uint32_t RECORDING_VERSION = 1;
+
+struct RecordingHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct FrameHeader {
+	uint64_t timestamp_ns;
+	uint64_t sequence;
+};
+
+}
+
+FrameRecordingWriter::~FrameRecordingWriter() {
+	close();
+}
+
+bool FrameRecordingWriter::open(const std::string &path, int queue_frames) {
+	close();
+	file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	frame_size = cv::Size();
+	max_queued = std::max(1, queue_frames);
+	frames = 0;
+	dropped_frames = 0;
+	stopping = false;
+	worker = std::thread(&FrameRecordingWriter::run, this);
+	return true;
+}
+
+void FrameRecordingWriter::close() {
+	if (!file) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	worker.join();
+	fclose(file);
+	file = nullptr;
+	spare.clear();
+}
+
+bool FrameRecordingWriter::write_header(const cv::Size &size) {
+	RecordingHeader header = { RECORDING_MAGIC, RECORDING_VERSION, (uint32_t)size.width, (uint32_t)size.height };
+	return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+void FrameRecordingWriter::append(const cv::Mat &frame, uint64_t timestamp_ns, uint64_t sequence) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!file) {
+		return;
+	}
+	if (frame_size.empty()) {
+		if (frame.type() != CV_8UC1 || frame.empty() || !write_header(frame.size())) {
+			dropped_frames++;
+			return;
+		}
+		frame_size = frame.size();
+	}
+	if (frame.type() != CV_8UC1 || frame.size() != frame_size || (int)queued.size() >= max_queued) {
+		dropped_frames++;
+		return;
+	}
+
+	RecordedFrame record = { timestamp_ns, sequence, cv::Mat() };
+	if (!spare.empty()) {
+		record.image = std::move(spare.back());
+		spare.pop_back();
+	}
+	lock.unlock();
+	// The copy is the camera thread's only cost; `frame` may be the camera mapping
+	frame.copyTo(record.image);
+	lock.lock();
+	if (!file || stopping) {
+		return;
+	}
+	queued.push_back(std::move(record));
+	frames++;
+	lock.unlock();
+	wake.notify_one();
+}
+
+uint64_t FrameRecordingWriter::get_frames() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return frames;
+}
+
+uint64_t FrameRecordingWriter::get_dropped_frames() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return dropped_frames;
+}
+
+void FrameRecordingWriter::run() {
+	for (;;) {
+		RecordedFrame record;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !queued.empty(); });
+			if (queued.empty()) {
+				return;
+			}
+			record = std::move(queued.front());
+			queued.pop_front();
+		}
+		FrameHeader header = { record.timestamp_ns, record.sequence };
+		fwrite(&header, sizeof(header), 1, file);
+		fwrite(record.image.data, 1, record.image.total(), file);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		spare.push_back(std::move(record.image));
+	}
+}
+
+FrameRecordingReader::~FrameRecordingReader() {
+	close();
+}
+
+bool FrameRecordingReader::open(const std::string &path) {
+	close();
+	file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+	RecordingHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != RECORDING_MAGIC ||
+			header.version != RECORDING_VERSION || header.width == 0 || header.height == 0) {
+		close();
+		return false;
+	}
+	frame_size = cv::Size(header.width, header.height);
+
+	// A torn last frame (recording killed mid-write) is not counted
+	fseeko(file, 0, SEEK_END);
+	uint64_t data = ftello(file) - sizeof(header);
+	frame_count = data / (sizeof(FrameHeader) + frame_size.area());
+	rewind();
+	return true;
+}
+
+void FrameRecordingReader::close() {
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+	frame_size = cv::Size();
+	frame_count = 0;
+}
+
+bool FrameRecordingReader::next(RecordedFrame &frame) {
+	if (!file) {
+		return false;
+	}
+	FrameHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1) {
+		return false;
+	}
+	frame.image.create(frame_size, CV_8UC1);
+	if (fread(frame.image.data, 1, frame.image.total(), file) != frame.image.total()) {
+		return false;
+	}
+	frame.timestamp_ns = header.timestamp_ns;
+	frame.sequence = header.sequence;
+	return true;
+}
+
+bool FrameRecordingReader::seek_frame(uint64_t index) {
+	if (!file || index > frame_count) {
+		return false;
+	}
+	uint64_t offset = sizeof(RecordingHeader) + index * (sizeof(FrameHeader) + frame_size.area());
+	return fseeko(file, offset, SEEK_SET) == 0;
+}
@@ -0,0 +1,81 @@
+#ifndef FRAME_RECORDING_H
+#define FRAME_RECORDING_H
+
+#include <opencv2/core.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Raw 8-bit camera frames with their sensor timestamps, for replay. A header
+// is followed by fixed-size records (timestamp, sequence, pixels), so frame i
+// is at a computable offset and no index is needed.
+
+struct RecordedFrame {
+	uint64_t timestamp_ns;
+	uint64_t sequence;
+	cv::Mat image; // CV_8UC1
+};
+
+// Copies frames on the camera thread and writes them on its own thread.
+// When max_queued frames are still unwritten, new frames are dropped and
+// counted rather than stalling the camera.
+class FrameRecordingWriter {
+public:
+	~FrameRecordingWriter();
+
+	// The frame size is taken from the first frame; later frames of another
+	// size or type are rejected
+	bool open(const std::string &path, int max_queued = 32);
+	void close();
+	bool is_open() const { return file != nullptr; }
+
+	void append(const cv::Mat &frame, uint64_t timestamp_ns, uint64_t sequence);
+
+	uint64_t get_frames() const;
+	uint64_t get_dropped_frames() const;
+
+private:
+	void run();
+	bool write_header(const cv::Size &size);
+
+	FILE *file = nullptr;
+	std::thread worker;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	cv::Size frame_size;
+	std::deque<RecordedFrame> queued;
+	std::vector<cv::Mat> spare; // Written frames' buffers, reused by append()
+	int max_queued = 32;
+	uint64_t frames = 0;
+	uint64_t dropped_frames = 0;
+};
+
+class FrameRecordingReader {
+public:
+	~FrameRecordingReader();
+
+	bool open(const std::string &path);
+	void close();
+	bool is_open() const { return file != nullptr; }
+
+	// Next frame in recording order; reuses frame.image when the size matches
+	bool next(RecordedFrame &frame);
+	bool seek_frame(uint64_t index);
+	void rewind() { seek_frame(0); }
+
+	uint64_t get_frame_count() const { return frame_count; }
+	cv::Size get_frame_size() const { return frame_size; }
+
+private:
+	FILE *file = nullptr;
+	cv::Size frame_size;
+	uint64_t frame_count = 0;
+};
+
+#endif
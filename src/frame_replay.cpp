@@ -0,0 +1,217 @@
+#include "frame_replay.h"
+#include "frame_trace.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Sleep on the condition variable until this close to the due time, then spin
+const auto SPIN_WINDOW = std::chrono::microseconds(300);
+
+double microseconds(FrameReplay::Clock::duration d) {
+	return std::chrono::duration<double, std::micro>(d).count();
+}
+
+}
+
+void FrameReplay::Jitter::clear() {
+	std::fill(counts, counts + BUCKETS, 0);
+	samples = 0;
+	total = 0.0;
+	largest = 0.0;
+}
+
+int FrameReplay::Jitter::bucket(double us) {
+	if (!(us >= 1.0)) {
+		return 0;
+	}
+	return std::min(BUCKETS - 1, 1 + (int)(std::log2(us) * STEPS_PER_OCTAVE));
+}
+
+double FrameReplay::Jitter::bucket_upper(int index) {
+	return index == 0 ? 1.0 : std::exp2((double)index / STEPS_PER_OCTAVE);
+}
+
+void FrameReplay::Jitter::add(double us) {
+	counts[bucket(us)]++;
+	samples++;
+	total += us;
+	largest = std::max(largest, us);
+}
+
+void FrameReplay::Jitter::summarize(double &mean, double &p99, double &max) const {
+	mean = p99 = max = 0.0;
+	if (samples == 0) {
+		return;
+	}
+	mean = total / samples;
+	max = largest;
+
+	// Upper edge of the bucket holding the 99th percentile, never past the max
+	uint64_t rank = std::min(samples - 1, samples * 99 / 100);
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		seen += counts[i];
+		if (seen > rank) {
+			p99 = std::min(bucket_upper(i), largest);
+			break;
+		}
+	}
+}
+
+FrameReplay::~FrameReplay() {
+	stop();
+}
+
+bool FrameReplay::start(const std::string &path, Sink frame_sink, double replay_speed, int buffer_count, bool replay_loop) {
+	stop();
+	if (!reader.open(path) || reader.get_frame_count() == 0) {
+		reader.close();
+		return false;
+	}
+
+	sink = std::move(frame_sink);
+	speed = replay_speed > 0.0 ? replay_speed : 1.0;
+	loop = replay_loop;
+	buffers.assign(std::max(1, buffer_count), Buffer());
+	free_buffers.clear();
+	for (int i = (int)buffers.size() - 1; i >= 0; i--) {
+		free_buffers.push_back(i);
+	}
+	ready.clear();
+	released = dropped = delivered = 0;
+	pacing_us.clear();
+	latency_us.clear();
+	pacing_done = false;
+
+	running = true;
+	pacer = std::thread(&FrameReplay::pace, this);
+	delivery = std::thread(&FrameReplay::deliver, this);
+	return true;
+}
+
+void FrameReplay::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	wake.notify_all();
+	if (pacer.joinable()) {
+		pacer.join();
+	}
+	if (delivery.joinable()) {
+		delivery.join();
+	}
+	reader.close();
+}
+
+FrameReplay::Report FrameReplay::report() const {
+	Report result = {};
+	std::lock_guard<std::mutex> lock(mutex);
+	result.frames = released;
+	result.delivered = delivered;
+	result.dropped = dropped;
+	pacing_us.summarize(result.pacing_mean_us, result.pacing_p99_us, result.pacing_max_us);
+	latency_us.summarize(result.latency_mean_us, result.latency_p99_us, result.latency_max_us);
+	return result;
+}
+
+void FrameReplay::wait_until(Clock::time_point due) {
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		wake.wait_until(lock, due - SPIN_WINDOW, [this]() { return !running; });
+	}
+	while (running && Clock::now() < due) {
+	}
+}
+
+void FrameReplay::pace() {
+	RecordedFrame staging;
+	Clock::time_point base = Clock::now();
+	Clock::time_point last_due = base;
+	uint64_t first_timestamp = 0;
+	uint64_t last_timestamp = 0;
+	Clock::duration interval = std::chrono::milliseconds(10);
+	bool first = true;
+
+	while (running) {
+		// The next frame is read from disk before its due time, never after
+		if (!reader.next(staging)) {
+			if (!loop || first) {
+				break;
+			}
+			// The next pass follows the last frame by one recorded frame interval
+			reader.rewind();
+			base = last_due + interval;
+			first = true;
+			continue;
+		}
+		if (first) {
+			first_timestamp = staging.timestamp_ns;
+		} else if (staging.timestamp_ns > last_timestamp) {
+			interval = std::chrono::duration_cast<Clock::duration>(
+				std::chrono::nanoseconds((int64_t)((staging.timestamp_ns - last_timestamp) / speed)));
+		}
+		first = false;
+		last_timestamp = staging.timestamp_ns;
+
+		int64_t offset_ns = (int64_t)((int64_t)(staging.timestamp_ns - first_timestamp) / speed);
+		Clock::time_point due = base + std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(offset_ns));
+		last_due = due;
+		wait_until(due);
+		if (!running) {
+			break;
+		}
+
+		Clock::time_point release_time = Clock::now();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			released++;
+			pacing_us.add(microseconds(release_time - due));
+			if (free_buffers.empty()) {
+				// Like the sensor with no request queued: the frame is lost
+				dropped++;
+				continue;
+			}
+			int index = free_buffers.back();
+			free_buffers.pop_back();
+			std::swap(buffers[index].frame, staging);
+			buffers[index].due = due;
+			ready.push_back(index);
+		}
+		wake.notify_all();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	pacing_done = true;
+	wake.notify_all();
+}
+
+void FrameReplay::deliver() {
+	FrameTrace::set_thread_name("replay");
+	for (;;) {
+		int index;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return !running || pacing_done || !ready.empty(); });
+			if (!running) {
+				return;
+			}
+			if (ready.empty()) {
+				break; // Pacing finished and everything was delivered
+			}
+			index = ready.front();
+			ready.pop_front();
+		}
+
+		Buffer &buffer = buffers[index];
+		double latency = microseconds(Clock::now() - buffer.due);
+		sink(buffer.frame.image, buffer.frame.timestamp_ns, buffer.frame.sequence);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		latency_us.add(latency);
+		delivered++;
+		free_buffers.push_back(index);
+	}
+	running = false;
+}
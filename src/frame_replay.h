@@ -0,0 +1,97 @@
+#ifndef FRAME_REPLAY_H
+#define FRAME_REPLAY_H
+
+#include "frame_recording.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+// Plays a FrameRecordingReader back in real time. A pacer thread stands in
+// for the sensor: it releases each frame at its recorded timestamp (scaled by
+// `speed`) on the monotonic clock, into one of a fixed pool of buffers like
+// the camera's request pool, and drops the frame if every buffer is still
+// busy. A delivery thread hands the frames to the sink in order, the way
+// libcamera completes requests, so the pipeline's queueing and drops follow
+// the recording's timing rather than the dev machine's speed.
+class FrameReplay {
+public:
+	using Clock = std::chrono::steady_clock;
+	using Sink = std::function<void(cv::Mat &frame, uint64_t timestamp_ns, uint64_t sequence)>;
+
+	struct Report {
+		uint64_t frames; // Released by the pacer
+		uint64_t delivered;
+		uint64_t dropped; // No free buffer at the frame's time
+		// Pacer release time - scheduled time: how closely pacing matched the recording
+		double pacing_mean_us;
+		double pacing_p99_us;
+		double pacing_max_us;
+		// Sink start - scheduled time: queueing in front of the pipeline
+		double latency_mean_us;
+		double latency_p99_us;
+		double latency_max_us;
+	};
+
+	~FrameReplay();
+
+	bool start(const std::string &path, Sink sink, double speed = 1.0, int buffers = 4, bool loop = false);
+	void stop();
+	// False once a non-looping replay delivered its last frame
+	bool is_running() const { return running; }
+	Report report() const;
+
+private:
+	struct Buffer {
+		RecordedFrame frame;
+		Clock::time_point due;
+	};
+
+	// Running mean and max with a log-spaced histogram for the p99, so a
+	// looping replay reports in constant memory however long it runs.
+	// Buckets are an eighth of an octave wide (about 9 %) from 1 us to 16 s.
+	class Jitter {
+	public:
+		void clear();
+		void add(double us);
+		void summarize(double &mean, double &p99, double &max) const;
+
+	private:
+		static constexpr int STEPS_PER_OCTAVE = 8;
+		static constexpr int BUCKETS = 24 * STEPS_PER_OCTAVE + 1; // Bucket 0 holds everything under 1 us
+		static int bucket(double us);
+		static double bucket_upper(int bucket);
+
+		uint64_t counts[BUCKETS] = {};
+		uint64_t samples = 0;
+		double total = 0.0;
+		double largest = 0.0;
+	};
+
+	void pace();
+	void deliver();
+	void wait_until(Clock::time_point due);
+
+	FrameRecordingReader reader;
+	Sink sink;
+	double speed = 1.0;
+	bool loop = false;
+
+	std::vector<Buffer> buffers;
+	std::vector<int> free_buffers;
+	std::deque<int> ready; // Released frames in order, waiting for the sink
+
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::atomic<bool> running{false};
+	bool pacing_done = false;
+	std::thread pacer;
+	std::thread delivery;
+
+	uint64_t dropped = 0;
+	uint64_t delivered = 0;
+	uint64_t released = 0;
+	Jitter pacing_us;
+	Jitter latency_us;
+};
+
+#endif
@@ -0,0 +1,301 @@
+#include "frame_share.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+
+FrameShareServer::~FrameShareServer() {
+	stop();
+}
+
+bool FrameShareServer::start(const std::string &path, int timeout) {
+	stop();
+	if (path.size() >= sizeof(sockaddr_un::sun_path)) {
+		return false;
+	}
+
+	listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0) {
+		return false;
+	}
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	// A socket file left behind by an earlier run would make bind() fail
+	unlink(path.c_str());
+	if (bind(listen_fd, (const sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 8) != 0 ||
+			pipe2(wake_fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+		::close(listen_fd);
+		listen_fd = -1;
+		unlink(path.c_str());
+		return false;
+	}
+
+	socket_path = path;
+	set_timeout_ms(timeout);
+	running = true;
+	worker = std::thread(&FrameShareServer::run, this);
+	return true;
+}
+
+void FrameShareServer::stop() {
+	if (!running) {
+		return;
+	}
+	running = false;
+	wake();
+	worker.join();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Held& entry : held) {
+		entry.release();
+	}
+	held.clear();
+	for (int client : clients) {
+		::close(client);
+	}
+	clients.clear();
+	::close(listen_fd);
+	::close(wake_fds[0]);
+	::close(wake_fds[1]);
+	listen_fd = wake_fds[0] = wake_fds[1] = -1;
+	unlink(socket_path.c_str());
+}
+
+bool FrameShareServer::share(const Frame &frame, std::function<void()> release) {
+	if (!running || frame.planes.empty() || frame.planes.size() > APRILTAG_FRAME_SHARE_MAX_PLANES) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (clients.empty() || (int)held.size() >= max_held) {
+		return false;
+	}
+
+	apriltag_frame_message msg = {};
+	msg.magic = APRILTAG_FRAME_SHARE_MAGIC;
+	msg.version = APRILTAG_FRAME_SHARE_VERSION;
+	msg.frame_id = next_frame_id;
+	msg.sequence = frame.sequence;
+	msg.timestamp_ns = frame.timestamp_ns;
+	msg.width = frame.width;
+	msg.height = frame.height;
+	msg.stride = frame.stride;
+	msg.fourcc = frame.fourcc;
+	msg.timeout_ms = timeout_ms;
+	msg.plane_count = frame.planes.size();
+
+	union {
+		char buffer[CMSG_SPACE(sizeof(int) * APRILTAG_FRAME_SHARE_MAX_PLANES)];
+		cmsghdr align;
+	} control = {};
+	int *fds = nullptr;
+	iovec iov = { &msg, sizeof(msg) };
+	msghdr header = {};
+	header.msg_iov = &iov;
+	header.msg_iovlen = 1;
+	header.msg_control = control.buffer;
+	header.msg_controllen = CMSG_SPACE(sizeof(int) * frame.planes.size());
+	cmsghdr *cmsg = CMSG_FIRSTHDR(&header);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * frame.planes.size());
+	fds = reinterpret_cast<int *>(CMSG_DATA(cmsg));
+	for (size_t i = 0; i < frame.planes.size(); i++) {
+		msg.planes[i] = { frame.planes[i].offset, frame.planes[i].length };
+		fds[i] = frame.planes[i].fd;
+	}
+
+	// A client whose queue is full simply misses this frame; the camera
+	// thread never waits for a reader
+	Held entry;
+	for (int client : clients) {
+		if (sendmsg(client, &header, MSG_DONTWAIT | MSG_NOSIGNAL) == (ssize_t)sizeof(msg)) {
+			entry.holders.push_back(client);
+		}
+	}
+	if (entry.holders.empty()) {
+		return false;
+	}
+
+	entry.frame_id = next_frame_id++;
+	entry.deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+	entry.release = std::move(release);
+	bool was_idle = held.empty();
+	held.push_back(std::move(entry));
+	shared_frames++;
+
+	// With frames already held the worker is waiting on an earlier deadline
+	if (was_idle) {
+		wake();
+	}
+	return true;
+}
+
+void FrameShareServer::drop_held() {
+	std::lock_guard<std::mutex> lock(mutex);
+	held.clear();
+}
+
+void FrameShareServer::set_timeout_ms(int ms) {
+	std::lock_guard<std::mutex> lock(mutex);
+	timeout_ms = std::max(1, ms);
+}
+
+int FrameShareServer::get_timeout_ms() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return timeout_ms;
+}
+
+void FrameShareServer::set_max_held(int frames) {
+	std::lock_guard<std::mutex> lock(mutex);
+	max_held = std::max(1, frames);
+}
+
+int FrameShareServer::get_max_held() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return max_held;
+}
+
+int FrameShareServer::get_client_count() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return (int)clients.size();
+}
+
+uint64_t FrameShareServer::get_shared_frames() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return shared_frames;
+}
+
+uint64_t FrameShareServer::get_timeouts() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return timeouts;
+}
+
+void FrameShareServer::run() {
+	std::vector<pollfd> fds;
+	while (running) {
+		int wait_ms;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			fds.assign({ { listen_fd, POLLIN, 0 }, { wake_fds[0], POLLIN, 0 } });
+			for (int client : clients) {
+				fds.push_back({ client, POLLIN, 0 });
+			}
+			wait_ms = poll_timeout_ms(Clock::now());
+		}
+
+		if (poll(fds.data(), fds.size(), wait_ms) < 0 && errno != EINTR) {
+			break;
+		}
+		if (fds[1].revents & POLLIN) {
+			char drain[64];
+			while (read(wake_fds[0], drain, sizeof(drain)) > 0) {
+			}
+		}
+		if (fds[0].revents & POLLIN) {
+			accept_clients();
+		}
+		for (size_t i = 2; i < fds.size(); i++) {
+			if (fds[i].revents == 0) {
+				continue;
+			}
+			if (!read_releases(fds[i].fd) || (fds[i].revents & (POLLHUP | POLLERR))) {
+				disconnect(fds[i].fd);
+			}
+		}
+		expire(Clock::now());
+	}
+}
+
+void FrameShareServer::accept_clients() {
+	int client;
+	while ((client = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		std::lock_guard<std::mutex> lock(mutex);
+		clients.push_back(client);
+	}
+}
+
+bool FrameShareServer::read_releases(int client) {
+	apriltag_frame_release release;
+	for (;;) {
+		ssize_t received = recv(client, &release, sizeof(release), MSG_DONTWAIT);
+		if (received < 0) {
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+		if (received == 0) {
+			return false;
+		}
+		if (received == sizeof(release) && release.magic == APRILTAG_FRAME_SHARE_MAGIC) {
+			std::lock_guard<std::mutex> lock(mutex);
+			release_holder(client, release.frame_id);
+		}
+	}
+}
+
+// Caller holds the mutex. Releases of frames that already timed out find
+// nothing and are ignored
+void FrameShareServer::release_holder(int client, uint64_t frame_id) {
+	for (size_t i = 0; i < held.size(); i++) {
+		if (held[i].frame_id != frame_id) {
+			continue;
+		}
+		std::vector<int>& holders = held[i].holders;
+		holders.erase(std::remove(holders.begin(), holders.end(), client), holders.end());
+		if (holders.empty()) {
+			held[i].release();
+			held.erase(held.begin() + i);
+		}
+		return;
+	}
+}
+
+void FrameShareServer::disconnect(int client) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < held.size();) {
+		std::vector<int>& holders = held[i].holders;
+		holders.erase(std::remove(holders.begin(), holders.end(), client), holders.end());
+		if (holders.empty()) {
+			held[i].release();
+			held.erase(held.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+	::close(client);
+}
+
+void FrameShareServer::expire(Clock::time_point now) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < held.size();) {
+		if (held[i].deadline <= now) {
+			held[i].release();
+			held.erase(held.begin() + i);
+			timeouts++;
+		} else {
+			i++;
+		}
+	}
+}
+
+// Caller holds the mutex
+int FrameShareServer::poll_timeout_ms(Clock::time_point now) const {
+	if (held.empty()) {
+		return -1;
+	}
+	Clock::time_point deadline = held.front().deadline;
+	for (const Held& entry : held) {
+		deadline = std::min(deadline, entry.deadline);
+	}
+	auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+	return (int)std::max<int64_t>(0, remaining + 1);
+}
+
+void FrameShareServer::wake() {
+	char byte = 0;
+	if (write(wake_fds[1], &byte, 1) < 0) {
+		// Pipe full: the worker is already due to wake up
+	}
+}
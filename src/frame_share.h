@@ -0,0 +1,97 @@
+#ifndef FRAME_SHARE_H
+#define FRAME_SHARE_H
+
+#include "apriltag_frame_share.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Server side of apriltag_frame_share.h: hands camera buffers to other
+// processes as dmabuf fds and tells the owner when every client is done with
+// them. Frames are shared from the camera thread; a worker thread accepts
+// clients, collects releases and enforces the timeout.
+class FrameShareServer {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Plane {
+		int fd;
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	struct Frame {
+		uint64_t sequence;
+		uint64_t timestamp_ns;
+		uint32_t width;
+		uint32_t height;
+		uint32_t stride;
+		uint32_t fourcc;
+		std::vector<Plane> planes;
+	};
+
+	~FrameShareServer();
+
+	bool start(const std::string &path, int timeout_ms);
+	// Disconnects all clients and releases every held frame
+	void stop();
+	bool is_running() const { return running; }
+
+	// Send `frame` to every connected client. Returns false if no client took
+	// it (none connected, all busy, or max_held frames already out), in which
+	// case the caller still owns the buffer. Otherwise `release` runs once
+	// (unless drop_held() forgets the frame): when the last client released
+	// it, disconnected, or the timeout passed. It runs with the server locked, on either thread, and
+	// must not call back into the server.
+	bool share(const Frame &frame, std::function<void()> release);
+
+	// Forget held frames without releasing them, before their buffers go away
+	void drop_held();
+
+	void set_timeout_ms(int ms);
+	int get_timeout_ms() const;
+	void set_max_held(int frames);
+	int get_max_held() const;
+
+	int get_client_count() const;
+	uint64_t get_shared_frames() const;
+	uint64_t get_timeouts() const;
+
+private:
+	struct Held {
+		uint64_t frame_id;
+		std::vector<int> holders; // Client sockets that have not released it yet
+		Clock::time_point deadline;
+		std::function<void()> release;
+	};
+
+	void run();
+	void accept_clients();
+	bool read_releases(int client);
+	void release_holder(int client, uint64_t frame_id);
+	void disconnect(int client);
+	void expire(Clock::time_point now);
+	int poll_timeout_ms(Clock::time_point now) const;
+	void wake();
+
+	mutable std::mutex mutex;
+	std::vector<int> clients;
+	std::vector<Held> held;
+	uint64_t next_frame_id = 1;
+	uint64_t shared_frames = 0;
+	uint64_t timeouts = 0;
+	int timeout_ms = 100;
+	int max_held = 2;
+
+	std::atomic<bool> running{false};
+	std::thread worker;
+	std::string socket_path;
+	int listen_fd = -1;
+	int wake_fds[2] = { -1, -1 };
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "frame_trace.h"
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+std::atomic<bool> FrameTrace::enabled{false};
+
+namespace {
+
+struct Slot {
+	std::atomic<const char *> name;
+	std::atomic<uint64_t> begin_ns;
+	std::atomic<uint64_t> end_ns;
+	std::atomic<uint64_t> frame;
+};
+
+struct Span {
+	const char *name;
+	uint64_t begin_ns;
+	uint64_t end_ns;
+	uint64_t frame;
+};
+
+// One thread's ring. `begun` counts a span before its slot is overwritten,
+// `written` after, so a reader can tell which slots it read whole
+struct ThreadBuffer {
+	std::unique_ptr<Slot[]> slots{ new Slot[TRACE_EVENTS_PER_THREAD]() };
+	std::atomic<uint64_t> begun{0};
+	std::atomic<uint64_t> written{0};
+	std::atomic<const char *> name{nullptr};
+	long tid = 0;
+	bool in_use = false; // Guarded by registry_mutex
+};
+
+std::mutex registry_mutex;
+std::deque<ThreadBuffer> buffers; // Never shrinks; rings of exited threads are reused
+std::atomic<uint64_t> start_ns{0};
+
+// Gives the ring back when its thread exits
+struct ThreadHandle {
+	ThreadBuffer *buffer = nullptr;
+	const char *name = nullptr;
+	~ThreadHandle() {
+		if (buffer) {
+			std::lock_guard<std::mutex> lock(registry_mutex);
+			buffer->in_use = false;
+		}
+	}
+};
+
+thread_local ThreadHandle handle;
+
+ThreadBuffer *acquire_buffer() {
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	uint64_t since = start_ns.load(std::memory_order_relaxed);
+	ThreadBuffer *buffer = nullptr;
+	for (ThreadBuffer &candidate : buffers) {
+		if (candidate.in_use) {
+			continue;
+		}
+		// An exited thread's ring is kept while it holds spans of this trace
+		uint64_t written = candidate.written.load(std::memory_order_relaxed);
+		if (written == 0 || candidate.slots[(written - 1) % TRACE_EVENTS_PER_THREAD].end_ns.load(std::memory_order_relaxed) < since) {
+			buffer = &candidate;
+			break;
+		}
+	}
+	if (!buffer) {
+		buffers.emplace_back();
+		buffer = &buffers.back();
+	}
+	buffer->begun.store(0, std::memory_order_relaxed);
+	buffer->written.store(0, std::memory_order_relaxed);
+	buffer->name.store(handle.name, std::memory_order_relaxed);
+	buffer->tid = (long)syscall(SYS_gettid);
+	buffer->in_use = true;
+	return buffer;
+}
+
+}
+
+void FrameTrace::start() {
+	start_ns.store(now_ns(), std::memory_order_relaxed);
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+void FrameTrace::stop() {
+	enabled.store(false, std::memory_order_relaxed);
+}
+
+void FrameTrace::set_thread_name(const char *name) {
+	handle.name = name;
+	if (handle.buffer) {
+		handle.buffer->name.store(name, std::memory_order_relaxed);
+	}
+}
+
+uint64_t FrameTrace::now_ns() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameTrace::record(const char *name, uint64_t begin_ns, uint64_t end_ns, uint64_t frame) {
+	if (!handle.buffer) {
+		handle.buffer = acquire_buffer();
+	}
+	ThreadBuffer &buffer = *handle.buffer;
+	uint64_t index = buffer.written.load(std::memory_order_relaxed);
+	buffer.begun.store(index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Slot &slot = buffer.slots[index % TRACE_EVENTS_PER_THREAD];
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.begin_ns.store(begin_ns, std::memory_order_relaxed);
+	slot.end_ns.store(end_ns, std::memory_order_relaxed);
+	slot.frame.store(frame, std::memory_order_relaxed);
+	buffer.written.store(index + 1, std::memory_order_release);
+}
+
+int64_t FrameTrace::dump(const std::string &path) {
+	FILE *file = fopen(path.c_str(), "w");
+	if (!file) {
+		return -1;
+	}
+
+	uint64_t since = start_ns.load(std::memory_order_relaxed);
+	long pid = (long)getpid();
+	int64_t count = 0;
+	bool first = true;
+	std::vector<Span> spans;
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	for (ThreadBuffer &buffer : buffers) {
+		uint64_t end = buffer.written.load(std::memory_order_acquire);
+		uint64_t begin = end > TRACE_EVENTS_PER_THREAD ? end - TRACE_EVENTS_PER_THREAD : 0;
+		spans.clear();
+		for (uint64_t i = begin; i < end; i++) {
+			const Slot &slot = buffer.slots[i % TRACE_EVENTS_PER_THREAD];
+			spans.push_back({ slot.name.load(std::memory_order_relaxed), slot.begin_ns.load(std::memory_order_relaxed),
+				slot.end_ns.load(std::memory_order_relaxed), slot.frame.load(std::memory_order_relaxed) });
+		}
+
+		// Slots the thread started overwriting meanwhile may be torn
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t begun = buffer.begun.load(std::memory_order_relaxed);
+		uint64_t intact = begun > TRACE_EVENTS_PER_THREAD ? begun - TRACE_EVENTS_PER_THREAD : 0;
+
+		const char *name = buffer.name.load(std::memory_order_relaxed);
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n", pid, buffer.tid, name ? name : "thread");
+		first = false;
+
+		for (size_t k = 0; k < spans.size(); k++) {
+			const Span &span = spans[k];
+			if (begin + k < intact || span.begin_ns < since) {
+				continue;
+			}
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld",
+				span.name, (span.begin_ns - since) / 1000.0, (span.end_ns - span.begin_ns) / 1000.0, pid, buffer.tid);
+			if (span.frame != TRACE_NO_FRAME) {
+				fprintf(file, ",\"args\":{\"frame\":%" PRIu64 "}", span.frame);
+			}
+			fprintf(file, "}");
+			count++;
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+	return ok ? count : -1;
+}
@@ -0,0 +1,62 @@
+#ifndef FRAME_TRACE_H
+#define FRAME_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Begin/end spans of the frame pipeline, dumped as Chrome trace-event JSON
+// for chrome://tracing or ui.perfetto.dev, to show how frames overlap and
+// where threads wait on each other.
+//
+// Each thread records into its own ring of TRACE_EVENTS_PER_THREAD spans,
+// so recording takes no lock and the newest spans replace the oldest. A
+// dump reads the rings while they are written and skips any span that was
+// overwritten during the read. Spans are process-wide: the detector, its
+// engine and the helper threads all record into the same trace.
+
+static const size_t TRACE_EVENTS_PER_THREAD = 16384;
+static const uint64_t TRACE_NO_FRAME = ~(uint64_t)0;
+
+class FrameTrace {
+public:
+	// Starting discards the spans of earlier runs
+	static void start();
+	static void stop();
+	static bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// Shown for the calling thread; `name` must outlive the trace
+	static void set_thread_name(const char *name);
+
+	static uint64_t now_ns();
+	// `name` must outlive the trace, normally a string literal
+	static void record(const char *name, uint64_t begin_ns, uint64_t end_ns, uint64_t frame);
+
+	// Spans since start(), with the threads' names; returns the span count or -1
+	static int64_t dump(const std::string &path);
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+// Records the enclosing scope as one span while tracing is on
+class TraceSpan {
+public:
+	explicit TraceSpan(const char *span_name, uint64_t span_frame = TRACE_NO_FRAME) :
+			name(FrameTrace::is_enabled() ? span_name : nullptr), frame(span_frame), begin(name ? FrameTrace::now_ns() : 0) {}
+	~TraceSpan() {
+		if (name) {
+			FrameTrace::record(name, begin, FrameTrace::now_ns(), frame);
+		}
+	}
+	TraceSpan(const TraceSpan &) = delete;
+	TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+	const char *name;
+	uint64_t frame;
+	uint64_t begin;
+};
+
+#endif
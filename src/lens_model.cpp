@@ -0,0 +1,113 @@
+#include "lens_model.h"
+#include <opencv2/calib3d.hpp>
+#include <cmath>
+
+bool LensModel::valid_coefficient_count(Model model, int count) {
+	if (model == MODEL_FISHEYE) {
+		return count == 4;
+	}
+	return count == 4 || count == 5 || count == 8 || count == 12 || count == 14;
+}
+
+void LensModel::set(const cv::Matx33d &matrix, const cv::Mat &new_coeffs, Model new_model) {
+	bool same = matrix == camera_matrix && new_model == model && new_coeffs.total() == coeffs.total();
+	for (size_t i = 0; same && i < coeffs.total(); i++) {
+		same = new_coeffs.at<double>((int)i) == coeffs.at<double>((int)i);
+	}
+	if (same) {
+		return;
+	}
+	camera_matrix = matrix;
+	new_coeffs.reshape(1, (int)new_coeffs.total()).copyTo(coeffs);
+	model = new_model;
+	dirty = true;
+}
+
+void LensModel::prepare(const cv::Size &frame_size) {
+	if (!dirty && frame_size == table_frame) {
+		return;
+	}
+
+	// 4 px spacing keeps the pinhole models under 0.03 px of interpolation
+	// error; the fisheye mapping bends faster towards the edges
+	table_step = model == MODEL_FISHEYE ? 2 : 4;
+
+	// Enough nodes to cover the last pixel row and column
+	table_cols = (frame_size.width - 1 + table_step - 1) / table_step + 1;
+	table_rows = (frame_size.height - 1 + table_step - 1) / table_step + 1;
+	std::vector<cv::Point2f> nodes;
+	nodes.reserve((size_t)table_cols * table_rows);
+	for (int y = 0; y < table_rows; y++) {
+		for (int x = 0; x < table_cols; x++) {
+			nodes.push_back(cv::Point2f((float)(x * table_step), (float)(y * table_step)));
+		}
+	}
+	if (model == MODEL_FISHEYE) {
+		cv::fisheye::undistortPoints(nodes, table, camera_matrix, coeffs);
+	} else {
+		// Converged tightly once here, instead of the default 5 iterations per frame
+		cv::undistortPoints(nodes, table, camera_matrix, coeffs, cv::noArray(), cv::noArray(),
+			cv::TermCriteria(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, 50, 1e-10));
+	}
+
+	table_frame = frame_size;
+	dirty = false;
+}
+
+void LensModel::undistort(const std::vector<cv::Point2f> &pixels, std::vector<cv::Point2f> &normalized) const {
+	normalized.resize(pixels.size());
+	if (dirty || table.empty()) {
+		undistort_direct(pixels, normalized);
+		return;
+	}
+
+	float max_x = (float)((table_cols - 1) * table_step);
+	float max_y = (float)((table_rows - 1) * table_step);
+	outside.clear();
+	for (size_t i = 0; i < pixels.size(); i++) {
+		const cv::Point2f &p = pixels[i];
+		if (!(p.x >= 0.0f && p.y >= 0.0f && p.x < max_x && p.y < max_y)) {
+			outside.push_back(p);
+			continue;
+		}
+		float gx = p.x / table_step, gy = p.y / table_step;
+		int ix = (int)gx, iy = (int)gy;
+		float fx = gx - ix, fy = gy - iy;
+		const cv::Point2f *row = &table[(size_t)iy * table_cols + ix];
+		const cv::Point2f *next = row + table_cols;
+		normalized[i] = (row[0] * (1.0f - fx) + row[1] * fx) * (1.0f - fy) + (next[0] * (1.0f - fx) + next[1] * fx) * fy;
+	}
+
+	// Corners refined to just past the frame edge
+	if (!outside.empty()) {
+		undistort_direct(outside, outside_normalized);
+		size_t k = 0;
+		for (size_t i = 0; i < pixels.size(); i++) {
+			const cv::Point2f &p = pixels[i];
+			if (!(p.x >= 0.0f && p.y >= 0.0f && p.x < max_x && p.y < max_y)) {
+				normalized[i] = outside_normalized[k++];
+			}
+		}
+	}
+}
+
+void LensModel::undistort_direct(const std::vector<cv::Point2f> &pixels, std::vector<cv::Point2f> &normalized) const {
+	if (pixels.empty()) {
+		normalized.clear();
+		return;
+	}
+	if (model == MODEL_FISHEYE) {
+		cv::fisheye::undistortPoints(pixels, normalized, camera_matrix, coeffs);
+	} else {
+		cv::undistortPoints(pixels, normalized, camera_matrix, coeffs);
+	}
+}
+
+void LensModel::project(const std::vector<cv::Point3f> &points, const cv::Vec3d &rvec, const cv::Vec3d &tvec,
+		std::vector<cv::Point2f> &pixels) const {
+	if (model == MODEL_FISHEYE) {
+		cv::fisheye::projectPoints(points, pixels, rvec, tvec, camera_matrix, coeffs);
+	} else {
+		cv::projectPoints(points, rvec, tvec, camera_matrix, coeffs, pixels);
+	}
+}
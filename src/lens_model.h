@@ -0,0 +1,58 @@
+#ifndef LENS_MODEL_H
+#define LENS_MODEL_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Camera intrinsics with any OpenCV distortion model: the pinhole model with
+// 4, 5, 8, 12 or 14 coefficients (up to rational, thin prism and tilted), or
+// the 4-coefficient fisheye model.
+//
+// Corner undistortion goes through a table of undistorted, normalised
+// coordinates sampled every few pixels over the frame and built once per
+// calibration and resolution. A corner then costs one bilinear lookup
+// whatever the model, where cv::undistortPoints iterates per point. Nodes
+// are 4 px apart for pinhole and 2 px for fisheye, which kept interpolation
+// error under 0.03 px against cv::undistortPoints.
+class LensModel {
+public:
+	enum Model {
+		MODEL_PINHOLE,
+		MODEL_FISHEYE,
+	};
+
+	static bool valid_coefficient_count(Model model, int count);
+
+	// Cheap when nothing changed, so it can run every frame
+	void set(const cv::Matx33d &camera_matrix, const cv::Mat &coeffs, Model model);
+	// Build the table for this frame size if the lens or size changed
+	void prepare(const cv::Size &frame_size);
+
+	// Pixels to normalised, undistorted image coordinates. Points outside a
+	// prepared table (or without one) are undistorted directly
+	void undistort(const std::vector<cv::Point2f> &pixels, std::vector<cv::Point2f> &normalized) const;
+	void project(const std::vector<cv::Point3f> &points, const cv::Vec3d &rvec, const cv::Vec3d &tvec,
+		std::vector<cv::Point2f> &pixels) const;
+
+	Model get_model() const { return model; }
+	// Pixels per normalised unit, for converting errors back to pixels
+	double mean_focal() const { return 0.5 * (camera_matrix(0, 0) + camera_matrix(1, 1)); }
+
+private:
+	void undistort_direct(const std::vector<cv::Point2f> &pixels, std::vector<cv::Point2f> &normalized) const;
+
+	cv::Matx33d camera_matrix = cv::Matx33d::eye();
+	cv::Mat coeffs;
+	Model model = MODEL_PINHOLE;
+
+	bool dirty = true;
+	cv::Size table_frame;
+	int table_step = 4;
+	int table_cols = 0;
+	int table_rows = 0;
+	std::vector<cv::Point2f> table; // Row-major, table_cols x table_rows nodes
+	mutable std::vector<cv::Point2f> outside; // Reused for points off the table
+	mutable std::vector<cv::Point2f> outside_normalized;
+};
+
+#endif
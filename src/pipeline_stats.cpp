@@ -0,0 +1,56 @@
+#include "pipeline_stats.h"
+#include <algorithm>
+
+const char *PipelineStats::stage_name(PipelineStage stage) {
+	switch (stage) {
+		case STAGE_PREPROCESS:
+			return "preprocess";
+		case STAGE_DETECT:
+			return "detect";
+		case STAGE_POSE:
+			return "pose";
+		default:
+			return "unknown";
+	}
+}
+
+void PipelineStats::record(PipelineStage stage, double microseconds) {
+	std::lock_guard<std::mutex> lock(mutex);
+	StageTiming &timing = data.stages[stage];
+	timing.samples++;
+	timing.last_us = microseconds;
+	timing.total_us += microseconds;
+	timing.max_us = std::max(timing.max_us, microseconds);
+}
+
+void PipelineStats::end_frame(size_t markers) {
+	std::lock_guard<std::mutex> lock(mutex);
+	data.frames++;
+	data.markers += markers;
+}
+
+void PipelineStats::count_early_exit() {
+	std::lock_guard<std::mutex> lock(mutex);
+	data.early_exits++;
+}
+
+void PipelineStats::count_budget(bool overrun, bool incomplete) {
+	std::lock_guard<std::mutex> lock(mutex);
+	data.budget_overruns += overrun ? 1 : 0;
+	data.incomplete_frames += incomplete ? 1 : 0;
+}
+
+void PipelineStats::count_gated(int markers) {
+	std::lock_guard<std::mutex> lock(mutex);
+	data.gated_markers += markers;
+}
+
+void PipelineStats::reset() {
+	std::lock_guard<std::mutex> lock(mutex);
+	data = {};
+}
+
+PipelineStatsSnapshot PipelineStats::snapshot() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return data;
+}
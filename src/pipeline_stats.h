@@ -0,0 +1,57 @@
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Per-stage timings of the frame pipeline. Written from the camera thread,
+// read from Godot through snapshot().
+
+enum PipelineStage {
+	STAGE_PREPROCESS,
+	STAGE_DETECT,
+	STAGE_POSE,
+	STAGE_COUNT
+};
+
+struct StageTiming {
+	uint64_t samples;
+	double last_us;
+	double total_us;
+	double max_us;
+};
+
+struct PipelineStatsSnapshot {
+	uint64_t frames;
+	uint64_t markers;
+	uint64_t early_exits; // Frames that found every expected marker without a full-frame pass
+	uint64_t budget_overruns; // Frames whose detection took longer than the frame budget
+	uint64_t incomplete_frames; // Frames cut short before the whole frame was searched
+	uint64_t gated_markers; // Markers dropped by the confidence gates
+	StageTiming stages[STAGE_COUNT];
+};
+
+class PipelineStats {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static const char *stage_name(PipelineStage stage);
+	static double elapsed_us(Clock::time_point since) {
+		return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+	}
+
+	void record(PipelineStage stage, double microseconds);
+	void end_frame(size_t markers);
+	void count_early_exit();
+	void count_budget(bool overrun, bool incomplete);
+	void count_gated(int markers);
+	void reset();
+	PipelineStatsSnapshot snapshot() const;
+
+private:
+	mutable std::mutex mutex;
+	PipelineStatsSnapshot data = {};
+};
+
+#endif
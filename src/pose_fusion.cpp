@@ -0,0 +1,283 @@
+#include "pose_fusion.h"
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+// A ring that stopped updating this long ago is remapped, in case its
+// detector restarted and created a new segment under the same name
+const auto RECONNECT_AFTER = std::chrono::seconds(1);
+
+// Face-on views are not infinitely better than oblique ones
+const double MIN_VIEW_COSINE = 0.05;
+
+cv::Vec4d to_quaternion(const cv::Matx33d &r) {
+	// w, x, y, z from the largest diagonal term, for stability
+	double trace = r(0, 0) + r(1, 1) + r(2, 2);
+	cv::Vec4d q;
+	if (trace > 0.0) {
+		double s = 2.0 * std::sqrt(1.0 + trace);
+		q = cv::Vec4d(0.25 * s, (r(2, 1) - r(1, 2)) / s, (r(0, 2) - r(2, 0)) / s, (r(1, 0) - r(0, 1)) / s);
+	} else if (r(0, 0) > r(1, 1) && r(0, 0) > r(2, 2)) {
+		double s = 2.0 * std::sqrt(1.0 + r(0, 0) - r(1, 1) - r(2, 2));
+		q = cv::Vec4d((r(2, 1) - r(1, 2)) / s, 0.25 * s, (r(0, 1) + r(1, 0)) / s, (r(0, 2) + r(2, 0)) / s);
+	} else if (r(1, 1) > r(2, 2)) {
+		double s = 2.0 * std::sqrt(1.0 + r(1, 1) - r(0, 0) - r(2, 2));
+		q = cv::Vec4d((r(0, 2) - r(2, 0)) / s, (r(0, 1) + r(1, 0)) / s, 0.25 * s, (r(1, 2) + r(2, 1)) / s);
+	} else {
+		double s = 2.0 * std::sqrt(1.0 + r(2, 2) - r(0, 0) - r(1, 1));
+		q = cv::Vec4d((r(1, 0) - r(0, 1)) / s, (r(0, 2) + r(2, 0)) / s, (r(1, 2) + r(2, 1)) / s, 0.25 * s);
+	}
+	return q;
+}
+
+cv::Matx33d from_quaternion(const cv::Vec4d &q) {
+	double w = q[0], x = q[1], y = q[2], z = q[3];
+	return cv::Matx33d(1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y),
+		2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x),
+		2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y));
+}
+
+}
+
+PoseFusion::~PoseFusion() {
+	stop();
+	clear_cameras();
+}
+
+int PoseFusion::add_camera(const std::string &name, const std::string &segment, const cv::Matx33d &rotation, const cv::Vec3d &translation) {
+	if (running) {
+		return -1;
+	}
+	cameras.emplace_back();
+	Camera &camera = cameras.back();
+	camera.name = name;
+	camera.segment_name = segment;
+	camera.rotation = rotation;
+	camera.translation = translation;
+	return (int)cameras.size() - 1;
+}
+
+void PoseFusion::clear_cameras() {
+	if (running) {
+		return;
+	}
+	for (Camera &camera : cameras) {
+		disconnect(camera);
+	}
+	cameras.clear();
+}
+
+bool PoseFusion::start(int period) {
+	if (running) {
+		return true;
+	}
+	if (cameras.empty()) {
+		return false;
+	}
+	period_us = std::max(100, period);
+	{
+		std::lock_guard<std::mutex> lock(result_mutex);
+		results.clear();
+	}
+	running = true;
+	worker = std::thread(&PoseFusion::run, this);
+	return true;
+}
+
+void PoseFusion::stop() {
+	if (!running) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		running = false;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+std::vector<FusedMarker> PoseFusion::latest() const {
+	std::lock_guard<std::mutex> lock(result_mutex);
+	return results;
+}
+
+double PoseFusion::observation_weight(const cv::Matx33d &marker_rotation, const cv::Vec3d &marker_translation) {
+	double distance = cv::norm(marker_translation);
+	if (distance < 1e-6) {
+		return 0.0;
+	}
+	cv::Vec3d normal(marker_rotation(0, 2), marker_rotation(1, 2), marker_rotation(2, 2));
+	double cosine = std::max(MIN_VIEW_COSINE, std::abs(normal.dot(marker_translation)) / distance);
+	return cosine / (distance * distance);
+}
+
+void PoseFusion::connect(Camera &camera) {
+	int fd = shm_open(camera.segment_name.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		return;
+	}
+	void *memory = mmap(nullptr, sizeof(apriltag_shm_segment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		return;
+	}
+	camera.segment = static_cast<const apriltag_shm_segment *>(memory);
+	camera.last_frame = 0;
+	camera.last_update = std::chrono::steady_clock::now();
+	camera.connected = true;
+}
+
+void PoseFusion::disconnect(Camera &camera) {
+	if (camera.segment) {
+		munmap(const_cast<apriltag_shm_segment *>(camera.segment), sizeof(apriltag_shm_segment));
+		camera.segment = nullptr;
+	}
+	camera.observations.clear();
+	camera.connected = false;
+}
+
+// Reads the camera's newest frame if there is one; returns true when it did
+bool PoseFusion::poll_camera(Camera &camera) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (camera.segment && now - camera.last_update > RECONNECT_AFTER) {
+		disconnect(camera);
+	}
+	if (!camera.segment) {
+		connect(camera);
+		if (!camera.segment) {
+			return false;
+		}
+	}
+	if (!apriltag_shm_valid(camera.segment)) {
+		return false;
+	}
+
+	uint64_t latest = __atomic_load_n(&camera.segment->latest, __ATOMIC_ACQUIRE);
+	if (latest == camera.last_frame || !apriltag_shm_read_frame(camera.segment, latest, &frame)) {
+		return false;
+	}
+	camera.last_frame = latest;
+	camera.timestamp_ns = frame.timestamp_ns;
+	camera.last_update = now;
+	camera.frames++;
+
+	camera.observations.clear();
+	for (uint32_t i = 0; i < frame.count && i < APRILTAG_SHM_MAX_MARKERS; i++) {
+		const apriltag_shm_marker &marker = frame.markers[i];
+		if (!(marker.flags & APRILTAG_SHM_HAS_POSE) || marker.family < 0 || marker.family >= APRILTAG_SHM_MAX_FAMILIES) {
+			continue;
+		}
+		cv::Vec3d rvec(marker.rvec[0], marker.rvec[1], marker.rvec[2]);
+		cv::Vec3d tvec(marker.tvec[0], marker.tvec[1], marker.tvec[2]);
+		cv::Matx33d rotation;
+		cv::Rodrigues(rvec, rotation);
+
+		// Family indices are per detector, names are not
+		const char *name = camera.segment->family_names[marker.family];
+		Observation observation;
+		observation.family.assign(name, strnlen(name, APRILTAG_SHM_NAME_LENGTH));
+		observation.id = marker.id;
+		observation.weight = observation_weight(rotation, tvec);
+		observation.position = camera.rotation * tvec + camera.translation;
+		observation.rotation = camera.rotation * rotation;
+		if (observation.weight > 0.0) {
+			camera.observations.push_back(observation);
+		}
+	}
+	return true;
+}
+
+void PoseFusion::run() {
+	while (running) {
+		bool updated = false;
+		for (Camera &camera : cameras) {
+			updated |= poll_camera(camera);
+		}
+		if (updated) {
+			fuse();
+		}
+
+		std::unique_lock<std::mutex> lock(wake_mutex);
+		wake.wait_for(lock, std::chrono::microseconds(period_us), [this]() { return !running; });
+	}
+	for (Camera &camera : cameras) {
+		disconnect(camera);
+	}
+}
+
+void PoseFusion::fuse() {
+	uint64_t newest = 0;
+	for (const Camera &camera : cameras) {
+		if (camera.segment) {
+			newest = std::max(newest, camera.timestamp_ns);
+		}
+	}
+
+	// Every marker's observations from cameras that are current
+	std::map<std::pair<std::string, int>, std::vector<const Observation *>> markers;
+	std::map<std::pair<std::string, int>, uint64_t> timestamps;
+	for (const Camera &camera : cameras) {
+		if (!camera.segment || (int64_t)(newest - camera.timestamp_ns) > max_age_ns) {
+			continue;
+		}
+		for (const Observation &observation : camera.observations) {
+			std::pair<std::string, int> key(observation.family, observation.id);
+			markers[key].push_back(&observation);
+			uint64_t &timestamp = timestamps[key];
+			timestamp = std::max(timestamp, camera.timestamp_ns);
+		}
+	}
+
+	std::vector<FusedMarker> found;
+	found.reserve(markers.size());
+	for (const auto &entry : markers) {
+		const std::vector<const Observation *> &observations = entry.second;
+		FusedMarker marker;
+		marker.family = entry.first.first;
+		marker.id = entry.first.second;
+		marker.timestamp_ns = timestamps[entry.first];
+		marker.cameras = (int)observations.size();
+
+		// Weighted mean position, and weighted mean quaternion on the
+		// hemisphere of the heaviest observation (q and -q are the same rotation)
+		const Observation *heaviest = observations[0];
+		for (const Observation *observation : observations) {
+			if (observation->weight > heaviest->weight) {
+				heaviest = observation;
+			}
+		}
+		cv::Vec4d reference = to_quaternion(heaviest->rotation);
+		cv::Vec3d position(0, 0, 0);
+		cv::Vec4d quaternion(0, 0, 0, 0);
+		double total = 0.0;
+		for (const Observation *observation : observations) {
+			cv::Vec4d q = to_quaternion(observation->rotation);
+			if (q.dot(reference) < 0.0) {
+				q = -q;
+			}
+			position += observation->position * observation->weight;
+			quaternion += q * observation->weight;
+			total += observation->weight;
+		}
+		marker.position = position * (1.0 / total);
+		quaternion *= 1.0 / cv::norm(quaternion);
+		cv::Rodrigues(from_quaternion(quaternion), marker.rvec);
+
+		marker.spread = 0.0;
+		for (const Observation *observation : observations) {
+			marker.spread = std::max(marker.spread, cv::norm(observation->position - marker.position));
+		}
+		found.push_back(marker);
+	}
+
+	fused_frames++;
+	std::lock_guard<std::mutex> lock(result_mutex);
+	results.swap(found);
+}
@@ -0,0 +1,108 @@
+#ifndef POSE_FUSION_H
+#define POSE_FUSION_H
+
+#include "apriltag_shm.h"
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A marker in the world frame, merged over every camera that saw it
+struct FusedMarker {
+	std::string family;
+	int id;
+	uint64_t timestamp_ns; // Newest contributing frame
+	cv::Vec3d position; // Metres, world frame
+	cv::Vec3d rvec; // Rodrigues, marker to world
+	int cameras; // Cameras that contributed
+	double spread; // Largest distance of a camera's estimate from the fused position, metres
+};
+
+// Merges the detections of several cameras covering one area. Each camera
+// runs its own detector process publishing to a shared-memory ring
+// (apriltag_shm.h); a fusion thread polls the rings, moves every pose into
+// the world frame with that camera's extrinsics and averages the
+// observations of each marker, weighting near, face-on views highest.
+// Nothing here ever blocks a camera's pipeline.
+class PoseFusion {
+public:
+	~PoseFusion();
+
+	// Camera to world: p_world = rotation * p_camera + translation (metres).
+	// Only before start()
+	int add_camera(const std::string &name, const std::string &segment, const cv::Matx33d &rotation, const cv::Vec3d &translation);
+	void clear_cameras();
+	int get_camera_count() const { return (int)cameras.size(); }
+	const std::string &get_camera_name(int index) const { return cameras[index].name; }
+
+	// A camera's latest frame is left out once it is this much older than
+	// the newest frame of any camera (sensor timestamps, same machine)
+	void set_max_age_ns(int64_t age) { max_age_ns = age; }
+	int64_t get_max_age_ns() const { return max_age_ns; }
+
+	bool start(int period_us = 2000);
+	void stop();
+	bool is_running() const { return running; }
+
+	std::vector<FusedMarker> latest() const;
+	uint64_t get_fused_frames() const { return fused_frames; }
+	// Frames read from the camera's ring so far
+	uint64_t get_camera_frames(int index) const { return cameras[index].frames; }
+	bool is_camera_connected(int index) const { return cameras[index].connected; }
+
+	// Weight of one camera's observation: 1/d^2 scaled by the cosine between
+	// the line of sight and the marker normal (camera frame, marker to camera)
+	static double observation_weight(const cv::Matx33d &marker_rotation, const cv::Vec3d &marker_translation);
+
+private:
+	struct Observation {
+		std::string family;
+		int id;
+		cv::Vec3d position; // World frame
+		cv::Matx33d rotation;
+		double weight;
+	};
+
+	struct Camera {
+		std::string name;
+		std::string segment_name;
+		cv::Matx33d rotation;
+		cv::Vec3d translation;
+		const apriltag_shm_segment *segment = nullptr;
+		uint64_t last_frame = 0;
+		uint64_t timestamp_ns = 0;
+		std::chrono::steady_clock::time_point last_update;
+		std::vector<Observation> observations; // From the latest frame
+		std::atomic<uint64_t> frames{0};
+		std::atomic<bool> connected{false};
+	};
+
+	void run();
+	bool poll_camera(Camera &camera);
+	void connect(Camera &camera);
+	void disconnect(Camera &camera);
+	void fuse();
+
+	std::deque<Camera> cameras; // Stable addresses, Camera holds atomics
+	std::atomic<int64_t> max_age_ns{50000000};
+	int period_us = 2000;
+
+	std::atomic<bool> running{false};
+	std::thread worker;
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+
+	mutable std::mutex result_mutex;
+	std::vector<FusedMarker> results;
+	std::atomic<uint64_t> fused_frames{0};
+
+	apriltag_shm_frame frame; // Reused across polls
+};
+
+#endif
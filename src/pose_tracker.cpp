@@ -0,0 +1,49 @@
+#include "pose_tracker.h"
+#include <opencv2/calib3d.hpp>
+
+// Prune stale tracks every this many frames
+static const uint64_t PRUNE_INTERVAL = 64;
+
+void PoseTracker::begin_frame() {
+	frame++;
+	if (frame % PRUNE_INTERVAL != 0) {
+		return;
+	}
+	for (auto it = tracks.begin(); it != tracks.end();) {
+		if (frame - it->second.frame > (uint64_t)max_age) {
+			it = tracks.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void PoseTracker::clear() {
+	tracks.clear();
+}
+
+int PoseTracker::select(uint64_t marker, const Solution solutions[2], bool &ambiguous) {
+	int best = solutions[1].error < solutions[0].error ? 1 : 0;
+	int other = 1 - best;
+	ambiguous = solutions[other].error < ambiguity_ratio * solutions[best].error;
+
+	cv::Matx33d rotation[2];
+	cv::Rodrigues(solutions[0].rvec, rotation[0]);
+	cv::Rodrigues(solutions[1].rvec, rotation[1]);
+
+	auto it = tracks.find(marker);
+	if (ambiguous && it != tracks.end() && frame - it->second.frame <= (uint64_t)max_age) {
+		// trace(Rprev^T R) = 1 + 2 cos(angle): larger is closer
+		const cv::Matx33d &previous = it->second.rotation;
+		double closeness[2];
+		for (int s = 0; s < 2; s++) {
+			closeness[s] = previous.dot(rotation[s]);
+		}
+		best = closeness[1] > closeness[0] ? 1 : 0;
+	}
+
+	Track &track = tracks[marker];
+	track.rotation = rotation[best];
+	track.frame = frame;
+	return best;
+}
@@ -0,0 +1,52 @@
+#ifndef POSE_TRACKER_H
+#define POSE_TRACKER_H
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <unordered_map>
+
+// Temporal disambiguation of the two planar pose solutions of a square marker.
+//
+// Small or distant tags give two IPPE solutions with near-equal reprojection
+// error, and picking the lower one per frame makes the pose flip between
+// them. When the errors are too close to decide, the tracker keeps the
+// solution whose rotation is closest to the pose reported for the same
+// marker in a recent frame.
+class PoseTracker {
+public:
+	struct Solution {
+		cv::Vec3d rvec;
+		cv::Vec3d tvec;
+		double error; // Any squared reprojection error, compared only by ratio
+	};
+
+	// Identifies a marker across frames
+	static uint64_t key(int family, int id) { return ((uint64_t)(uint32_t)family << 32) | (uint32_t)id; }
+
+	void begin_frame();
+	void clear();
+
+	// Returns the index of the solution to report. `ambiguous` is set when
+	// the second solution's error is within `ambiguity_ratio` of the best.
+	int select(uint64_t marker, const Solution solutions[2], bool &ambiguous);
+
+	// Solutions are ambiguous when error[worse] < ratio * error[better]
+	void set_ambiguity_ratio(double ratio) { ambiguity_ratio = ratio; }
+	double get_ambiguity_ratio() const { return ambiguity_ratio; }
+	// Frames after which a marker's last pose no longer guides the choice
+	void set_max_age(int frames) { max_age = frames; }
+	int get_max_age() const { return max_age; }
+
+private:
+	struct Track {
+		cv::Matx33d rotation;
+		uint64_t frame;
+	};
+
+	std::unordered_map<uint64_t, Track> tracks;
+	uint64_t frame = 0;
+	double ambiguity_ratio = 4.0;
+	int max_age = 15;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "preview_overlay.h"
+#include <opencv2/imgproc.hpp>
+#include <string>
+
+// Lines are drawn with 4 fractional bits, so scaled corners keep their
+// sub-pixel position in the small preview
+static const int SHIFT = 4;
+
+static cv::Point to_preview(const cv::Point2f &p, float scale_x, float scale_y) {
+	return cv::Point(cvRound(p.x * scale_x * (1 << SHIFT)), cvRound(p.y * scale_y * (1 << SHIFT)));
+}
+
+void draw_preview_overlay(cv::Mat &preview, const cv::Size &frame_size, const std::vector<OverlayMarker> &markers) {
+	if (preview.empty() || frame_size.empty()) {
+		return;
+	}
+	const float scale_x = (float)preview.cols / frame_size.width;
+	const float scale_y = (float)preview.rows / frame_size.height;
+	const cv::Scalar outline(0, 255, 0);
+	const cv::Scalar first_corner(0, 0, 255);
+	const cv::Scalar label(255, 128, 0);
+	const cv::Scalar axis_colors[3] = { cv::Scalar(0, 0, 255), cv::Scalar(0, 255, 0), cv::Scalar(255, 0, 0) };
+
+	for (const OverlayMarker &marker : markers) {
+		cv::Point corners[4];
+		cv::Point2f center(0, 0);
+		for (int k = 0; k < 4; k++) {
+			corners[k] = to_preview(marker.corners[k], scale_x, scale_y);
+			center += marker.corners[k] * 0.25f;
+		}
+		for (int k = 0; k < 4; k++) {
+			cv::line(preview, corners[k], corners[(k + 1) % 4], outline, 1, cv::LINE_AA, SHIFT);
+		}
+		cv::circle(preview, corners[0], 2 << SHIFT, first_corner, 1, cv::LINE_AA, SHIFT);
+
+		if (marker.has_pose) {
+			cv::Point origin = to_preview(marker.axes[0], scale_x, scale_y);
+			for (int axis = 0; axis < 3; axis++) {
+				cv::line(preview, origin, to_preview(marker.axes[axis + 1], scale_x, scale_y), axis_colors[axis], 1, cv::LINE_AA, SHIFT);
+			}
+		}
+
+		// Centred on the marker, whose interior is the least busy place for text
+		std::string text = std::to_string(marker.id);
+		int baseline = 0;
+		cv::Size size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.35, 1, &baseline);
+		cv::Point at(cvRound(center.x * scale_x) - size.width / 2, cvRound(center.y * scale_y) + size.height / 2);
+		cv::putText(preview, text, at, cv::FONT_HERSHEY_SIMPLEX, 0.35, label, 1, cv::LINE_AA);
+	}
+}
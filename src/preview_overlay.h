@@ -0,0 +1,21 @@
+#ifndef PREVIEW_OVERLAY_H
+#define PREVIEW_OVERLAY_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Detections drawn into the downscaled preview by the thread that detected
+// them, so outlines and image always come from the same frame. Coordinates
+// are full-frame pixels; drawing scales them to the preview.
+struct OverlayMarker {
+	int id;
+	cv::Point2f corners[4]; // ArUco order, corners[0] is the top-left of the code
+	bool has_pose;
+	cv::Point2f axes[4]; // Projected pose origin and the ends of its x, y and z axes
+};
+
+// Outline and ID per marker, plus its pose axes when it has one. `preview`
+// is BGR, as cv::drawFrameAxes colours the axes: x red, y green, z blue
+void draw_preview_overlay(cv::Mat &preview, const cv::Size &frame_size, const std::vector<OverlayMarker> &markers);
+
+#endif
@@ -1,5 +1,7 @@
 #include "register_types.h"
 #include "apriltag_detector.h"
+#include "apriltag_log.h"
+#include "apriltag_fusion.h"
 
 #include <gdextension_interface.h>
 #include <godot_cpp/core/defs.hpp>
@@ -13,6 +15,8 @@ void initialize_apriltag_module(ModuleInitializationLevel p_level) {
 	}
 
 	ClassDB::register_class<AprilTagDetector>();
+	ClassDB::register_class<AprilTagLog>();
+	ClassDB::register_class<AprilTagFusion>();
 }
 
 void uninitialize_apriltag_module(ModuleInitializationLevel p_level) {
@@ -0,0 +1,156 @@
+#include "run_segmentation.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+
+void RunSegmentation::encode(const cv::Mat &binary) {
+	const int rows = binary.rows;
+	const int cols = binary.cols;
+	runs.clear();
+	row_offsets.resize(rows + 1);
+
+	for (int y = 0; y < rows; y++) {
+		row_offsets[y] = (int)runs.size();
+		const uint8_t *row = binary.ptr<uint8_t>(y);
+		int x = 0;
+		while (x < cols) {
+			// Background and solid foreground are skipped eight pixels at a time
+			uint64_t word;
+			while (x + 8 <= cols) {
+				memcpy(&word, row + x, sizeof(word));
+				if (word != 0) {
+					break;
+				}
+				x += 8;
+			}
+			while (x < cols && row[x] == 0) {
+				x++;
+			}
+			if (x >= cols) {
+				break;
+			}
+
+			const int begin = x;
+			while (x + 8 <= cols) {
+				memcpy(&word, row + x, sizeof(word));
+				if (word != UINT64_MAX) {
+					break;
+				}
+				x += 8;
+			}
+			while (x < cols && row[x] != 0) {
+				x++;
+			}
+			runs.push_back({ y, begin, x });
+		}
+	}
+	row_offsets[rows] = (int)runs.size();
+}
+
+int RunSegmentation::find_root(int run) {
+	while (parent[run] != run) {
+		parent[run] = parent[parent[run]];
+		run = parent[run];
+	}
+	return run;
+}
+
+void RunSegmentation::unite(int a, int b) {
+	a = find_root(a);
+	b = find_root(b);
+	// The lower index always wins, so a root precedes every run it owns
+	if (a < b) {
+		parent[b] = a;
+	} else if (b < a) {
+		parent[a] = b;
+	}
+}
+
+void RunSegmentation::label() {
+	parent.resize(runs.size());
+	std::iota(parent.begin(), parent.end(), 0);
+
+	const int rows = (int)row_offsets.size() - 1;
+	for (int y = 1; y < rows; y++) {
+		int a = row_offsets[y - 1];
+		const int a_end = row_offsets[y];
+		int b = row_offsets[y];
+		const int b_end = row_offsets[y + 1];
+
+		// Sweep both rows once; runs touching horizontally or diagonally are joined
+		while (a < a_end && b < b_end) {
+			const Run &above = runs[a];
+			const Run &below = runs[b];
+			if (above.x_end >= below.x_begin && below.x_end >= above.x_begin) {
+				unite(a, b);
+			}
+			if (above.x_end < below.x_end) {
+				a++;
+			} else {
+				b++;
+			}
+		}
+	}
+}
+
+void RunSegmentation::find_outlines(const cv::Mat &binary, double min_perimeter, double max_perimeter,
+		std::vector<std::vector<cv::Point>> &outlines, size_t &count) {
+	encode(binary);
+	label();
+
+	// Bounding box per component. Roots precede their runs, so one pass suffices.
+	components.clear();
+	component_of.resize(runs.size());
+	for (int i = 0; i < (int)runs.size(); i++) {
+		const Run &run = runs[i];
+		const int root = find_root(i);
+		int c;
+		if (root == i) {
+			c = (int)components.size();
+			components.push_back({ run.x_begin, run.y, run.x_end - 1, run.y, -1 });
+		} else {
+			c = component_of[root];
+			Component &component = components[c];
+			component.min_x = std::min(component.min_x, run.x_begin);
+			component.max_x = std::max(component.max_x, run.x_end - 1);
+			component.max_y = run.y;
+		}
+		component_of[i] = c;
+	}
+
+	// A convex outline's perimeter lies between 1/sqrt(2) and 1x the perimeter
+	// of its bounding box, which rejects most components before any hull work
+	count = 0;
+	for (Component &component : components) {
+		const double box = 2.0 * ((component.max_x - component.min_x + 1) + (component.max_y - component.min_y + 1));
+		if (box < min_perimeter || box * std::sqrt(0.5) > max_perimeter) {
+			continue;
+		}
+		component.outline = (int)count++;
+	}
+
+	if (outlines.size() < count) {
+		outlines.resize(count);
+	}
+	for (size_t k = 0; k < count; k++) {
+		outlines[k].clear();
+	}
+
+	for (int i = 0; i < (int)runs.size(); i++) {
+		const int k = components[component_of[i]].outline;
+		if (k < 0) {
+			continue;
+		}
+		const Run &run = runs[i];
+		outlines[k].push_back(cv::Point(run.x_begin, run.y));
+		outlines[k].push_back(cv::Point(run.x_end - 1, run.y));
+	}
+
+	for (size_t k = 0; k < count; k++) {
+		cv::convexHull(outlines[k], hull);
+		outlines[k].swap(hull);
+	}
+}
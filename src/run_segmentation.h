@@ -0,0 +1,48 @@
+#ifndef RUN_SEGMENTATION_H
+#define RUN_SEGMENTATION_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Connected-component segmentation on a run-length encoded binary image.
+//
+// Each row of the thresholded frame is reduced to its foreground runs, runs
+// that touch (8-connectivity) on adjacent rows are joined with union-find,
+// and each component is summarised by the convex hull of its run endpoints.
+// Only run endpoints are visited after encoding, so the cost scales with the
+// number of edges rather than the number of pixels. All buffers persist
+// across frames.
+class RunSegmentation {
+public:
+	// Label the non-zero pixels of a CV_8UC1 image and return the convex
+	// outline of every component whose bounding box perimeter lies within
+	// [min_perimeter, max_perimeter]. Entries past `count` are stale.
+	void find_outlines(const cv::Mat &binary, double min_perimeter, double max_perimeter,
+			std::vector<std::vector<cv::Point>> &outlines, size_t &count);
+
+private:
+	struct Run {
+		int y;
+		int x_begin;
+		int x_end; // Exclusive
+	};
+
+	struct Component {
+		int min_x, min_y, max_x, max_y;
+		int outline; // Index into outlines, -1 when filtered out
+	};
+
+	void encode(const cv::Mat &binary);
+	void label();
+	int find_root(int run);
+	void unite(int a, int b);
+
+	std::vector<Run> runs;
+	std::vector<int> row_offsets; // runs[row_offsets[y] .. row_offsets[y + 1]) lie on row y
+	std::vector<int> parent;
+	std::vector<int> component_of; // Component index per run
+	std::vector<Component> components;
+	std::vector<cv::Point> hull;
+};
+
+#endif
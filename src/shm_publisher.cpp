@@ -0,0 +1,91 @@
+#include "shm_publisher.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+ShmPublisher::~ShmPublisher() {
+	close();
+}
+
+bool ShmPublisher::open(const std::string &name) {
+	close();
+
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	if (ftruncate(fd, sizeof(apriltag_shm_segment)) != 0) {
+		::close(fd);
+		shm_unlink(name.c_str());
+		return false;
+	}
+	void *memory = mmap(nullptr, sizeof(apriltag_shm_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED) {
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	// A stale segment from an earlier run is reset; readers check magic and
+	// version, which are written last
+	segment = static_cast<apriltag_shm_segment *>(memory);
+	__atomic_store_n(&segment->magic, 0u, __ATOMIC_RELAXED);
+	memset(segment, 0, sizeof(*segment));
+	segment->slot_count = APRILTAG_SHM_SLOTS;
+	segment->max_markers = APRILTAG_SHM_MAX_MARKERS;
+	segment->version = APRILTAG_SHM_VERSION;
+	__atomic_store_n(&segment->magic, APRILTAG_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	segment_name = name;
+	frame_number = 0;
+	writing = nullptr;
+	return true;
+}
+
+void ShmPublisher::close() {
+	if (!segment) {
+		return;
+	}
+	munmap(segment, sizeof(apriltag_shm_segment));
+	shm_unlink(segment_name.c_str());
+	segment = nullptr;
+	writing = nullptr;
+}
+
+void ShmPublisher::set_family_name(int index, const std::string &name) {
+	if (!segment || index < 0 || index >= APRILTAG_SHM_MAX_FAMILIES) {
+		return;
+	}
+	char *dst = segment->family_names[index];
+	strncpy(dst, name.c_str(), APRILTAG_SHM_NAME_LENGTH - 1);
+	dst[APRILTAG_SHM_NAME_LENGTH - 1] = '\0';
+}
+
+apriltag_shm_frame &ShmPublisher::begin_frame() {
+	writing = &segment->slots[(frame_number + 1) % APRILTAG_SHM_SLOTS];
+
+	// Odd sequence before any payload store becomes visible
+	uint32_t sequence = __atomic_load_n(&writing->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&writing->sequence, sequence | 1u, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	writing->count = 0;
+	return *writing;
+}
+
+void ShmPublisher::publish(uint64_t timestamp_ns, uint32_t flags) {
+	if (!writing) {
+		return;
+	}
+	frame_number++;
+	writing->flags = flags;
+	writing->frame_number = frame_number;
+	writing->timestamp_ns = timestamp_ns;
+
+	// Even again: payload complete
+	uint32_t sequence = __atomic_load_n(&writing->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&writing->sequence, sequence + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&segment->latest, frame_number, __ATOMIC_RELEASE);
+	writing = nullptr;
+}
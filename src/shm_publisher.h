@@ -0,0 +1,34 @@
+#ifndef SHM_PUBLISHER_H
+#define SHM_PUBLISHER_H
+
+#include "apriltag_shm.h"
+#include <string>
+
+// Writer side of apriltag_shm.h: owns a POSIX shared-memory segment and
+// publishes one result set per frame into its seqlock ring. Single writer;
+// any number of readers in other processes.
+class ShmPublisher {
+public:
+	~ShmPublisher();
+
+	// Create (or take over) the segment `name`, e.g. "/apriltag_detections"
+	bool open(const std::string &name);
+	// Unmap and unlink; readers keep their mapping until they close it
+	void close();
+	bool is_open() const { return segment != nullptr; }
+
+	void set_family_name(int index, const std::string &name);
+
+	// Fill the next slot's markers and count (at most APRILTAG_SHM_MAX_MARKERS)
+	// through begin_frame(), then publish it
+	apriltag_shm_frame &begin_frame();
+	void publish(uint64_t timestamp_ns, uint32_t flags);
+
+private:
+	apriltag_shm_segment *segment = nullptr;
+	std::string segment_name;
+	uint64_t frame_number = 0;
+	apriltag_shm_frame *writing = nullptr;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef SIMD_FLOAT_H
+#define SIMD_FLOAT_H
+
+#include <cstring>
+
+// Portable float SIMD type built on GCC/Clang vector extensions. Arithmetic,
+// comparisons and ?: selects compile to NEON on arm64 and SSE/AVX on x86_64;
+// only the few operations without an operator go through intrinsics.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VFLOAT_LANES 8
+typedef float vfloat __attribute__((vector_size(32)));
+typedef int vmask __attribute__((vector_size(32))); // Comparison result, -1 or 0 per lane
+static inline vfloat v_sqrt(vfloat a) { return (vfloat)_mm256_sqrt_ps((__m256)a); }
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define VFLOAT_LANES 4
+typedef float vfloat __attribute__((vector_size(16)));
+typedef int vmask __attribute__((vector_size(16))); // Comparison result, -1 or 0 per lane
+static inline vfloat v_sqrt(vfloat a) { return (vfloat)vsqrtq_f32((float32x4_t)a); }
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VFLOAT_LANES 4
+typedef float vfloat __attribute__((vector_size(16)));
+typedef int vmask __attribute__((vector_size(16))); // Comparison result, -1 or 0 per lane
+static inline vfloat v_sqrt(vfloat a) { return (vfloat)_mm_sqrt_ps((__m128)a); }
+#else
+#include <cmath>
+#define VFLOAT_LANES 4
+typedef float vfloat __attribute__((vector_size(16)));
+typedef int vmask __attribute__((vector_size(16))); // Comparison result, -1 or 0 per lane
+static inline vfloat v_sqrt(vfloat a) {
+	for (int i = 0; i < VFLOAT_LANES; i++) {
+		a[i] = std::sqrt(a[i]);
+	}
+	return a;
+}
+#endif
+
+static inline vfloat v_set(float value) {
+	vfloat v = {};
+	return v + value;
+}
+
+static inline vfloat v_load(const float *src) {
+	vfloat v;
+	memcpy(&v, src, sizeof(v));
+	return v;
+}
+
+static inline void v_store(float *dst, vfloat v) {
+	memcpy(dst, &v, sizeof(v));
+}
+
+static inline vfloat v_max(vfloat a, vfloat b) { return a > b ? a : b; }
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+// Lock-free single-producer single-consumer ring of N slots (N a power of
+// two). The producer fills a slot in place through claim()/publish(); a full
+// ring rejects the claim instead of waiting. Neither side ever blocks.
+template <typename T, size_t N>
+class SpscRing {
+	static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+	// Producer: slot to fill, or nullptr if the consumer is N slots behind
+	T *claim() {
+		size_t head = write_index.load(std::memory_order_relaxed);
+		if (head - read_index.load(std::memory_order_acquire) == N) {
+			return nullptr;
+		}
+		return &slots[head & (N - 1)];
+	}
+	void publish() {
+		write_index.store(write_index.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Consumer: oldest published slot, or nullptr if empty
+	T *front() {
+		size_t tail = read_index.load(std::memory_order_relaxed);
+		if (tail == write_index.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return &slots[tail & (N - 1)];
+	}
+	void pop() {
+		read_index.store(read_index.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	T slots[N];
+	// Own cache lines, so the two threads do not invalidate each other's index
+	alignas(64) std::atomic<size_t> write_index{0};
+	alignas(64) std::atomic<size_t> read_index{0};
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include "stereo_matcher.h"
+#include "frame_trace.h"
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+StereoMatcher::~StereoMatcher() {
+	stop();
+}
+
+void StereoMatcher::set_calibration(const StereoCalibration &stereo) {
+	calibrations.update([&](StereoCalibration &next) {
+		next = stereo;
+		return true;
+	});
+	calibrated = true;
+}
+
+bool StereoMatcher::start() {
+	if (running) {
+		return true;
+	}
+	if (!calibrated) {
+		return false;
+	}
+	// Frames left over from an earlier run would pair with new ones
+	for (auto &ring : rings) {
+		while (ring.front()) {
+			ring.pop();
+		}
+	}
+	running = true;
+	worker = std::thread(&StereoMatcher::run, this);
+	return true;
+}
+
+void StereoMatcher::stop() {
+	if (!running) {
+		return;
+	}
+	running = false;
+	wake.notify_one();
+	worker.join();
+}
+
+void StereoMatcher::push(int camera, uint64_t timestamp_ns, const std::vector<DetectedMarker> &markers) {
+	if (!running || camera < 0 || camera > 1) {
+		return;
+	}
+	Observation *slot = rings[camera].claim();
+	if (!slot) {
+		dropped++;
+		return;
+	}
+	slot->timestamp_ns = timestamp_ns;
+	slot->count = std::min((int)markers.size(), STEREO_MAX_MARKERS);
+	for (int i = 0; i < slot->count; i++) {
+		slot->markers[i].id = markers[i].id;
+		slot->markers[i].family = markers[i].family;
+		std::copy(markers[i].corners.begin(), markers[i].corners.begin() + 4, slot->markers[i].corners);
+	}
+	rings[camera].publish();
+	wake.notify_one();
+}
+
+std::vector<StereoMarker> StereoMatcher::latest() const {
+	std::lock_guard<std::mutex> lock(result_mutex);
+	return results;
+}
+
+void StereoMatcher::run() {
+	FrameTrace::set_thread_name("stereo");
+	Observation *pending[2] = { nullptr, nullptr };
+	while (running) {
+		{
+			// Pushes notify without the lock; a missed wake-up costs at most the timeout
+			std::unique_lock<std::mutex> lock(wake_mutex);
+			wake.wait_for(lock, std::chrono::milliseconds(5));
+		}
+
+		// Pair the oldest frames; a frame older than the other camera's
+		// oldest by more than the tolerance can never pair and is dropped
+		for (;;) {
+			for (int c = 0; c < 2; c++) {
+				if (!pending[c]) {
+					pending[c] = rings[c].front();
+				}
+			}
+			if (!pending[0] || !pending[1]) {
+				break;
+			}
+			int64_t offset = (int64_t)(pending[1]->timestamp_ns - pending[0]->timestamp_ns);
+			if (std::llabs(offset) <= tolerance_ns) {
+				{
+					TraceSpan span("stereo match");
+					ConfigSnapshot<StereoCalibration>::Reader calibration(calibrations);
+					match(*calibration, *pending[0], *pending[1]);
+				}
+				pairs++;
+				rings[0].pop();
+				rings[1].pop();
+				pending[0] = pending[1] = nullptr;
+			} else {
+				int older = offset > 0 ? 0 : 1;
+				rings[older].pop();
+				pending[older] = nullptr;
+				unpaired++;
+			}
+		}
+	}
+}
+
+void StereoMatcher::match(const StereoCalibration &calibration, const Observation &first, const Observation &second) {
+	// Markers seen by both cameras
+	std::vector<std::pair<int, int>> matched;
+	for (int i = 0; i < first.count; i++) {
+		for (int j = 0; j < second.count; j++) {
+			if (first.markers[i].id == second.markers[j].id && first.markers[i].family == second.markers[j].family) {
+				matched.push_back({ i, j });
+				break;
+			}
+		}
+	}
+
+	std::vector<StereoMarker> found;
+	if (!matched.empty()) {
+		distorted[0].clear();
+		distorted[1].clear();
+		for (const auto &pair : matched) {
+			distorted[0].insert(distorted[0].end(), first.markers[pair.first].corners, first.markers[pair.first].corners + 4);
+			distorted[1].insert(distorted[1].end(), second.markers[pair.second].corners, second.markers[pair.second].corners + 4);
+		}
+		for (int c = 0; c < 2; c++) {
+			calibration.lens[c].undistort(distorted[c], normalized[c]);
+		}
+
+		for (size_t k = 0; k < matched.size(); k++) {
+			StereoMarker marker;
+			marker.id = first.markers[matched[k].first].id;
+			marker.family = first.markers[matched[k].first].family;
+			marker.timestamp_ns = first.timestamp_ns;
+			marker.time_offset_ns = (int64_t)(second.timestamp_ns - first.timestamp_ns);
+			marker.ray_gap = 0.0;
+			for (int q = 0; q < 4; q++) {
+				double gap;
+				marker.corners[q] = triangulate(calibration.rotation, calibration.translation,
+					normalized[0][k * 4 + q], normalized[1][k * 4 + q], gap);
+				marker.ray_gap += gap / 4.0;
+			}
+			cv::Matx33d rotation;
+			corner_pose(marker.corners, rotation, marker.center);
+			cv::Rodrigues(rotation, marker.rvec);
+			marker.tvec = cv::Vec3d(marker.center.x, marker.center.y, marker.center.z);
+			found.push_back(marker);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(result_mutex);
+	results.swap(found);
+}
+
+cv::Point3d StereoMatcher::triangulate(const cv::Matx33d &rotation, const cv::Vec3d &translation,
+		const cv::Point2d &p0, const cv::Point2d &p1, double &gap) {
+	// Camera 1's centre and ray in camera 0's frame
+	cv::Matx33d back = rotation.t();
+	cv::Point3d origin1 = -(back * cv::Point3d(translation[0], translation[1], translation[2]));
+	cv::Point3d ray0(p0.x, p0.y, 1.0);
+	cv::Point3d ray1 = back * cv::Point3d(p1.x, p1.y, 1.0);
+
+	// Closest points origin0 + s ray0 and origin1 + t ray1
+	cv::Point3d w = -origin1;
+	double a = ray0.dot(ray0), b = ray0.dot(ray1), c = ray1.dot(ray1);
+	double d = ray0.dot(w), e = ray1.dot(w);
+	double denom = a * c - b * b;
+	double s, t;
+	if (denom < 1e-12) {
+		// Parallel rays: a point at infinity, report the nearest approach
+		s = 0.0;
+		t = e / c;
+	} else {
+		s = (b * e - c * d) / denom;
+		t = (a * e - b * d) / denom;
+	}
+	cv::Point3d q0 = ray0 * s;
+	cv::Point3d q1 = origin1 + ray1 * t;
+	gap = cv::norm(q0 - q1);
+	return (q0 + q1) * 0.5;
+}
+
+void StereoMatcher::corner_pose(const cv::Point3d corners[4], cv::Matx33d &rotation, cv::Point3d &center) {
+	center = (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25;
+
+	// Both edges along each marker axis, then Gram-Schmidt
+	cv::Point3d x = (corners[1] - corners[0]) + (corners[2] - corners[3]);
+	cv::Point3d y = (corners[0] - corners[3]) + (corners[1] - corners[2]);
+	x = x * (1.0 / cv::norm(x));
+	y = y - x * y.dot(x);
+	y = y * (1.0 / cv::norm(y));
+	cv::Point3d z = x.cross(y);
+	rotation = cv::Matx33d(x.x, y.x, z.x,
+		x.y, y.y, z.y,
+		x.z, y.z, z.z);
+}
@@ -0,0 +1,108 @@
+#ifndef STEREO_MATCHER_H
+#define STEREO_MATCHER_H
+
+#include "config_snapshot.h"
+#include "detection_engine.h"
+#include "lens_model.h"
+#include "spsc_ring.h"
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const int STEREO_MAX_MARKERS = 64;
+
+// Both lenses have their tables prepared for their camera's stream size
+struct StereoCalibration {
+	LensModel lens[2];
+	// Camera 1 from camera 0, as from cv::stereoCalibrate: x1 = R x0 + T (metres)
+	cv::Matx33d rotation;
+	cv::Vec3d translation;
+};
+
+// A marker seen by both cameras, in camera 0's frame
+struct StereoMarker {
+	int id;
+	int family;
+	uint64_t timestamp_ns; // Camera 0's
+	int64_t time_offset_ns; // Camera 1 - camera 0
+	cv::Point3d corners[4]; // Triangulated, same order as the 2D corners
+	cv::Point3d center;
+	cv::Vec3d rvec; // Marker axes from the triangulated corners
+	cv::Vec3d tvec;
+	double ray_gap; // Mean closest distance between corresponding rays, metres
+};
+
+// Pairs the two cameras' detections by nearest sensor timestamp and
+// triangulates the corners of markers seen by both. Each capture thread
+// pushes into its own lock-free ring, so neither ever waits for the other or
+// for the matcher thread; a full ring drops the frame.
+class StereoMatcher {
+public:
+	~StereoMatcher();
+
+	// Any thread; pairs matched after this use the new calibration
+	void set_calibration(const StereoCalibration &calibration);
+	bool has_calibration() const { return calibrated; }
+	// Frames further apart than this are not paired
+	void set_tolerance_ns(int64_t tolerance) { tolerance_ns = tolerance; }
+	int64_t get_tolerance_ns() const { return tolerance_ns; }
+
+	bool start();
+	void stop();
+	bool is_running() const { return running; }
+
+	// Capture thread of `camera` (0 or 1) only
+	void push(int camera, uint64_t timestamp_ns, const std::vector<DetectedMarker> &markers);
+
+	std::vector<StereoMarker> latest() const;
+	uint64_t get_pairs() const { return pairs; }
+	uint64_t get_unpaired_frames() const { return unpaired; }
+	uint64_t get_dropped_frames() const { return dropped; }
+
+	// Midpoint of the closest approach between a ray through normalized image
+	// point `p0` of camera 0 and one through `p1` of camera 1. `gap` is the
+	// distance between the rays at that point.
+	static cv::Point3d triangulate(const cv::Matx33d &rotation, const cv::Vec3d &translation,
+		const cv::Point2d &p0, const cv::Point2d &p1, double &gap);
+	// Marker axes from four triangulated corners ordered like marker_object_points
+	static void corner_pose(const cv::Point3d corners[4], cv::Matx33d &rotation, cv::Point3d &center);
+
+private:
+	struct Observation {
+		uint64_t timestamp_ns;
+		int count;
+		struct {
+			int32_t id;
+			int32_t family;
+			cv::Point2f corners[4];
+		} markers[STEREO_MAX_MARKERS];
+	};
+
+	void run();
+	void match(const StereoCalibration &calibration, const Observation &first, const Observation &second);
+
+	SpscRing<Observation, 8> rings[2];
+	ConfigSnapshot<StereoCalibration> calibrations; // Read by the matcher thread only
+	std::atomic<bool> calibrated{false};
+	std::atomic<int64_t> tolerance_ns{2000000};
+
+	std::atomic<bool> running{false};
+	std::thread worker;
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+
+	mutable std::mutex result_mutex;
+	std::vector<StereoMarker> results;
+	std::atomic<uint64_t> pairs{0};
+	std::atomic<uint64_t> unpaired{0};
+	std::atomic<uint64_t> dropped{0};
+
+	std::vector<cv::Point2f> distorted[2]; // Reused across pairs
+	std::vector<cv::Point2f> normalized[2];
+};
+
+#endif